@@ -0,0 +1,149 @@
+// Decoder throughput per message type and packet fill level.
+//
+//   bench_decoder [-c config.ini] [-t types] [-d ms_per_case] [-m mtu]
+//
+// For every loaded spec (or the -t list) and a type mix, packets holding
+// 1, 4, 16 and as many messages as fit in the MTU are synthesised from the
+// spec and decoded back to back for -d ms, terse and verbose. A pool of
+// distinct packets is cycled so field values and branch history vary.
+
+#include "config.h"
+#include "decoder.h"
+#include "builder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <getopt.h>
+
+static constexpr int POOL = 256;
+
+struct Result {
+    double msgs_per_sec;
+    double ns_per_msg;
+    double out_mb_per_sec;
+};
+
+static std::vector<std::vector<uint8_t>> make_pool(const std::vector<const MsgSpec*>& specs,
+                                                   int fill, size_t mtu, int& msgs_per_pkt) {
+    const char sess[10] = {'B','E','N','C','H','0','0','0','0','1'};
+    std::vector<std::vector<uint8_t>> pool;
+    pool.reserve(POOL);
+
+    uint64_t salt = 0, seq = 1;
+    msgs_per_pkt = 0;
+    for (int p = 0; p < POOL; ++p) {
+        MoldPacketBuilder b(mtu);
+        b.begin(sess, seq);
+        for (int i = 0; fill <= 0 || i < fill; ++i) {
+            const MsgSpec* s = specs[(size_t)(salt % specs.size())];
+            auto m = build_message(*s, salt);
+            if (!b.add(m.data(), (uint16_t)m.size())) break;
+            ++salt;
+        }
+        seq += b.count();
+        msgs_per_pkt = std::max<int>(msgs_per_pkt, b.count());
+        pool.emplace_back(b.data(), b.data() + b.size());
+    }
+    return pool;
+}
+
+static Result run_case(const std::vector<std::vector<uint8_t>>& pool, bool verbose, int ms) {
+    static char out[256 * 1024];
+    DecodeOptions opt;
+    opt.verbose = verbose;
+
+    using clock = std::chrono::steady_clock;
+    const auto deadline = clock::now() + std::chrono::milliseconds(ms);
+
+    // warm-up pass (spec table init, caches)
+    for (const auto& p : pool) decode_moldudp64_packet_to_buffer(p.data(), p.size(), opt, out, sizeof(out));
+
+    uint64_t msgs = 0, bytes = 0;
+    const auto t0 = clock::now();
+    auto t1 = t0;
+    do {
+        for (const auto& p : pool) {
+            bytes += decode_moldudp64_packet_to_buffer(p.data(), p.size(), opt, out, sizeof(out));
+            msgs += ((uint16_t)p[18] << 8) | p[19];
+        }
+        t1 = clock::now();
+    } while (t1 < deadline);
+
+    const double sec = std::chrono::duration<double>(t1 - t0).count();
+    return Result{msgs / sec, sec * 1e9 / (double)msgs, bytes / sec / 1e6};
+}
+
+int main(int argc, char** argv) {
+    const char* ini = "config/config.ini";
+    const char* types = nullptr;
+    int ms = 200;
+    size_t mtu = 1400;
+
+    int c;
+    while ((c = getopt(argc, argv, "c:t:d:m:h")) != -1) {
+        switch (c) {
+            case 'c': ini = optarg; break;
+            case 't': types = optarg; break;
+            case 'd': ms = std::atoi(optarg); break;
+            case 'm': mtu = (size_t)std::atoi(optarg); break;
+            default:
+                std::cerr << "usage: " << argv[0] << " [-c config.ini] [-t types] [-d ms_per_case] [-m mtu]\n";
+                return 1;
+        }
+    }
+
+    try {
+        load_config(ini);
+    } catch (const std::exception& e) {
+        std::cerr << "FATAL: " << e.what() << "\n";
+        return 1;
+    }
+
+    uint64_t mask[4];
+    if (types && !parse_type_list(types, mask)) {
+        std::cerr << "FATAL: invalid -t '" << types << "'\n";
+        return 1;
+    }
+
+    std::vector<const MsgSpec*> all;
+    for (const auto& kv : config().msg_specs) {
+        const uint8_t t = (uint8_t)kv.first;
+        if (types && !((mask[t >> 6] >> (t & 63)) & 1ULL)) continue;
+        all.push_back(&kv.second);
+    }
+    if (all.empty()) {
+        std::cerr << "FATAL: no message types selected\n";
+        return 1;
+    }
+    std::sort(all.begin(), all.end(), [](const MsgSpec* a, const MsgSpec* b) { return a->msg_type < b->msg_type; });
+
+    // one row group per type, then the mix of all selected types
+    std::vector<std::pair<std::string, std::vector<const MsgSpec*>>> groups;
+    for (const MsgSpec* s : all) groups.push_back({std::string(1, s->msg_type), {s}});
+    if (all.size() > 1) groups.push_back({"mix", all});
+
+    const int fills[] = {1, 4, 16, 0};   // 0 = fill to MTU
+
+    std::printf("%-5s %5s %-8s %14s %10s %10s\n", "type", "msgs", "mode", "msgs/sec", "ns/msg", "out MB/s");
+    for (const auto& g : groups) {
+        for (int fill : fills) {
+            int per_pkt = 0;
+            auto pool = make_pool(g.second, fill, mtu, per_pkt);
+            if (fill > 0 && per_pkt < fill) continue;   // does not fit in the MTU
+
+            for (bool verbose : {false, true}) {
+                Result r = run_case(pool, verbose, ms);
+                std::printf("%-5s %5d %-8s %14.0f %10.1f %10.1f\n",
+                            g.first.c_str(), per_pkt, verbose ? "verbose" : "terse",
+                            r.msgs_per_sec, r.ns_per_msg, r.out_mb_per_sec);
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,230 @@
+// End-to-end loopback capacity: FeedGenerator -> receiver backend ->
+// decoder -> sink, with the rate ramped step by step until messages go
+// missing.
+//
+//   bench_loopback [-c ini] [-b backend] [-a group] [-p port] [-i ifip]
+//                  [-r start_rate] [-f factor] [-M max_rate] [-d sec_per_step]
+//                  [-o sink] [-k msgs_per_packet] [-C rx_cpu,gen_cpu]
+//
+// Each step reports offered and received rates, missing messages, kernel
+// drops on our side (the receiver's local_drops(): socket buffer overflow,
+// ring or UMEM full) and receiver CPU per message
+// (thread CPU clock of the receive thread). The result is the highest rate
+// with no loss. Generator and receiver share the box, so pin them to
+// separate cores (-C) for numbers that mean something.
+
+#include "config.h"
+#include "cpu.h"
+#include "decoder.h"
+#include "feedgen.h"
+#include "output.h"
+#include "socket.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <getopt.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+struct RxCounters {
+    std::atomic<uint64_t> msgs{0};
+    std::atomic<uint64_t> missing{0};   // sequence numbers skipped (not recovered)
+    std::atomic<uint64_t> dups{0};
+    std::atomic<uint64_t> expected{0};  // next sequence number, 0 = not synced
+    std::atomic<uint64_t> kdrops{0};    // rx->local_drops(), sampled on gaps and when idle
+};
+
+static std::atomic<bool> g_stop{false};
+
+static inline uint64_t be64_at(const uint8_t* p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; ++i) v = (v << 8) | p[i];
+    return v;
+}
+
+static void receive_loop(UdpMcastReceiver* rx, const DecodeOptions* opt, RxCounters* c, int cpu) {
+    if (cpu >= 0 && !pin_current_thread(cpu)) std::cerr << "WARN: cannot pin receiver to cpu " << cpu << "\n";
+
+    static RxPacket pkts[MAX_RX_BATCH];
+    const int batch = (int)std::min<uint32_t>(config().rx.batch, MAX_RX_BATCH);
+
+    while (!g_stop.load(std::memory_order_relaxed)) {
+        int n = rx->recv_packets(pkts, batch);
+        if (n <= 0) {
+            c->kdrops.store(rx->local_drops(), std::memory_order_relaxed);
+            output_batch_end();
+            continue;
+        }
+        for (int i = 0; i < n; ++i) {
+            const uint8_t* p = pkts[i].data;
+            if (pkts[i].len < 20) continue;
+            const uint64_t seq = be64_at(p + 10);
+            const uint16_t cnt = (uint16_t)((p[18] << 8) | p[19]);
+            if (cnt == 0 || cnt == 0xFFFF) continue;
+
+            uint64_t exp = c->expected.load(std::memory_order_relaxed);
+            if (exp == 0) exp = seq;
+            if (seq + cnt <= exp) {
+                c->dups.fetch_add(cnt, std::memory_order_relaxed);
+                continue;
+            }
+            if (seq > exp) {
+                c->missing.fetch_add(seq - exp, std::memory_order_relaxed);
+                c->kdrops.store(rx->local_drops(), std::memory_order_relaxed);
+            }
+
+            output_packet(p, pkts[i].len, *opt);
+            const uint64_t fresh = seq + cnt - (seq < exp ? exp : seq);
+            c->msgs.fetch_add(fresh, std::memory_order_relaxed);
+            c->expected.store(seq + cnt, std::memory_order_relaxed);
+        }
+        rx->release();
+        output_batch_end();
+    }
+}
+
+static double thread_cpu_sec(clockid_t cid) {
+    timespec ts{};
+    clock_gettime(cid, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char** argv) {
+    const char* ini = "config/config.ini";
+    std::string backend;
+    std::string group = "239.1.1.1";
+    uint16_t port = 15500;
+    std::string ifip = "127.0.0.1";
+    std::string sink = "/dev/null";
+    double rate = 50000, factor = 1.25, max_rate = 20e6, step_sec = 2.0;
+    int per_pkt = 0;
+    int rx_cpu_id = -1, gen_cpu_id = -1;
+
+    int opt;
+    while ((opt = ::getopt(argc, argv, "hc:b:a:p:i:r:f:M:d:o:k:C:")) != -1) {
+        switch (opt) {
+            case 'c': ini = optarg; break;
+            case 'b': backend = optarg; break;
+            case 'a': group = optarg; break;
+            case 'p': port = (uint16_t)std::atoi(optarg); break;
+            case 'i': ifip = optarg; break;
+            case 'r': rate = std::atof(optarg); break;
+            case 'f': factor = std::atof(optarg); break;
+            case 'M': max_rate = std::atof(optarg); break;
+            case 'd': step_sec = std::atof(optarg); break;
+            case 'o': sink = optarg; break;
+            case 'k': per_pkt = std::atoi(optarg); break;
+            case 'C':
+                if (std::sscanf(optarg, "%d,%d", &rx_cpu_id, &gen_cpu_id) != 2) {
+                    std::cerr << "FATAL: -C expects rx_cpu,gen_cpu\n";
+                    return 1;
+                }
+                break;
+            default:
+                std::cerr << "usage: " << argv[0] << " [-c ini] [-b backend] [-a group] [-p port] [-i ifip]"
+                          << " [-r start_rate] [-f factor] [-M max_rate] [-d sec_per_step] [-o sink] [-k msgs_per_packet] [-C rx_cpu,gen_cpu]\n";
+                return 1;
+        }
+    }
+    if (factor <= 1.0) factor = 1.25;
+
+    try {
+        load_config(ini);
+    } catch (const std::exception& e) {
+        std::cerr << "FATAL: " << e.what() << "\n";
+        return 1;
+    }
+
+    ReceiveConfig rc = config().rx;
+    if (!backend.empty()) rc.backend = backend;
+    auto rx = make_receiver(rc);
+    if (!rx->open(group, port, ifip, "")) {
+        std::cerr << "FATAL: receiver open failed\n";
+        return 1;
+    }
+    rx->set_rcvbuf(16 * 1024 * 1024);
+    rx->set_timeout_ms(100);
+
+    OutputConfig oc = config().output;
+    oc.sink = sink;
+    oc.routes.clear();
+    DecodeOptions dopt;
+    if (!output_open(oc, dopt)) {
+        std::cerr << "FATAL: output setup failed\n";
+        return 1;
+    }
+
+    FeedGenConfig fc;
+    fc.dest_ip = group;
+    fc.dest_port = port;
+    fc.interface_ip = ifip;
+    fc.max_per_packet = per_pkt;
+    fc.heartbeat_ms = 0;
+    FeedGenerator gen;
+    if (!gen.open(fc)) {
+        std::cerr << "FATAL: generator setup failed\n";
+        return 1;
+    }
+
+    RxCounters c;
+    if (gen_cpu_id >= 0 && !pin_current_thread(gen_cpu_id)) {
+        std::cerr << "WARN: cannot pin generator to cpu " << gen_cpu_id << "\n";
+    }
+    std::thread rx_thread(receive_loop, rx.get(), &dopt, &c, rx_cpu_id);
+    clockid_t rx_cpu;
+    pthread_getcpuclockid(rx_thread.native_handle(), &rx_cpu);
+
+    std::printf("%12s %12s %10s %10s %10s %9s\n", "offered/s", "received/s", "missing", "k-drops", "dups", "cpu ns/msg");
+
+    double best = 0;
+    for (; rate <= max_rate; rate *= factor) {
+        const uint64_t m0 = c.msgs, miss0 = c.missing, dup0 = c.dups;
+        const uint64_t kd0 = c.kdrops;
+        const double cpu0 = thread_cpu_sec(rx_cpu);
+
+        gen.set_rate(rate);
+        timespec t0{}, t1{};
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        const uint64_t sent = gen.run(0, step_sec);
+        const uint64_t last = gen.next_seq();
+
+        // let the receiver drain what is in flight
+        for (int i = 0; i < 50 && c.expected.load() < last; ++i) ::usleep(10000);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+
+        const double wall = (double)(t1.tv_sec - t0.tv_sec) + (double)(t1.tv_nsec - t0.tv_nsec) / 1e9;
+        const uint64_t got = c.msgs - m0;
+        const uint64_t tail = (c.expected.load() < last) ? last - c.expected.load() : 0;
+        const uint64_t missing = c.missing - miss0 + tail;
+        const uint64_t kdrops = c.kdrops - kd0;
+        const double cpu = thread_cpu_sec(rx_cpu) - cpu0;
+        if (tail) c.expected.store(last);   // resync for the next step
+
+        std::printf("%12.0f %12.0f %10llu %10llu %10llu %9.0f\n",
+                    sent / step_sec, got / wall,
+                    (unsigned long long)missing, (unsigned long long)kdrops,
+                    (unsigned long long)(c.dups - dup0),
+                    got ? cpu * 1e9 / (double)got : 0.0);
+
+        if (missing || kdrops) break;
+        if (sent < rate * step_sec * 0.95) {
+            std::printf("generator saturated at %.0f msgs/s\n", sent / step_sec);
+            best = sent / step_sec;
+            break;
+        }
+        best = rate;
+    }
+
+    g_stop = true;
+    rx_thread.join();
+    output_close();
+
+    std::printf("max lossless rate: %.0f msgs/s (backend %s)\n", best, rc.backend.c_str());
+    return 0;
+}
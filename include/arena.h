@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Process-wide arena for hot-path buffers (receive slabs, output chunks,
+// sink buffers, recovery buffers). One region is reserved at startup from
+// 2 MB hugepages (MAP_HUGETLB, else transparent hugepages), pre-faulted and
+// optionally mlock'd, so the first burst of the day pays no page faults or
+// TLB misses on buffer memory. Allocation is a bump pointer; buffers live
+// until exit except the most recent one, which arena_free() can hand back.
+// When the arena is not initialised or is full, allocations fall back to a
+// private pre-faulted mapping of their own.
+
+struct ArenaStats {
+    size_t capacity;      // arena region bytes
+    size_t used;          // bytes handed out from the region
+    size_t fallback;      // bytes served by fallback mappings
+    bool   hugetlb;       // region is on explicit hugepages
+    bool   locked;        // region is mlock'd
+};
+
+// Reserve `bytes` (rounded up to 2 MB). Returns false if no memory at all
+// could be mapped; a failed mlock is only a warning.
+bool arena_init(size_t bytes, bool hugepages, bool lock);
+
+// Zeroed, pre-faulted memory aligned to `align` (power of two, <= 2 MB).
+// Returns nullptr only if the fallback mapping fails too.
+void* arena_alloc(size_t bytes, size_t align = 64);
+
+// Release memory from arena_alloc(). Arena memory is only reclaimed if it
+// was the last allocation; fallback mappings are unmapped.
+void arena_free(void* p, size_t bytes);
+
+ArenaStats arena_stats();
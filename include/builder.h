@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct MsgSpec;
+
+// Building MoldUDP64 packets and spec-conformant messages: shared by the
+// tests, the decoder benchmark and the feed generator.
+
+// ---------- big-endian writers ----------
+void push_be16(std::vector<uint8_t>& b, uint16_t v);
+void push_be32(std::vector<uint8_t>& b, uint32_t v);
+void push_be64(std::vector<uint8_t>& b, uint64_t v);
+void push_str_fixed(std::vector<uint8_t>& b, const char* s, size_t n);   // space padded
+
+// A message of `spec` with every field filled with plausible, `salt`-dependent
+// values (type byte, timestamps, prices, ids); length is spec.total_length.
+std::vector<uint8_t> build_message(const MsgSpec& spec, uint64_t salt);
+
+// Wrap messages into one MoldUDP64 packet: header(session, seq, count) + blocks.
+std::vector<uint8_t> build_mold_packet(const char session10[10],
+                                       uint64_t start_seq,
+                                       const std::vector<std::vector<uint8_t>>& msgs);
+
+// Incremental packet builder into a fixed buffer capped at `max_bytes`
+// (keep it under the path MTU). Count 0 is a heartbeat, 0xFFFF end of session.
+class MoldPacketBuilder {
+public:
+    explicit MoldPacketBuilder(size_t max_bytes = 1400);
+
+    void begin(const char session10[10], uint64_t seq);
+    // false if the message does not fit; the packet is left unchanged
+    bool add(const uint8_t* msg, uint16_t len);
+    void end_of_session();    // mark the (empty) packet as end of session
+
+    uint64_t seq() const { return seq_; }
+    uint16_t count() const { return count_; }
+    size_t size() const { return len_; }
+    const uint8_t* data() const { return buf_.data(); }
+
+private:
+    void set_count(uint16_t c);
+
+    std::vector<uint8_t> buf_;
+    size_t len_;
+    uint64_t seq_;
+    uint16_t count_;
+};
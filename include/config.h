@@ -14,9 +14,78 @@ struct NetConfig {
     uint16_t    rerequest_port;
 };
 
+struct ReceiveConfig {
+    std::string backend = "recvmmsg";   // recvmmsg | io_uring | af_xdp | packet_ring
+    uint32_t    batch = 64;             // datagrams per recv_packets() call (max 256)
+    uint32_t    slot_size = 2048;       // recvmmsg: bytes per datagram slot; larger ones take the jumbo path
+    uint32_t    xdp_queue = 0;          // af_xdp: NIC RX queue carrying the feed
+    std::string xdp_mode = "skb";       // af_xdp: skb (generic, works on veth) | drv (native, zero-copy if supported)
+    uint32_t    ring_block_size = 1u << 20;   // packet_ring: TPACKET_V3 block size (power of two, >= page)
+    uint32_t    ring_blocks = 64;             // packet_ring: number of blocks
+    uint32_t    ring_block_timeout_ms = 1;    // packet_ring: retire a partly filled block after this
+    uint32_t    stall_ms = 5000;        // no data or heartbeat for this long = feed stall (0 = off)
+};
+
+// Extra rerequest server, besides [FEED_CHANNELS] mcast_rerequester_ip/port.
+struct RerequestEndpoint {
+    std::string ip;
+    uint16_t    port = 0;
+};
+
 struct RecoverySettings {
     uint16_t max_recovery_message_count = 5000;
-}
+    std::vector<RerequestEndpoint> endpoints;   // failover / parallel targets, after the primary
+    double   request_rate = 0;                  // rerequests per second over all endpoints (0 = unlimited)
+    uint32_t request_burst = 4;                 // token bucket depth
+    uint64_t parallel_min_messages = 0;         // split larger recoveries across endpoints (0 = never)
+    uint32_t endpoint_retry_ms = 5000;          // skip an endpoint this long after it stopped answering
+    uint64_t reorder_bytes = 4u << 20;          // answers held until the ones before them arrive
+    uint32_t timeout_ms = 500;                  // wait for an answer before any RTT is measured; upper bound
+    uint32_t min_timeout_us = 1000;             // lower bound of the measured (adaptive) timeout
+    uint32_t retries = 3;                       // resends of the outstanding range before giving up
+    uint32_t download_lanes = 0;                // -s download: requests in flight at once (< 2 = serial)
+    uint64_t download_segment_bytes = 1u << 20; // -s download: buffer per range waiting to be output
+};
+
+// Route a set of message types to their own output sink.
+struct OutputRoute {
+    std::string types;   // e.g. "E,P"
+    std::string target;  // sink spec, see make_sink() in sink.h
+};
+
+// Placement / scheduling of the receive thread (see cpu.h).
+struct ThreadConfig {
+    int         rx_cpu = -1;            // core for receive + decode + recovery (-1 = no pinning)
+    std::string aux_cpus;               // CPU list for background threads, e.g. "0-1" (empty = any but rx_cpu)
+    std::string numa_node = "auto";     // auto (NIC's node) | off | <node>
+    int         rt_priority = 0;        // > 0: SCHED_FIFO at this priority
+    bool        mlockall = false;
+};
+
+// Hot-path buffer arena (see arena.h).
+struct MemoryConfig {
+    uint64_t arena_bytes = 64ull << 20;   // 0 = no arena, buffers get their own mappings
+    bool     hugepages = true;            // MAP_HUGETLB, else THP
+    bool     mlock = false;
+};
+
+// Shared-memory message bus for local consumers (disabled if name is empty).
+struct BusConfig {
+    std::string name;                  // e.g. /moldudp64_bus
+    uint64_t    slots = 1u << 20;
+    uint32_t    slot_size = 128;
+};
+
+struct OutputConfig {
+    std::string message_types = "*";   // enabled types, "*" = all
+    std::string sink = "stdout";       // default sink spec ("none" = no text output)
+    std::string format = "text";       // text | binary | binary_le (records, see decoder.h)
+    size_t      file_buffer_bytes = 4u << 20;
+    std::string flush_policy = "batch";  // packet | batch | bytes
+    size_t      flush_bytes = 1u << 20;  // "bytes": flush at this much pending
+    uint32_t    flush_usec = 1000;       // "bytes": max time output may linger
+    std::vector<OutputRoute> routes;   // everything else goes to `sink`
+};
 
 enum class FieldType : uint8_t {
     CHAR,
@@ -44,11 +113,34 @@ struct MsgSpec {
     std::vector<FieldSpec> fields;
 };
 
+// Last-value state cache and its snapshots (see state.h); off if path is empty.
+struct SnapshotConfig {
+    std::string path;                    // e.g. state/XrossingMD.snap
+    std::string key_field = "SecurityId";  // one entry per (type, key value)
+    uint64_t    interval_msgs = 1000000;   // snapshot after this many messages (0 = off)
+    uint32_t    interval_sec = 60;         // ... or this many seconds (0 = off)
+    std::string progress;                  // mmap'd crash-restart record, see progress.h (empty = off)
+};
+
+// Metrics exporter (see metrics.h); disabled if listen is empty.
+struct MetricsConfig {
+    std::string listen;                // unix:/path | http://host:port
+};
+
 struct AppConfig {
     NetConfig net;
+    ReceiveConfig rx;
     RecoverySettings recovery;
+    OutputConfig output;
+    BusConfig bus;
+    MemoryConfig memory;
+    ThreadConfig threads;
+    MetricsConfig metrics;
+    SnapshotConfig snapshot;
     std::unordered_map<char, MsgSpec> msg_specs;
 };
 
 void load_config(const char* ini_path);
+// Replace the loaded message specs with those of a spec JSON (tools).
+void load_spec_file(const char* json_path);
 const AppConfig& config();
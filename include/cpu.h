@@ -0,0 +1,41 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <thread>
+
+struct ThreadConfig;
+
+// CPU / NUMA placement and scheduling for the hot path. Receive, decode and
+// recovery all run on the main thread; background threads are started with
+// cpu_start_aux_thread() so they stay off that core.
+
+// NUMA node of a network interface's device, or -1 (virtual NIC / no NUMA).
+int interface_numa_node(const std::string& ifname);
+
+// NUMA node owning `cpu`, or -1.
+int cpu_numa_node(int cpu);
+
+// Pin the calling thread to one CPU / a CPU list like "2,4-6".
+bool pin_current_thread(int cpu);
+bool pin_current_thread(const std::string& cpu_list);
+
+// Prefer `node` for all later page allocations of the calling thread.
+bool prefer_numa_node(int node);
+
+// Pin the main thread and set its memory policy. Call before arena_init()
+// so the pre-faulted arena lands on the right node. `ifname` resolves
+// numa_node = auto.
+void cpu_setup_placement(const ThreadConfig& tc, const std::string& ifname);
+
+// SCHED_FIFO and mlockall, if configured. Call once setup is done, right
+// before the receive loop.
+void cpu_setup_realtime(const ThreadConfig& tc);
+
+// Apply aux_cpus to the calling (background) thread. If unset, the thread
+// gets the CPUs the process started with, minus rx_cpu.
+void cpu_pin_aux_thread();
+
+// Start a background thread pinned to aux_cpus, with all signals blocked so
+// SIGINT always lands on (and interrupts) the receive thread.
+std::thread cpu_start_aux_thread(std::function<void()> fn);
@@ -6,10 +6,92 @@
 struct DecodeOptions {
     bool verbose = false;
     bool print_hex_strings = false;
+
+    // Enabled message types: 256-bit mask indexed by the type byte
+    // (same indexing as the decoder's spec table). Disabled types are
+    // skipped before any formatting work.
+    uint64_t type_mask[4] = {~0ULL, ~0ULL, ~0ULL, ~0ULL};
+
+    // Output route per message type (0 = default route).
+    uint8_t type_route[256] = {};
+
+    bool type_enabled(uint8_t t) const {
+        return (type_mask[t >> 6] >> (t & 63)) & 1ULL;
+    }
+};
+
+// Caller-provided output buffer for one route. `len` is advanced by the decoder.
+struct DecodeRoute {
+    char*  out;
+    size_t cap;
+    size_t len;
+};
+
+// One message inside a MoldUDP64 packet (points into the packet buffer).
+struct MoldMessageView {
+    uint64_t       seq;
+    const uint8_t* data;
+    uint16_t       len;
+};
+
+// Binary output record (output format "binary" / "binary_le"). All fields
+// little-endian; each record is padded to a multiple of 8 bytes so a file
+// of them can be mmap'd and walked by `size` without copying.
+struct MoldRecordHeader {
+    uint64_t seq;
+    uint64_t recv_ns;    // CLOCK_REALTIME when the packet was output
+    uint32_t size;       // whole record: header + payload + padding
+    uint16_t len;        // payload bytes (the message, type byte first)
+    uint8_t  type;       // message type; 0 with MOLD_RECORD_END_OF_SESSION
+    uint8_t  flags;
 };
+static_assert(sizeof(MoldRecordHeader) == 24, "record header layout");
+
+constexpr uint8_t MOLD_RECORD_NORMALIZED     = 1;   // integer fields of the spec are little-endian
+constexpr uint8_t MOLD_RECORD_END_OF_SESSION = 2;   // no payload; seq is the next sequence
+
+// Split a packet into message views without formatting. Messages whose
+// type is disabled in `opt` are skipped. Returns number of views written
+// (at most `max`); end-of-session packets yield none.
+size_t split_moldudp64_packet(const uint8_t* buf, size_t len,
+                              const DecodeOptions& opt,
+                              MoldMessageView* out, size_t max);
+
+// Structural check of a data packet: the message blocks fill the datagram
+// exactly (count, lengths) and no message of a type in the spec is shorter
+// than its spec length. Heartbeat / end-of-session packets pass if they
+// carry nothing after the header.
+bool validate_moldudp64_packet(const uint8_t* buf, size_t len);
+
+// Parse a message-type list ("E,P", "HY", "*") into a 256-bit mask.
+// Returns false if the list names no types.
+bool parse_type_list(const char* list, uint64_t mask[4]);
 
 // Decode one MoldUDP64 packet into caller-provided buffer.
 // Returns number of bytes written to `out`.
 size_t decode_moldudp64_packet_to_buffer(const uint8_t* buf, size_t len,
                                         const DecodeOptions& opt,
                                         char* out, size_t out_cap);
+
+// Decode one MoldUDP64 packet, appending each message to
+// routes[opt.type_route[type]] (out-of-range routes fall back to routes[0]).
+// Returns total number of bytes appended across all routes.
+size_t decode_moldudp64_packet_to_routes(const uint8_t* buf, size_t len,
+                                        const DecodeOptions& opt,
+                                        DecodeRoute* routes, size_t nroutes);
+
+// Upper bound, per route, on what decode_moldudp64_packet_to_routes()
+// (or, with `binary`, encode_moldudp64_packet_to_routes()) appends for
+// this packet. need[] has nroutes entries.
+void moldudp64_output_bound(const uint8_t* buf, size_t len,
+                            const DecodeOptions& opt, bool binary,
+                            size_t* need, size_t nroutes);
+
+// Same as decode_moldudp64_packet_to_routes(), but appends one
+// MoldRecordHeader + payload per message instead of text. With `normalize`
+// the integer fields of messages with a spec are rewritten little-endian
+// (MOLD_RECORD_NORMALIZED); everything else is copied as received.
+size_t encode_moldudp64_packet_to_routes(const uint8_t* buf, size_t len,
+                                         const DecodeOptions& opt,
+                                         uint64_t recv_ns, bool normalize,
+                                         DecodeRoute* routes, size_t nroutes);
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+struct MsgSpec;
+
+// Synthetic MoldUDP64 publisher for local soak and capacity tests.
+// Messages are synthesised from the loaded specs (config().msg_specs) with
+// a configurable type mix, paced at a message rate with optional periodic
+// bursts, and sent to a multicast group or unicast address. Packets can be
+// dropped, duplicated or reordered on purpose; an optional rerequest
+// responder serves the original messages so gap recovery can be exercised.
+
+struct FeedGenConfig {
+    std::string dest_ip = "239.1.1.1";
+    uint16_t    dest_port = 15000;
+    std::string interface_ip;            // multicast interface / rerequest bind address ("" = default)
+    int         ttl = 1;
+
+    std::string session = "SESSION001";
+    uint64_t    start_seq = 1;
+    size_t      mtu = 1400;              // max bytes per Mold packet
+    int         max_per_packet = 0;      // 0 = fill to mtu
+
+    double      rate = 100000;           // messages/sec, 0 = as fast as possible
+    double      burst_factor = 1.0;      // rate multiplier inside a burst
+    int         burst_ms = 0;            // burst length ...
+    int         burst_period_ms = 0;     // ... starting every period (0 = no bursts)
+
+    std::string mix;                     // "A:50,E:30,P:10"; empty = all loaded types, equal weight
+
+    double      drop = 0.0;              // per-packet probabilities
+    double      dup = 0.0;
+    double      reorder = 0.0;           // held back and sent after the next packet
+    uint64_t    seed = 1;
+
+    uint16_t    rereq_port = 0;          // > 0: answer rerequests on interface_ip:rereq_port
+    uint64_t    history = 10000000;      // messages retained for rerequests
+    int         heartbeat_ms = 1000;     // idle heartbeat interval (0 = none)
+};
+
+struct FeedGenStats {
+    uint64_t packets = 0;         // live packets generated (incl. dropped)
+    uint64_t messages = 0;
+    uint64_t dropped = 0;
+    uint64_t duplicated = 0;
+    uint64_t reordered = 0;
+    uint64_t heartbeats = 0;
+    uint64_t rereq_requests = 0;
+    uint64_t rereq_messages = 0;
+};
+
+class FeedGenerator {
+public:
+    FeedGenerator();
+    ~FeedGenerator();
+
+    bool open(const FeedGenConfig& cfg);
+    void close();
+
+    void set_rate(double msgs_per_sec);
+
+    // Publish until `max_msgs` more messages (0 = no limit), `seconds`
+    // (<= 0 = no limit) or *stop. Rerequests are served meanwhile.
+    // Returns messages generated by this call.
+    uint64_t run(uint64_t max_msgs, double seconds, const std::atomic<bool>* stop = nullptr);
+
+    // Only heartbeats and rerequests, for `seconds` or until *stop.
+    void serve(double seconds, const std::atomic<bool>* stop = nullptr);
+
+    // Send the end-of-session packet (three times, as publishers do).
+    void end_of_session();
+
+    uint64_t next_seq() const { return next_seq_; }
+    const FeedGenStats& stats() const { return stats_; }
+
+private:
+    static constexpr int VARIANTS = 256;   // pre-built messages per type, picked by seq
+    static constexpr int SEND_BATCH = 32;
+    static constexpr int RR_POLL_BATCHES = 8;   // flat out: answer rerequests every 8 send batches
+
+    bool build_templates();
+    uint8_t pick_type();
+    const std::vector<uint8_t>& message_for(uint8_t type, uint64_t seq) const;
+
+    void emit_live_packet(size_t n_msgs);
+    void queue_packet(const uint8_t* data, size_t len);
+    void flush_sends();
+    void heartbeat();
+    void poll_rerequests();
+    double due_messages(double t) const;
+    double next_random();
+
+    FeedGenConfig cfg_;
+    FeedGenStats stats_;
+    char session_[10];
+
+    int tx_fd_;
+    int rr_fd_;
+    uint64_t next_seq_;
+    uint64_t rng_;
+
+    std::vector<std::vector<uint8_t>> templates_[256];
+    uint32_t cum_weight_[256];           // cumulative mix weights by type byte
+    std::vector<uint8_t> types_in_mix_;
+    uint32_t total_weight_;
+    int pending_type_;                   // drawn type that did not fit the last packet
+
+    std::vector<uint8_t> history_;       // type byte per seq, ring of cfg_.history
+    uint64_t last_send_ns_;
+
+    // outgoing sendmmsg batch
+    std::vector<uint8_t> out_bufs_;
+    std::vector<uint32_t> out_lens_;
+    std::vector<struct iovec> out_iov_;
+    std::vector<struct mmsghdr> out_msgs_;
+    int out_n_;
+
+    std::vector<uint8_t> held_;          // reordered packet waiting for the next one
+};
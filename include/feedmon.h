@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+
+struct ThreadMetrics;
+
+// Receive-loop bookkeeping besides decoding: what a packet of the current
+// session says against the next expected sequence number, and whether the
+// feed went silent. A heartbeat or end-of-session packet carries the next
+// sequence number too, so it reveals a tail gap - the last data packets of
+// a burst were lost and no later data packet will tell. Counts go to the
+// receive thread's metrics block, events to the log.
+
+enum class FeedVerdict {
+    DELIVER,     // in sequence (a heartbeat or end of session behind it too)
+    GAP,         // messages before it are missing: gap(), then deliver it
+    DUPLICATE,   // data already delivered
+    REPEAT_END   // end of session already delivered; exchanges repeat it
+};
+
+class FeedMonitor {
+public:
+    // stall_ns 0: no stall detection. `now_ns` starts the stall clock.
+    FeedMonitor(ThreadMetrics& mt, uint64_t stall_ns, uint64_t now_ns);
+
+    // A packet of the current session. `ended`: its end-of-session packet
+    // was delivered already.
+    FeedVerdict classify(uint64_t expected_seq, uint64_t seq, uint16_t cnt, bool ended) const;
+
+    // Count and log the gap [expected_seq, seq) found by `cnt` (0 or 0xFFFF:
+    // a tail gap). `drops` is the receiver's local_drops(); returns the
+    // kernel drops since the last gap (0: the loss was upstream).
+    uint64_t gap(const char session10[10], uint64_t expected_seq, uint64_t seq, uint16_t cnt, uint64_t drops);
+
+    // Drops up to here do not count for the next gap (new session).
+    void reset_drops(uint64_t drops) { drops_seen_ = drops; }
+
+    // A receive call came back empty. True (counted and logged) once per
+    // stall, when nothing has arrived for stall_ns.
+    bool idle(uint64_t now_ns, const char session10[10], uint64_t expected_seq);
+
+    // Packets arrived. True (logged) if that ends a stall.
+    bool active(uint64_t now_ns, const char session10[10]);
+
+    bool stalled() const { return stalled_; }
+
+private:
+    ThreadMetrics& mt_;
+    uint64_t stall_ns_;
+    uint64_t last_rx_ns_;
+    uint64_t drops_seen_;
+    bool stalled_;
+};
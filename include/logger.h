@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+
+// Asynchronous binary log for the receive thread. log_event() copies a
+// format id, up to two sessions and four integers into a lock-free
+// ring (no formatting, no allocation, no syscall); a background writer
+// formats the records and writes them out in batches. If the ring is full
+// the record is dropped and counted rather than stalling the caller.
+// Until log_start() (and after log_stop()) records are formatted and
+// written inline, so tools and tests need no setup.
+
+enum LogId : uint16_t {
+    LOG_GAP_UPSTREAM,          // session, first, last, count
+    LOG_GAP_LOCAL,             // session, first, last, count, kernel drops
+    LOG_DOWNLOAD,              // session, from, count
+    LOG_RECOVERY_PARTIAL,      // recovered, still missing
+    LOG_RECOVERY_REQUEST,      // start, count
+    LOG_RECOVERY_STALLED,      // start, count
+    LOG_RECOVERY_DONE,         // recovered
+    LOG_RECOVERY_SEND_FAILED,  // errno
+    LOG_RECOVERY_RECV_FAILED,  // errno
+    LOG_SESSION_ROLLOVER,      // old session, new session, last seq delivered, old one ended (0/1)
+    LOG_SESSION_END,           // session, next seq
+    LOG_FEED_STALL,            // session, idle ms, expected seq
+    LOG_FEED_RESUMED,          // session, idle ms
+    LOG_RECOVERY_FAILOVER,     // endpoint index, start, count
+    LOG_RECOVERY_SPLIT,        // start, count, endpoints
+    LOG_DOWNLOAD_PROGRESS,     // done, total, messages per second, lanes
+    LOG_ID_COUNT
+};
+
+// Records whose format starts with a session take it as the 10-byte id.
+void log_session(LogId id, const char session10[10],
+                 uint64_t a0 = 0, uint64_t a1 = 0, uint64_t a2 = 0, uint64_t a3 = 0);
+
+inline void log_event(LogId id, uint64_t a0 = 0, uint64_t a1 = 0, uint64_t a2 = 0, uint64_t a3 = 0) {
+    log_session(id, nullptr, a0, a1, a2, a3);
+}
+
+// Two sessions (old, new), for rollovers.
+void log_sessions(LogId id, const char first10[10], const char second10[10],
+                  uint64_t a0 = 0, uint64_t a1 = 0, uint64_t a2 = 0, uint64_t a3 = 0);
+
+// Start the writer thread, writing to `fd` (default stderr).
+void log_start(int fd = 2);
+
+// Drain what is queued, stop the writer and report dropped records.
+void log_stop();
+
+// Records dropped because the ring was full, since start.
+uint64_t log_dropped();
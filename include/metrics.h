@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+struct MetricsConfig;
+
+// Runtime counters and latency histograms, exported in Prometheus text
+// format by a background thread (see metrics_start()).
+//
+// Every thread that counts registers its own block once and is the only
+// writer to it, so updates are plain relaxed load+store (no locked RMW,
+// no shared cache lines). The exporter reads all blocks with relaxed loads
+// and labels each series with the thread name.
+
+constexpr int METRICS_MAX_THREADS = 8;
+constexpr int METRICS_HIST_BUCKETS = 24;   // upper bounds 256 ns * 2^i, then +Inf
+
+// Log2 latency histogram, nanoseconds.
+struct MetricsHist {
+    std::atomic<uint64_t> bucket[METRICS_HIST_BUCKETS + 1];
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> sum_ns;
+};
+
+struct alignas(64) ThreadMetrics {
+    char name[16];
+
+    std::atomic<uint64_t> packets;          // datagrams seen (incl. heartbeats, stale)
+    std::atomic<uint64_t> bytes;            // datagram bytes
+    std::atomic<uint64_t> messages;         // messages delivered to output, live + recovered
+    std::atomic<uint64_t> gaps;             // sequence gaps detected
+    std::atomic<uint64_t> gap_messages;     // messages missing across those gaps
+    std::atomic<uint64_t> gaps_local;       // gaps with kernel drops on our side
+    std::atomic<uint64_t> recovered;        // messages filled in by rerequest
+    std::atomic<uint64_t> duplicates;       // messages already seen
+    std::atomic<uint64_t> local_drops;      // receiver local_drops() at the last gap
+    std::atomic<uint64_t> session_rollovers;
+    std::atomic<uint64_t> stale_packets;    // packets of a session already left
+    std::atomic<uint64_t> heartbeats;       // zero-message packets
+    std::atomic<uint64_t> tail_gaps;        // gaps seen on a heartbeat / end of session, not on data
+    std::atomic<uint64_t> stalls;           // feed stall events (no packet for stall_ms)
+    std::atomic<uint64_t> rerequest_retransmits;   // outstanding ranges requested again after a timeout
+    std::atomic<uint64_t> rerequest_rejected;      // answers from elsewhere, of another session, or malformed
+    std::atomic<uint64_t> type_count[256];  // live messages per message type
+
+    MetricsHist batch_ns;      // decode + output time per receive batch
+    MetricsHist recovery_ns;   // duration of one recovery (rerequest round trips)
+    MetricsHist rerequest_rtt_ns;   // rerequest sent -> first answer (first sends only)
+};
+
+// Single-writer increment.
+inline void metrics_add(std::atomic<uint64_t>& c, uint64_t n) {
+    c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+inline void metrics_set(std::atomic<uint64_t>& c, uint64_t v) {
+    c.store(v, std::memory_order_relaxed);
+}
+
+inline void metrics_observe(MetricsHist& h, uint64_t ns) {
+    int b = 0;
+    for (uint64_t lim = 256; b < METRICS_HIST_BUCKETS && ns > lim; lim <<= 1) ++b;
+    metrics_add(h.bucket[b], 1);
+    metrics_add(h.count, 1);
+    metrics_add(h.sum_ns, ns);
+}
+
+// Count the messages of one MoldUDP64 packet by type (first payload byte).
+inline void metrics_count_types(ThreadMetrics& m, const uint8_t* pkt, size_t len, uint16_t cnt) {
+    size_t off = 20;
+    for (uint16_t i = 0; i < cnt && off + 2 <= len; ++i) {
+        const size_t ml = ((size_t)pkt[off] << 8) | pkt[off + 1];
+        off += 2;
+        if (ml == 0 || off + ml > len) break;
+        metrics_add(m.type_count[pkt[off]], 1);
+        off += ml;
+    }
+}
+
+// Block for the calling thread, registered under `name` on first call from
+// that thread. Never null: past METRICS_MAX_THREADS threads share a spare
+// block that is not exported.
+ThreadMetrics& metrics_thread(const char* name);
+
+// Start the exporter if cfg.listen is set:
+//   "unix:/path"         - plain text dump per connection (socat - UNIX:/path)
+//   "http://host:port"   - minimal HTTP/1.0, any GET returns the dump
+// Returns false if the listener cannot be set up.
+bool metrics_start(const MetricsConfig& cfg);
+void metrics_stop();
+
+// The current dump in Prometheus text exposition format.
+std::string metrics_render();
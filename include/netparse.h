@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Ethernet / IPv4 / UDP parsing for raw-frame receivers (AF_XDP, AF_PACKET).
+// Addresses and ports are compared in network byte order.
+
+static inline uint16_t net_be16(const uint8_t* p) {
+    return (uint16_t(p[0]) << 8) | uint16_t(p[1]);
+}
+
+// Locate the UDP payload of an Ethernet frame addressed to dst_ip:dst_port
+// (both network byte order; 0 = any). Handles up to two VLAN tags and IPv4
+// options; rejects fragments and truncated frames.
+// Returns false if the frame is not for us.
+static inline bool parse_udp_frame(const uint8_t* frame, size_t len,
+                                   uint32_t dst_ip_be, uint16_t dst_port_be,
+                                   const uint8_t** payload, uint32_t* payload_len) {
+    size_t off = 12;
+    if (len < off + 2) return false;
+
+    uint16_t ethertype = net_be16(frame + off);
+    for (int tags = 0; tags < 2 && (ethertype == 0x8100 || ethertype == 0x88A8); ++tags) {
+        off += 4;
+        if (len < off + 2) return false;
+        ethertype = net_be16(frame + off);
+    }
+    if (ethertype != 0x0800) return false;
+    off += 2;
+
+    // IPv4
+    if (len < off + 20) return false;
+    const uint8_t* ip = frame + off;
+    if ((ip[0] >> 4) != 4) return false;
+    const size_t ihl = (size_t)(ip[0] & 0x0F) * 4;
+    if (ihl < 20 || len < off + ihl) return false;
+    if (ip[9] != 17) return false;                               // UDP
+    if ((net_be16(ip + 6) & 0x3FFF) != 0) return false;          // MF or fragment offset
+
+    uint32_t daddr;
+    __builtin_memcpy(&daddr, ip + 16, 4);
+    if (dst_ip_be && daddr != dst_ip_be) return false;
+
+    const size_t ip_total = net_be16(ip + 2);
+    if (ip_total < ihl + 8 || off + ip_total > len) return false;
+    off += ihl;
+
+    // UDP
+    const uint8_t* udp = frame + off;
+    uint16_t dport;
+    __builtin_memcpy(&dport, udp + 2, 2);
+    if (dst_port_be && dport != dst_port_be) return false;
+
+    const size_t udp_len = net_be16(udp + 4);
+    if (udp_len < 8 || udp_len > ip_total - ihl) return false;
+
+    *payload = udp + 8;
+    *payload_len = (uint32_t)(udp_len - 8);
+    return true;
+}
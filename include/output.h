@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+struct DecodeOptions;
+struct OutputConfig;
+
+// Route 0 is the default sink; each configured route gets its own sink.
+constexpr int MAX_OUTPUT_ROUTES = 8;
+
+// Apply the type filter and routing table from `cfg` to `opt` and open route sinks.
+bool output_open(const OutputConfig& cfg, DecodeOptions& opt);
+
+// Decode one MoldUDP64 packet and append each route's text (or binary
+// records, see MoldRecordHeader) to its pending output. Whether it is
+// written now depends on the flush policy.
+void output_packet(const uint8_t* buf, size_t len, const DecodeOptions& opt);
+
+// Append pre-formatted text to the default route (dropped in the binary formats).
+void output_write(const char* data, size_t n);
+
+// Call after every receive batch (or recovery request), also when it came
+// back empty: flushes for the "batch" policy and enforces flush_usec for "bytes".
+void output_batch_end();
+
+// Longest time pending output may wait for output_batch_end() (0 = no limit needed).
+int output_linger_ms();
+
+// Write everything pending (one writev per route) and flush sinks.
+void output_flush();
+
+void output_close();
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Crash-restart record: session, next expected sequence and the ranges
+// recovery gave up on, in a small MAP_SHARED file. Updates are plain stores
+// into the mapping (no syscall); the page cache keeps them when the process
+// dies, so the next start can rerequest from where this one stopped and
+// try the lost ranges once more.
+//
+// `gen` is a sequence lock: odd while an update is in progress. A record
+// left odd by a crash mid-update is not trusted.
+
+constexpr uint64_t PROGRESS_MAGIC   = 0x31474f5250444c4dULL;   // "MLDPROG1"
+constexpr uint32_t PROGRESS_VERSION = 2;
+constexpr int      PROGRESS_MAX_GAPS = 16;
+
+struct ProgressGap {
+    uint64_t seq;
+    uint64_t count;
+};
+
+struct ProgressRecord {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t reserved;
+    std::atomic<uint64_t> gen;
+    char     session[10];
+    uint8_t  pad[6];
+    uint64_t expected_seq;   // next sequence after the last one delivered
+    uint64_t ngaps;
+    ProgressGap gaps[PROGRESS_MAX_GAPS];   // unrecovered ranges of `session`, oldest first
+};
+
+// Map `path` (created if missing). The record found there, if valid, is
+// kept for progress_last(). Returns false if the file cannot be mapped.
+bool progress_open(const std::string& path);
+
+// What the previous run left behind; false if there was nothing usable.
+bool progress_last(char session10[10], uint64_t& expected_seq, std::vector<ProgressGap>& gaps);
+
+// Publish the current position; no-op unless open. A new session drops
+// the ranges recorded for the old one.
+void progress_update(const char session10[10], uint64_t expected_seq);
+
+// Record a range recovery could not fill (oldest dropped when full).
+void progress_add_gap(uint64_t seq, uint64_t count);
+
+// Forget the recorded ranges (after they were rerequested again).
+void progress_clear_gaps();
+
+void progress_close();
@@ -1,16 +1,46 @@
 #pragma once
+#include <cstddef>
 #include <cstdint>
+#include <vector>
 
 struct DecodeOptions;
+struct RereqRange;
+struct ThreadMetrics;
 
+// MoldUDP64 rerequest client. Requests go to the first endpoint that is
+// answering; one that stops answering is skipped for endpoint_retry_ms and
+// the request fails over to the next. All requests share one token bucket
+// (request_rate / request_burst). Recoveries of parallel_min_messages or
+// more are split across the healthy endpoints; ranges that come back
+// ahead of the first are held in a reorder buffer until it completes.
+//
+// Answer timeouts adapt per endpoint, TCP style: SRTT + 4 RTTVAR of the
+// request -> first answer time, and a multiple of the smoothed gap between
+// answer packets once an answer is flowing. A timeout requests only what
+// is still outstanding again, with exponential backoff.
+//
+// Only answers from the endpoint asked, for the session asked, that pass
+// validate_moldudp64_packet() are used, trimmed to their messages within
+// what is still missing of the requested range. The next packet in
+// sequence is decoded; packets further on within the range are held in the
+// reorder buffer until the ones before them arrive; anything else
+// (duplicates, other ranges, other sessions) is dropped undecoded.
 class Rerequester {
 public:
     Rerequester();
     ~Rerequester();
 
-    bool open(const char* ip, uint16_t port, int rcvbuf_bytes = 16 * 1024 * 1024, int timeout_ms = 500);
+    // Primary endpoint; rate limit, split, reorder buffer and timeouts come
+    // from [RECOVERY_SETTINGS].
+    bool open(const char* ip, uint16_t port, int rcvbuf_bytes = 16 * 1024 * 1024);
+    // Further endpoints, in failover order (after open()).
+    bool add_endpoint(const char* ip, uint16_t port);
     void close();
 
+    // Count retransmits, rejected answers and RTT samples in `mt`, the
+    // block of the thread that calls recover() / download().
+    void set_metrics(ThreadMetrics& mt);
+
     // Recover missing [start_seq .. start_seq+count-1]
     // Returns messages recovered (best-effort).
     uint64_t recover(const char session10[10],
@@ -18,8 +48,53 @@ public:
                      uint64_t count,
                      const DecodeOptions& opt);
 
+    // Bulk download of [start_seq .. start_seq+count-1]: download_lanes
+    // requests in flight on their own sockets, spread over the healthy
+    // endpoints, the window sliding on as ranges complete. Output is in
+    // sequence order, each range as soon as all before it are out.
+    // Same as recover() with download_lanes < 2.
+    uint64_t download(const char session10[10],
+                      uint64_t start_seq,
+                      uint64_t count,
+                      const DecodeOptions& opt);
+
 private:
-    int fd_;
-    uint32_t ip_be_;
-    uint16_t port_be_;
+    struct Endpoint {
+        int      fd = -1;
+        uint32_t ip_be = 0;
+        uint16_t port_be = 0;
+        uint64_t down_until_ns = 0;   // skipped until then after a failure
+        uint32_t failures = 0;        // consecutive requests without an answer
+        uint64_t srtt_ns = 0;         // smoothed request -> first answer (0 = no sample yet)
+        uint64_t rttvar_ns = 0;
+        uint64_t ipg_ns = 0;          // smoothed gap between answer packets
+    };
+
+    bool     send_request(int fd, size_t idx, const char session10[10], uint64_t seq, uint16_t count);
+    void     mark_down(size_t idx, uint64_t seq, uint64_t count);
+    size_t   endpoints_up() const;
+    void     take_token();
+    uint64_t rto_ns(const Endpoint& ep) const;
+    uint64_t idle_ns(const Endpoint& ep) const;
+    void     start(RereqRange& r, const char session10[10]);
+    void     expire(RereqRange& r, const char session10[10]);
+    void     receive(RereqRange& r, const char session10[10], const DecodeOptions& opt);
+    bool     pump(RereqRange* const* active, size_t n, const char session10[10], const DecodeOptions& opt);
+    uint64_t fetch(RereqRange* ranges, size_t n, const char session10[10], const DecodeOptions& opt);
+    bool     take(RereqRange& r, const uint8_t* pkt, size_t len, const DecodeOptions& opt);
+    uint64_t request(size_t idx, const char session10[10], uint64_t seq, uint16_t count, const DecodeOptions& opt);
+    uint64_t recover_one(const char session10[10], uint64_t seq, uint16_t count, const DecodeOptions& opt);
+    uint64_t recover_split(const char session10[10], uint64_t seq, uint64_t count, const DecodeOptions& opt);
+
+    ThreadMetrics* mt_;
+    std::vector<Endpoint> eps_;
+    size_t   cur_;               // endpoint in use
+    int      rcvbuf_bytes_;
+    uint64_t min_timeout_ns_;
+    uint64_t max_timeout_ns_;
+    uint8_t* rxbuf_;             // one datagram, from the hot-path arena
+    uint8_t* reorder_;           // out-of-sequence answers and split ranges, from the arena
+    uint64_t reorder_bytes_;
+    double   tokens_;
+    uint64_t refill_ns_;
 };
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+
+// Which MoldUDP64 session the feed is on. Every packet's session is
+// classified before its sequence number means anything: a new session
+// restarts at sequence 1, and late packets of a session we already left
+// must not be taken for duplicates or gaps of the current one.
+
+enum class SessionEvent {
+    SAME,       // current session
+    FIRST,      // first session seen since start
+    ROLLOVER,   // a new session replaced the current one (see previous())
+    STALE       // a session we already left; ignore the packet
+};
+
+class SessionTracker {
+public:
+    SessionTracker();
+
+    SessionEvent observe(const char session10[10]);
+
+    // End-of-session packet of the current session; true the first time
+    // (exchanges repeat it), with `next_seq` the sequence it carries.
+    bool end(uint64_t next_seq);
+
+    bool        known() const { return known_; }
+    const char* current() const { return cur_; }
+    const char* previous() const { return prev_; }   // valid after a ROLLOVER
+    bool        previous_ended() const { return prev_ended_; }
+    bool        ended() const { return ended_; }
+    uint64_t    end_seq() const { return end_seq_; }
+    uint64_t    rollovers() const { return rollovers_; }
+
+private:
+    static constexpr int RETIRED = 4;   // sessions remembered as STALE
+
+    char cur_[10];
+    char prev_[10];
+    char retired_[RETIRED][10];
+    int  nretired_;
+    bool known_;
+    bool ended_;
+    bool prev_ended_;
+    uint64_t end_seq_;
+    uint64_t rollovers_;
+};
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Shared-memory message bus (/dev/shm/<name>): the receiver publishes each
+// raw ITCH message once per host into a single-writer, multi-reader ring
+// of fixed-size slots. Readers keep their own position, read at their own
+// pace, and detect overruns via per-slot sequence stamps.
+
+constexpr uint64_t SHM_BUS_MAGIC   = 0x4d4f4c4442555331ULL; // "MOLDBUS1"
+constexpr uint32_t SHM_BUS_VERSION = 1;
+
+struct ShmBusHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t slot_size;       // bytes per slot incl. ShmBusSlot header, power of 2
+    uint64_t slot_count;      // power of 2
+    char     session[10];     // current MoldUDP64 session
+    alignas(64) std::atomic<uint64_t> write_index;   // slots published so far
+};
+
+struct ShmBusSlot {
+    std::atomic<uint64_t> stamp;   // bus index + 1 once published, 0 while being written
+    uint64_t mold_seq;             // MoldUDP64 sequence number of the message
+    uint64_t recv_ns;              // CLOCK_REALTIME at receive
+    uint16_t len;                  // original message length
+    uint8_t  flags;                // SHM_BUS_TRUNCATED
+    uint8_t  pad[5];
+    // payload follows (slot_size - sizeof(ShmBusSlot) bytes)
+};
+
+constexpr uint8_t SHM_BUS_TRUNCATED = 0x01;
+
+// Message as seen by a reader (payload copied into caller memory).
+struct ShmBusMessage {
+    uint64_t mold_seq;
+    uint64_t recv_ns;
+    uint16_t len;        // original length
+    uint16_t copied;     // bytes copied into the caller buffer
+    uint8_t  flags;
+};
+
+class ShmBusWriter {
+public:
+    ShmBusWriter();
+    ~ShmBusWriter();
+
+    bool open(const std::string& name, uint64_t slot_count, uint32_t slot_size);
+    void close();
+
+    bool is_open() const { return hdr_ != nullptr; }
+
+    void set_session(const char session10[10]);
+    void publish(uint64_t mold_seq, uint64_t recv_ns, const uint8_t* msg, uint16_t len);
+
+private:
+    ShmBusHeader* hdr_;
+    uint8_t* slots_;
+    size_t map_len_;
+    uint64_t mask_;
+    uint32_t payload_cap_;
+};
+
+class ShmBusReader {
+public:
+    ShmBusReader();
+    ~ShmBusReader();
+
+    // Attach to an existing bus; starts at the current write position.
+    bool open(const std::string& name);
+    void close();
+
+    // Read the next message into `payload` (up to `cap` bytes).
+    // Returns 1 if a message was read, 0 if none is available, -1 on overrun
+    // (`lost` is set to the number of skipped messages and the reader resyncs).
+    int read(ShmBusMessage& m, uint8_t* payload, size_t cap, uint64_t& lost);
+
+    uint64_t position() const { return pos_; }
+    const char* session() const { return hdr_ ? hdr_->session : nullptr; }
+
+private:
+    const ShmBusHeader* hdr_;
+    const uint8_t* slots_;
+    size_t map_len_;
+    uint64_t mask_;
+    uint32_t slot_size_;
+    uint64_t pos_;
+};
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "uring.h"
+
+struct iovec;
+
+// Destination for decoded output. write() may buffer; flush() pushes
+// anything pending to the underlying target.
+class OutputSink {
+public:
+    virtual ~OutputSink() {}
+
+    virtual bool write(const char* data, size_t n) = 0;
+    virtual bool writev(const struct iovec* iov, int iovcnt);
+    virtual void flush() {}
+
+    // Output is binary records (MoldRecordHeader, delimited by `size`)
+    // instead of text lines. Each write() carries whole records.
+    virtual void set_binary_records(bool on) { (void)on; }
+};
+
+// Discards everything ("none").
+class NullSink : public OutputSink {
+public:
+    bool write(const char*, size_t) override { return true; }
+};
+
+// Unbuffered: one write(2) per call (stdout, stderr, fd:N, pipes).
+class FdSink : public OutputSink {
+public:
+    FdSink(int fd, bool owned);
+    ~FdSink() override;
+
+    bool write(const char* data, size_t n) override;
+    bool writev(const struct iovec* iov, int iovcnt) override;
+
+private:
+    int fd_;
+    bool owned_;
+};
+
+// Large-buffer file writer: accumulates output and writes only when the
+// buffer fills or on flush().
+class BufferedFileSink : public OutputSink {
+public:
+    BufferedFileSink();
+    ~BufferedFileSink() override;
+
+    bool open(const std::string& path, size_t buf_bytes);
+    bool write(const char* data, size_t n) override;
+    bool writev(const struct iovec* iov, int iovcnt) override;
+    void flush() override;
+
+private:
+    int fd_;
+    char* buf_;
+    size_t cap_;
+    size_t len_;
+};
+
+// io_uring file writer: output is copied into one of a few large buffers
+// and each full (or flushed) buffer is written asynchronously at an
+// explicit file offset, so the caller never blocks on disk I/O unless all
+// buffers are still in flight. Falls back to synchronous writes if
+// io_uring is unavailable.
+class UringFileSink : public OutputSink {
+public:
+    UringFileSink();
+    ~UringFileSink() override;
+
+    bool open(const std::string& path, size_t buf_bytes);
+    bool write(const char* data, size_t n) override;
+    void flush() override;
+
+private:
+    static constexpr int NBUF = 4;
+
+    void submit_current();
+    void wait_buffer(int idx);
+    void reap(bool wait);
+
+    IoUring ring_;
+    bool uring_ok_;
+    int fd_;
+    uint64_t file_off_;
+    char* bufs_[NBUF];
+    size_t lens_[NBUF];
+    uint64_t offs_[NBUF];     // file offset of each in-flight buffer
+    bool busy_[NBUF];
+    size_t cap_;
+    int cur_;
+    int inflight_;
+};
+
+// Shared-memory byte ring (/dev/shm/<name>). Single writer; any number of
+// readers follow `write_pos` at their own pace and detect overruns when
+// they fall more than `capacity` bytes behind. The writer claims bytes in
+// `reserve_pos` before copying them in, so a reader can tell a copy it
+// raced with from a clean one. Every write() holds whole lines or records;
+// a reader that was lapped resumes at the newest write's start. A writer
+// that (re)opens the ring bumps `epoch` and starts again from 0.
+struct ShmRingHeader {
+    std::atomic<uint64_t> magic;       // 0 while the writer (re)initializes
+    uint64_t capacity;                 // data bytes, power of 2
+    std::atomic<uint64_t> epoch;       // bumped by every ShmRingSink::open()
+    alignas(64) std::atomic<uint64_t> reserve_pos;  // end of the bytes being written
+    std::atomic<uint64_t> last_write;  // start of the newest complete write
+    alignas(64) std::atomic<uint64_t> write_pos;    // total bytes ever written
+};
+
+constexpr uint64_t SHM_RING_MAGIC = 0x4d4f4c4452494e32ULL; // "MOLDRIN2"
+
+class ShmRingSink : public OutputSink {
+public:
+    ShmRingSink();
+    ~ShmRingSink() override;
+
+    bool open(const std::string& name, size_t capacity);
+    bool write(const char* data, size_t n) override;
+
+private:
+    ShmRingHeader* hdr_;
+    char* data_;
+    size_t map_len_;
+};
+
+class ShmRingReader {
+public:
+    ShmRingReader();
+    ~ShmRingReader();
+
+    // Attach to an existing ring; starts reading at the current write position.
+    bool open(const std::string& name);
+
+    // Copy up to `cap` new bytes. Sets `overrun` (and skips ahead to the
+    // start of the newest write) if the writer lapped us, and after the
+    // writer reopened the ring. Returns bytes copied (0 if nothing new).
+    size_t read(char* out, size_t cap, bool& overrun);
+
+    void close();
+
+private:
+    const ShmRingHeader* hdr_;
+    const char* data_;
+    size_t map_len_;
+    uint64_t read_pos_;
+    uint64_t epoch_;
+    std::string name_;
+};
+
+// UDP unicast/multicast republish. Output is split into datagrams of at
+// most `max_payload` bytes on line boundaries, or with binary records on
+// record boundaries (a record bigger than that goes out on its own), so a
+// lost datagram never leaves a partial line or record behind.
+class UdpSink : public OutputSink {
+public:
+    UdpSink();
+    ~UdpSink() override;
+
+    // interface_ip is only used for multicast destinations ("" = default route).
+    bool open(const std::string& ip, uint16_t port,
+              const std::string& interface_ip, int ttl, size_t max_payload);
+    bool write(const char* data, size_t n) override;
+    void set_binary_records(bool on) override { records_ = on; }
+
+private:
+    size_t next_datagram(const char* data, size_t n) const;
+
+    int fd_;
+    size_t max_payload_;
+    bool records_;
+};
+
+// Build a sink from a target spec:
+//   none                             discard
+//   stdout | stderr | fd:<n>         unbuffered fd
+//   pipe:<path>                      named pipe (created if missing), unbuffered
+//   file:<path> | <path>             buffered file (file_buffer_bytes)
+//   uring:<path>                     io_uring async file writes (file_buffer_bytes per buffer)
+//   shm:<name>[:<bytes>]             shared-memory ring
+//   udp:<ip>:<port>[:<ttl>]          UDP republish (multicast if ip is class D)
+// Returns nullptr (after logging) on failure.
+std::unique_ptr<OutputSink> make_sink(const std::string& spec,
+                                      size_t file_buffer_bytes,
+                                      const std::string& interface_ip);
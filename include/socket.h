@@ -1,19 +1,35 @@
 #pragma once
 
+#include <memory>
 #include <string>
+#include <vector>
 #include <cstdint>
 #include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "uring.h"
+
+struct ReceiveConfig;
+
+// Upper bound for recv_packets() batch size
+constexpr int MAX_RX_BATCH = 256;
+
+// One received datagram. `data` stays valid until the receiver's release().
+struct RxPacket {
+    const uint8_t* data;
+    uint32_t       len;
+};
 
 class UdpMcastReceiver {
 public:
     UdpMcastReceiver();
-    ~UdpMcastReceiver();
+    virtual ~UdpMcastReceiver();
 
     // Join multicast group on interface, optional SSM source IP
-    bool open(const std::string& mcast_ip,
-              uint16_t mcast_port,
-              const std::string& interface_ip,
-              const std::string& source_ip); // "" => ASM, else SSM
+    virtual bool open(const std::string& mcast_ip,
+                      uint16_t mcast_port,
+                      const std::string& interface_ip,
+                      const std::string& source_ip); // "" => ASM, else SSM
 
     // Receive one datagram
     // returns bytes received, 0/neg on error
@@ -23,11 +39,206 @@ public:
     // Returns number of packets received, or -1 on error/timeout.
     int recv_batch(struct mmsghdr* msgvec, int vlen);
 
+    // Receive up to `max` packets into receiver-owned buffers.
+    // Returns number of packets, or -1 on error/timeout.
+    virtual int recv_packets(RxPacket* out, int max);
+
+    // Hand the buffers of the last recv_packets() back to the receiver.
+    virtual void release() {}
+
+    // recvmmsg geometry: `batch` slots of `slot_size` bytes in one slab.
+    // Must be called before the first recv_packets().
+    void set_batch_geometry(uint32_t slot_size, uint32_t batch);
+
     // Optional: increase OS receive buffer
     bool set_rcvbuf(int bytes);
 
-    void close();
+    // Optional: make recv/recv_batch return -1 after `ms` without data (0 = block forever)
+    virtual bool set_timeout_ms(int ms);
+
+    // Datagrams the kernel dropped on our side since open() because the
+    // receive queue (socket buffer, ring, UMEM) was full. Lets a gap be told
+    // apart from loss upstream. Only advances as packets are received.
+    virtual uint64_t local_drops();
+
+    virtual void close();
+
+protected:
+    // Pick up the SO_RXQ_OVFL counter from a received message's control data.
+    void note_drops(const struct msghdr& mh);
 
-private:
     int fd_;
+    int timeout_ms_;
+    uint64_t trunc_count_;   // datagrams that did not fit the receive buffer
+
+private:
+    bool alloc_slab();
+
+    // recvmmsg() buffers for recv_packets(). Each datagram gets an MTU-sized
+    // slot in a contiguous slab plus a spill iovec into a lazily touched
+    // jumbo area; oversized datagrams are stitched together there.
+    uint32_t slot_size_;
+    uint32_t batch_;
+    uint8_t* slab_;
+    size_t slab_len_;
+    uint8_t* jumbo_;
+    size_t jumbo_len_;
+    uint64_t jumbo_count_;
+    std::vector<struct iovec> iov_;
+    std::vector<struct mmsghdr> msgs_;
+    std::vector<uint64_t> ctrl_;   // per-message control buffers (SO_RXQ_OVFL)
+    uint32_t ovfl_last_;           // last raw SO_RXQ_OVFL value (wraps at 2^32)
+    uint64_t rx_drops_;
 };
+
+// io_uring backend: one multishot recvmsg on the joined socket, with
+// datagrams landing in a provided buffer ring. Buffers are recycled on
+// release(). Falls back to recvmmsg if io_uring is unavailable.
+class UringMcastReceiver : public UdpMcastReceiver {
+public:
+    UringMcastReceiver();
+    ~UringMcastReceiver() override;
+
+    bool open(const std::string& mcast_ip,
+              uint16_t mcast_port,
+              const std::string& interface_ip,
+              const std::string& source_ip) override;
+
+    int  recv_packets(RxPacket* out, int max) override;
+    void release() override;
+    void close() override;
+
+private:
+    bool arm();
+
+    IoUring ring_;
+    bool uring_ok_;
+    bool armed_;
+    struct msghdr msg_;            // multishot recvmsg template (no name, SO_RXQ_OVFL control)
+    uint8_t* slab_;
+    size_t slab_len_;
+    std::vector<uint16_t> used_;   // buffer ids handed out since last release()
+};
+
+// AF_PACKET TPACKET_V3 backend: a block ring mmap'd from the kernel,
+// filtered to our group:port by a classic BPF program. Frames are parsed
+// in place and payloads point into the ring blocks; a block goes back to
+// the kernel on the release() after its last packet was handed out.
+// The UDP socket only keeps the group joined and drops everything it sees.
+// Falls back to recvmmsg if the ring cannot be set up.
+class PacketRingReceiver : public UdpMcastReceiver {
+public:
+    explicit PacketRingReceiver(const ReceiveConfig& rc);
+    ~PacketRingReceiver() override;
+
+    bool open(const std::string& mcast_ip,
+              uint16_t mcast_port,
+              const std::string& interface_ip,
+              const std::string& source_ip) override;
+
+    int  recv_packets(RxPacket* out, int max) override;
+    void release() override;
+    uint64_t local_drops() override;
+    void close() override;
+
+protected:
+    // Join through the UDP socket and resolve the interface; no ring yet.
+    bool open_joined(const std::string& mcast_ip,
+                     uint16_t mcast_port,
+                     const std::string& interface_ip,
+                     const std::string& source_ip);
+    bool setup_ring();
+    void close_ring();
+    // Make the joined UDP socket discard everything once a raw path is up.
+    void mute_udp_socket();
+
+    std::string ifname_;
+    int ifindex_;
+    uint32_t group_be_;
+    uint16_t port_be_;
+    uint32_t source_be_;    // SSM source, 0 = any
+
+private:
+    void finish_block();
+
+    uint32_t block_size_;
+    uint32_t block_nr_;
+    uint32_t block_tov_ms_;
+
+    int pkt_fd_;
+    uint8_t* ring_;
+    size_t ring_len_;
+    uint32_t cur_block_;           // block being read
+    uint32_t pkts_left_;           // packets not yet handed out in cur_block_
+    const uint8_t* next_pkt_;      // next tpacket3_hdr in cur_block_
+    bool cur_handed_;              // cur_block_ has packets out with the caller
+    uint64_t ring_drops_;          // PACKET_STATISTICS tp_drops, summed (reading resets them)
+    std::vector<uint32_t> done_;   // fully consumed blocks, returned on release()
+};
+
+// AF_XDP backend: still joins the group through the UDP socket (IGMP, NIC
+// multicast filter), but a small XDP program redirects frames for our
+// group:port on one RX queue into an XSK socket. Ethernet/IPv4/UDP headers
+// are parsed here and payloads are handed to the decoder in place from the
+// UMEM frames, which go back to the fill ring on release().
+// Only untagged, unfragmented IPv4 frames without IP options on xdp_queue
+// are redirected. The feed should be steered to that one queue (flow rule
+// or single-queue NIC); matching frames on any other queue, and the ones
+// the program does not parse, reach the UDP socket, which stays live:
+// they are still received, counted and warned about, at kernel-path cost.
+// Falls back to the TPACKET_V3 ring, then recvmmsg, if AF_XDP setup fails.
+class XdpMcastReceiver : public PacketRingReceiver {
+public:
+    explicit XdpMcastReceiver(const ReceiveConfig& rc);
+    ~XdpMcastReceiver() override;
+
+    bool open(const std::string& mcast_ip,
+              uint16_t mcast_port,
+              const std::string& interface_ip,
+              const std::string& source_ip) override;
+
+    int  recv_packets(RxPacket* out, int max) override;
+    void release() override;
+    uint64_t local_drops() override;
+    void close() override;
+
+private:
+    struct Ring {
+        uint32_t* producer = nullptr;
+        uint32_t* consumer = nullptr;
+        uint32_t* flags = nullptr;
+        void*     desc = nullptr;
+        uint32_t  mask = 0;
+        void*     map = nullptr;
+        size_t    map_len = 0;
+    };
+
+    bool setup_xsk();
+    bool load_program();
+    bool map_ring(Ring& r, int opt_off_idx, uint64_t pgoff, uint32_t entries, size_t desc_size);
+    void refill(const uint64_t* addrs, size_t n);
+    int  recv_kernel_path(RxPacket* out, int max);
+    void close_xsk();
+
+    uint32_t queue_id_;
+    bool native_;
+    int xsk_fd_;
+    int map_fd_;
+    int prog_fd_;
+    int link_fd_;
+
+    uint8_t* umem_;
+    size_t umem_len_;
+    Ring rx_, fill_, comp_;
+
+    std::vector<uint64_t> used_;   // frames handed out since last release()
+    uint64_t kernel_path_;         // feed datagrams that came through the UDP socket instead
+    uint32_t rx_calls_;
+    bool xdp_ok_;
+};
+
+// Name of the interface holding IPv4 address `ip`, or "" if none.
+std::string interface_name_for_ip(const std::string& ip);
+
+// backend: "recvmmsg" (default) | "io_uring" | "af_xdp" | "packet_ring"
+std::unique_ptr<UdpMcastReceiver> make_receiver(const ReceiveConfig& rc);
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+struct DecodeOptions;
+struct SnapshotConfig;
+
+// Last-value state cache with periodic binary snapshots, for restarts that
+// should not replay a whole session through rerequest.
+//
+// Every delivered packet (live or recovered, in sequence order) updates the
+// cache: per message type, the latest message for each value of the key
+// field (SecurityId by default); types without that field keep just their
+// latest message. The cache therefore always corresponds to one sequence
+// number - the next one expected - and a snapshot of it plus a rerequest
+// of the delta since then rebuilds the state of any later point.
+//
+// That only holds if the cache saw every message from sequence 1: a run
+// that joined live, or left a gap unrecovered, keeps a cache from its
+// first sequence on but writes no snapshots, and state_load() accepts
+// only snapshots that start at 1.
+//
+// The receive thread logs each change to the cache; at a snapshot it hands
+// that log to a background thread, which applies it to its own copy of the
+// cache, serialises the copy and writes it to <path>.tmp, fsync'd and
+// renamed over <path>, so a crash leaves either the old or the new file,
+// never half.
+//
+// File layout (host byte order):
+//   SnapshotHeader, then `entries` records of { u64 seq, u16 len, len bytes }.
+//   `checksum` is FNV-1a 64 over everything after the header.
+
+constexpr uint64_t SNAPSHOT_MAGIC   = 0x31504e53444c4f4dULL;   // "MOLDSNP1"
+constexpr uint32_t SNAPSHOT_VERSION = 2;
+
+struct SnapshotHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t reserved;
+    char     session[10];
+    uint8_t  pad[6];
+    uint64_t first_seq;     // first sequence reflected in the state (always 1)
+    uint64_t next_seq;      // first sequence number NOT reflected in the state
+    uint64_t entries;
+    uint64_t body_bytes;
+    uint64_t checksum;
+};
+
+// Enable the cache (no-op if cfg.path is empty). Resolves the key field per
+// message type from the loaded spec.
+bool state_open(const SnapshotConfig& cfg);
+
+// Apply one in-sequence MoldUDP64 packet (called wherever packets are
+// delivered in order: the receive loop and recovery).
+void state_apply(const uint8_t* pkt, size_t len);
+
+// Write a snapshot if interval_msgs / interval_sec has passed. Call once
+// per receive batch.
+void state_maybe_checkpoint();
+
+// Drop all state (new session).
+void state_reset();
+
+// Load `path` into the cache. Returns false if missing, corrupt or not
+// covering the session from sequence 1.
+bool state_load(const std::string& path, char session10[10], uint64_t& next_seq);
+
+// Emit the cached messages through the output module, in sequence order.
+size_t state_replay(const DecodeOptions& opt);
+
+// Number of cached messages.
+size_t state_size();
+
+// Final snapshot, then stop the writer.
+void state_close();
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <linux/io_uring.h>
+
+// Minimal io_uring wrapper on the raw syscalls (no liburing dependency):
+// SQ/CQ ring mapping, submission, completion reaping and provided buffer rings.
+class IoUring {
+public:
+    IoUring();
+    ~IoUring();
+
+    bool init(unsigned entries);
+    void close();
+
+    bool is_open() const { return fd_ >= 0; }
+
+    // Next free SQE (zeroed), or nullptr if the SQ is full.
+    io_uring_sqe* get_sqe();
+
+    // Submit queued SQEs. With wait_nr > 0 blocks until that many CQEs are
+    // ready or `timeout_ms` expires (timeout_ms < 0 = no timeout).
+    // Returns SQEs submitted, or -errno.
+    int submit(unsigned wait_nr = 0, int timeout_ms = -1);
+
+    // Completion at the head of the CQ, or nullptr if empty.
+    io_uring_cqe* peek_cqe();
+    void cqe_seen();
+
+    // Provided buffer ring: `count` (power of 2) buffers of `buf_size`
+    // bytes carved from `base`, registered as buffer group `bgid`.
+    bool setup_buf_ring(uint16_t bgid, uint8_t* base, unsigned count, unsigned buf_size);
+
+    // Return buffer `bid` to the ring (visible after buf_ring_publish()).
+    void buf_ring_add(uint16_t bid);
+    void buf_ring_publish();
+
+private:
+    int fd_;
+
+    // SQ
+    unsigned* sq_head_;
+    unsigned* sq_tail_;
+    unsigned* sq_array_;
+    unsigned  sq_mask_;
+    unsigned  sq_entries_;
+    unsigned  sqe_tail_;
+    io_uring_sqe* sqes_;
+
+    // CQ
+    unsigned* cq_head_;
+    unsigned* cq_tail_;
+    unsigned  cq_mask_;
+    io_uring_cqe* cqes_;
+
+    void*  sq_ring_;
+    size_t sq_ring_len_;
+    void*  cq_ring_;
+    size_t cq_ring_len_;
+    size_t sqes_len_;
+
+    // provided buffers
+    io_uring_buf_ring* br_;
+    size_t   br_len_;
+    uint8_t* br_base_;
+    unsigned br_mask_;
+    unsigned br_buf_size_;
+    uint16_t br_tail_;
+    uint16_t br_bgid_;
+};
@@ -0,0 +1,117 @@
+#include "arena.h"
+
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <sys/mman.h>
+
+static constexpr size_t HUGE_PAGE = 2u << 20;
+
+static std::mutex g_mu;
+static uint8_t* g_base = nullptr;
+static size_t g_cap = 0;
+static size_t g_used = 0;
+static size_t g_last = 0;          // offset of the most recent allocation
+static size_t g_fallback = 0;
+static bool g_hugetlb = false;
+static bool g_lock = false;
+static bool g_locked = false;
+
+static inline size_t round_up(size_t n, size_t a) { return (n + a - 1) & ~(a - 1); }
+
+// Anonymous mapping, hugepage-backed if possible, every page touched.
+static void* map_prefaulted(size_t len, bool hugepages, bool* hugetlb) {
+    void* p = MAP_FAILED;
+    if (hugepages) {
+        p = ::mmap(nullptr, len, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+    }
+    if (p != MAP_FAILED) {
+        if (hugetlb) *hugetlb = true;
+        return p;
+    }
+
+    p = ::mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) return nullptr;
+    if (hugepages) ::madvise(p, len, MADV_HUGEPAGE);
+    std::memset(p, 0, len);        // fault in now (and let THP collapse it)
+    if (hugetlb) *hugetlb = false;
+    return p;
+}
+
+bool arena_init(size_t bytes, bool hugepages, bool lock) {
+    std::lock_guard<std::mutex> lk(g_mu);
+    if (g_base || bytes == 0) return g_base != nullptr;
+
+    g_cap = round_up(bytes, HUGE_PAGE);
+    void* p = map_prefaulted(g_cap, hugepages, &g_hugetlb);
+    if (!p) {
+        perror("arena mmap");
+        g_cap = 0;
+        return false;
+    }
+    g_base = static_cast<uint8_t*>(p);
+    g_used = g_last = 0;
+    g_lock = lock;
+
+    if (lock) {
+        g_locked = ::mlock(g_base, g_cap) == 0;
+        if (!g_locked) std::cerr << "WARN: arena mlock failed (RLIMIT_MEMLOCK?), continuing unlocked\n";
+    }
+
+    std::cerr << "INFO: arena " << (g_cap >> 20) << " MB"
+              << (g_hugetlb ? " on hugetlb pages" : (hugepages ? " (THP)" : ""))
+              << (g_locked ? ", locked" : "") << "\n";
+    return true;
+}
+
+void* arena_alloc(size_t bytes, size_t align) {
+    if (bytes == 0) return nullptr;
+    if (align < 64) align = 64;
+
+    {
+        std::lock_guard<std::mutex> lk(g_mu);
+        if (g_base) {
+            const size_t off = round_up(g_used, align);
+            if (off + bytes <= g_cap) {
+                g_last = off;
+                g_used = off + bytes;
+                return g_base + off;       // zero from the initial prefault or arena_free()
+            }
+        }
+    }
+
+    // Fallback: its own mapping, same treatment as the arena.
+    const size_t len = round_up(bytes, 4096);
+    void* p = map_prefaulted(len, len >= HUGE_PAGE, nullptr);
+    if (!p) return nullptr;
+    if (g_lock) ::mlock(p, len);
+
+    std::lock_guard<std::mutex> lk(g_mu);
+    g_fallback += len;
+    return p;
+}
+
+void arena_free(void* p, size_t bytes) {
+    if (!p) return;
+
+    std::lock_guard<std::mutex> lk(g_mu);
+    auto* b = static_cast<uint8_t*>(p);
+    if (g_base && b >= g_base && b < g_base + g_cap) {
+        const size_t off = (size_t)(b - g_base);
+        if (off == g_last && off + bytes == g_used) {
+            std::memset(b, 0, bytes);
+            g_used = off;
+        }
+        return;
+    }
+
+    const size_t len = round_up(bytes, 4096);
+    ::munmap(p, len);
+    g_fallback -= (g_fallback >= len) ? len : g_fallback;
+}
+
+ArenaStats arena_stats() {
+    std::lock_guard<std::mutex> lk(g_mu);
+    return ArenaStats{g_cap, g_used, g_fallback, g_hugetlb, g_locked};
+}
@@ -0,0 +1,152 @@
+#include "builder.h"
+#include "config.h"
+
+#include <cstring>
+
+void push_be16(std::vector<uint8_t>& b, uint16_t v) {
+    b.push_back(uint8_t((v >> 8) & 0xFF));
+    b.push_back(uint8_t(v & 0xFF));
+}
+
+void push_be32(std::vector<uint8_t>& b, uint32_t v) {
+    for (int s = 24; s >= 0; s -= 8) b.push_back(uint8_t((v >> s) & 0xFF));
+}
+
+void push_be64(std::vector<uint8_t>& b, uint64_t v) {
+    for (int s = 56; s >= 0; s -= 8) b.push_back(uint8_t((v >> s) & 0xFF));
+}
+
+void push_str_fixed(std::vector<uint8_t>& b, const char* s, size_t n) {
+    size_t sl = std::strlen(s);
+    for (size_t i = 0; i < n; ++i) {
+        char c = (i < sl) ? s[i] : ' ';
+        b.push_back(uint8_t(c));
+    }
+}
+
+static inline void put_be(uint8_t* p, uint64_t v, size_t n) {
+    for (size_t i = 0; i < n; ++i) p[i] = uint8_t(v >> (8 * (n - 1 - i)));
+}
+
+static inline bool contains(const std::string& s, const char* what) {
+    return s.find(what) != std::string::npos;
+}
+
+// cheap deterministic mixing so neighbouring salts give different digits
+static inline uint64_t mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    return x;
+}
+
+std::vector<uint8_t> build_message(const MsgSpec& spec, uint64_t salt) {
+    std::vector<uint8_t> m(spec.total_length, 0);
+    if (m.empty()) return m;
+
+    const uint64_t r = mix(salt + 1);
+    for (size_t fi = 0; fi < spec.fields.size(); ++fi) {
+        const FieldSpec& f = spec.fields[fi];
+        uint8_t* p = m.data() + f.offset;
+        const uint64_t v = mix(r + fi);
+
+        if (f.offset == 0) {             // message type byte
+            p[0] = (uint8_t)spec.msg_type;
+            continue;
+        }
+
+        switch (f.type) {
+            case FieldType::CHAR:
+                p[0] = (uint8_t)('A' + v % 26);
+                break;
+            case FieldType::UINT8:
+                p[0] = (uint8_t)(v % 10);
+                break;
+            case FieldType::UINT16:
+            case FieldType::INT16:
+                put_be(p, v % 10000, 2);
+                break;
+            case FieldType::UINT32:
+            case FieldType::INT32:
+                put_be(p, 100 + v % 1000000, 4);
+                break;
+            case FieldType::UINT64:
+            case FieldType::INT64:
+                if (contains(f.name, "Timestamp")) {
+                    put_be(p, 1767085795602695293ULL + salt * 1000, 8);   // ns since epoch, increasing
+                } else if (contains(f.name, "Price")) {
+                    put_be(p, (100000 + v % 9000000) * 100, 8);            // 4 implied decimals
+                } else {
+                    put_be(p, v % 100000000000ULL, 8);
+                }
+                break;
+            case FieldType::STRING: {
+                static const char ALNUM[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+                uint64_t x = v;
+                for (size_t i = 0; i < f.size; ++i) {
+                    p[i] = (uint8_t)ALNUM[x % 36];
+                    x = x / 36 + mix(x + i);
+                }
+                break;
+            }
+            case FieldType::BINARY:
+                for (size_t i = 0; i < f.size; ++i) p[i] = (uint8_t)(v >> (8 * (i & 7)));
+                break;
+        }
+    }
+    return m;
+}
+
+std::vector<uint8_t> build_mold_packet(const char session10[10],
+                                       uint64_t start_seq,
+                                       const std::vector<std::vector<uint8_t>>& msgs) {
+    std::vector<uint8_t> p;
+    size_t total = 10 + 8 + 2;
+    for (const auto& m : msgs) total += 2 + m.size();
+    p.reserve(total);
+
+    for (int i = 0; i < 10; ++i) p.push_back(uint8_t(session10[i]));
+    push_be64(p, start_seq);
+    push_be16(p, (uint16_t)msgs.size());
+
+    for (const auto& m : msgs) {
+        push_be16(p, (uint16_t)m.size());
+        p.insert(p.end(), m.begin(), m.end());
+    }
+    return p;
+}
+
+// ---------- MoldPacketBuilder ----------
+
+static constexpr size_t MOLD_HEADER_BYTES = 20;
+
+MoldPacketBuilder::MoldPacketBuilder(size_t max_bytes)
+    : buf_(max_bytes < MOLD_HEADER_BYTES ? MOLD_HEADER_BYTES : max_bytes, 0),
+      len_(0), seq_(0), count_(0) {}
+
+void MoldPacketBuilder::set_count(uint16_t c) {
+    count_ = c;
+    put_be(buf_.data() + 18, c, 2);
+}
+
+void MoldPacketBuilder::begin(const char session10[10], uint64_t seq) {
+    std::memcpy(buf_.data(), session10, 10);
+    put_be(buf_.data() + 10, seq, 8);
+    seq_ = seq;
+    len_ = MOLD_HEADER_BYTES;
+    set_count(0);
+}
+
+bool MoldPacketBuilder::add(const uint8_t* msg, uint16_t len) {
+    if (count_ == 0xFFFE || len_ + 2 + len > buf_.size()) return false;
+    put_be(buf_.data() + len_, len, 2);
+    std::memcpy(buf_.data() + len_ + 2, msg, len);
+    len_ += 2 + (size_t)len;
+    set_count((uint16_t)(count_ + 1));
+    return true;
+}
+
+void MoldPacketBuilder::end_of_session() {
+    len_ = MOLD_HEADER_BYTES;
+    set_count(0xFFFF);
+}
@@ -166,7 +166,7 @@ void load_config(const char* ini_path) {
 
     while (std::getline(f, line)) {
         line = trim(line);
-        if (line.empty() || line[0] == '#' || line[0] == ';' || line[0] == '[') continue;
+        if (line.empty() || line[0] == '#' || line[0] == ';') continue;
 
         if (line.front() == '[' && line.back() == ']') {
             section = to_lower(trim(line.substr(1, line.size() - 2)));
@@ -190,12 +190,129 @@ void load_config(const char* ini_path) {
             else if (key == "protocol_spec")          spec_rel = val;
         }
 
+        // RECEIVE SECTION
+        if (section == "receive") {
+            if      (key == "backend")               g_cfg.rx.backend = val;
+            else if (key == "batch")                 g_cfg.rx.batch = (uint32_t)std::stoul(val);
+            else if (key == "slot_size")             g_cfg.rx.slot_size = (uint32_t)std::stoul(val);
+            else if (key == "xdp_queue")             g_cfg.rx.xdp_queue = (uint32_t)std::stoul(val);
+            else if (key == "xdp_mode")              g_cfg.rx.xdp_mode = val;
+            else if (key == "ring_block_size")       g_cfg.rx.ring_block_size = (uint32_t)std::stoul(val);
+            else if (key == "ring_blocks")           g_cfg.rx.ring_blocks = (uint32_t)std::stoul(val);
+            else if (key == "ring_block_timeout_ms") g_cfg.rx.ring_block_timeout_ms = (uint32_t)std::stoul(val);
+            else if (key == "stall_ms")              g_cfg.rx.stall_ms = (uint32_t)std::stoul(val);
+        }
+
         // RECOVERY_SETTINGS SECTION
+        // endpoint: 10.68.0.64:12003
         if (section == "recovery_settings") {
             if (key == "max_recovery_message_count") {
-                g_cfg.recovery.max_recovery_message_count = (uint16_t)std::stoi(val);
+                // every request and download step asks for this many messages
+                const unsigned long n = std::stoul(val);
+                if (n == 0 || n > 0xFFFF) {
+                    throw std::runtime_error("max_recovery_message_count must be 1..65535: " + val);
+                }
+                g_cfg.recovery.max_recovery_message_count = (uint16_t)n;
+            } else if (key == "endpoint") {
+                auto colon = val.rfind(':');
+                if (colon == std::string::npos || colon == 0) {
+                    throw std::runtime_error("Invalid endpoint (expected '<ip>:<port>'): " + val);
+                }
+                RerequestEndpoint e;
+                e.ip   = trim(val.substr(0, colon));
+                e.port = (uint16_t)std::stoi(val.substr(colon + 1));
+                g_cfg.recovery.endpoints.push_back(std::move(e));
+            } else if (key == "request_rate") {
+                g_cfg.recovery.request_rate = std::stod(val);
+            } else if (key == "request_burst") {
+                g_cfg.recovery.request_burst = (uint32_t)std::stoul(val);
+            } else if (key == "parallel_min_messages") {
+                g_cfg.recovery.parallel_min_messages = std::stoull(val);
+            } else if (key == "endpoint_retry_ms") {
+                g_cfg.recovery.endpoint_retry_ms = (uint32_t)std::stoul(val);
+            } else if (key == "reorder_bytes") {
+                g_cfg.recovery.reorder_bytes = std::stoull(val);
+            } else if (key == "timeout_ms") {
+                g_cfg.recovery.timeout_ms = (uint32_t)std::stoul(val);
+            } else if (key == "min_timeout_us") {
+                g_cfg.recovery.min_timeout_us = (uint32_t)std::stoul(val);
+            } else if (key == "retries") {
+                g_cfg.recovery.retries = (uint32_t)std::stoul(val);
+            } else if (key == "download_lanes") {
+                g_cfg.recovery.download_lanes = (uint32_t)std::stoul(val);
+            } else if (key == "download_segment_bytes") {
+                g_cfg.recovery.download_segment_bytes = std::stoull(val);
+            }
+        }
+
+        // OUTPUT SECTION
+        // route: E,P > trades.log
+        if (section == "output") {
+            if (key == "message_types") {
+                g_cfg.output.message_types = val;
+            } else if (key == "sink") {
+                g_cfg.output.sink = val;
+            } else if (key == "format") {
+                g_cfg.output.format = val;
+            } else if (key == "file_buffer_bytes") {
+                g_cfg.output.file_buffer_bytes = (size_t)std::stoull(val);
+            } else if (key == "flush_policy") {
+                g_cfg.output.flush_policy = val;
+            } else if (key == "flush_bytes") {
+                g_cfg.output.flush_bytes = (size_t)std::stoull(val);
+            } else if (key == "flush_usec") {
+                g_cfg.output.flush_usec = (uint32_t)std::stoul(val);
+            } else if (key == "route") {
+                auto gt = val.find('>');
+                if (gt == std::string::npos) {
+                    throw std::runtime_error("Invalid route (expected '<types> > <target>'): " + val);
+                }
+                OutputRoute r;
+                r.types  = trim(val.substr(0, gt));
+                r.target = trim(val.substr(gt + 1));
+                if (r.types.empty() || r.target.empty()) {
+                    throw std::runtime_error("Invalid route: " + val);
+                }
+                g_cfg.output.routes.push_back(std::move(r));
             }
         }
+
+        // BUS SECTION
+        if (section == "bus") {
+            if      (key == "name")      g_cfg.bus.name = val;
+            else if (key == "slots")     g_cfg.bus.slots = std::stoull(val);
+            else if (key == "slot_size") g_cfg.bus.slot_size = (uint32_t)std::stoul(val);
+        }
+
+        // THREADS SECTION
+        if (section == "threads") {
+            if      (key == "rx_cpu")      g_cfg.threads.rx_cpu = std::stoi(val);
+            else if (key == "aux_cpus")    g_cfg.threads.aux_cpus = val;
+            else if (key == "numa_node")   g_cfg.threads.numa_node = val;
+            else if (key == "rt_priority") g_cfg.threads.rt_priority = std::stoi(val);
+            else if (key == "mlockall")    g_cfg.threads.mlockall = (val == "1" || val == "true" || val == "yes");
+        }
+
+        // MEMORY SECTION
+        if (section == "memory") {
+            if      (key == "arena_mb")  g_cfg.memory.arena_bytes = std::stoull(val) << 20;
+            else if (key == "hugepages") g_cfg.memory.hugepages = (val == "1" || val == "true" || val == "yes");
+            else if (key == "mlock")     g_cfg.memory.mlock = (val == "1" || val == "true" || val == "yes");
+        }
+
+        // SNAPSHOT SECTION
+        if (section == "snapshot") {
+            if      (key == "path")          g_cfg.snapshot.path = val;
+            else if (key == "key_field")     g_cfg.snapshot.key_field = val;
+            else if (key == "interval_msgs") g_cfg.snapshot.interval_msgs = std::stoull(val);
+            else if (key == "interval_sec")  g_cfg.snapshot.interval_sec = (uint32_t)std::stoul(val);
+            else if (key == "progress")      g_cfg.snapshot.progress = val;
+        }
+
+        // METRICS SECTION
+        if (section == "metrics") {
+            if (key == "listen") g_cfg.metrics.listen = val;
+        }
     }
 
     if (spec_rel.empty()) throw std::runtime_error("protocol_spec not found in ini");
@@ -206,6 +323,10 @@ void load_config(const char* ini_path) {
     load_spec(spec_file, g_cfg);
 }
 
+void load_spec_file(const char* json_path) {
+    load_spec(json_path, g_cfg);
+}
+
 const AppConfig& config() {
     return g_cfg;
 }
@@ -0,0 +1,189 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "cpu.h"
+#include "config.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED 1
+#endif
+
+int interface_numa_node(const std::string& ifname) {
+    if (ifname.empty()) return -1;
+    std::ifstream f("/sys/class/net/" + ifname + "/device/numa_node");
+    int node = -1;
+    if (!(f >> node)) return -1;
+    return node;
+}
+
+int cpu_numa_node(int cpu) {
+    const std::string dir = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+    DIR* d = ::opendir(dir.c_str());
+    if (!d) return -1;
+
+    int node = -1;
+    while (dirent* e = ::readdir(d)) {
+        int n;
+        if (std::sscanf(e->d_name, "node%d", &n) == 1) {
+            node = n;
+            break;
+        }
+    }
+    ::closedir(d);
+    return node;
+}
+
+// "2,4-6" -> set; false on syntax error or empty list
+static bool parse_cpu_list(const std::string& list, cpu_set_t& set) {
+    CPU_ZERO(&set);
+    bool any = false;
+    const char* p = list.c_str();
+    while (*p) {
+        if (*p == ',' || *p == ' ') { ++p; continue; }
+        char* end = nullptr;
+        long a = std::strtol(p, &end, 10);
+        if (end == p || a < 0) return false;
+        long b = a;
+        p = end;
+        if (*p == '-') {
+            b = std::strtol(p + 1, &end, 10);
+            if (end == p + 1 || b < a) return false;
+            p = end;
+        }
+        for (long c = a; c <= b && c < CPU_SETSIZE; ++c) CPU_SET((int)c, &set);
+        any = true;
+    }
+    return any;
+}
+
+bool pin_current_thread(int cpu) {
+    if (cpu < 0) return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    errno = ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set);
+    return errno == 0;
+}
+
+bool pin_current_thread(const std::string& cpu_list) {
+    cpu_set_t set;
+    if (!parse_cpu_list(cpu_list, set)) {
+        errno = EINVAL;
+        return false;
+    }
+    errno = ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set);
+    return errno == 0;
+}
+
+bool prefer_numa_node(int node) {
+    if (node < 0 || node >= 64) return false;
+    unsigned long mask = 1UL << node;
+    return ::syscall(SYS_set_mempolicy, MPOL_PREFERRED, &mask, sizeof(mask) * 8) == 0;
+}
+
+// Affinity the process started with, for background threads when aux_cpus
+// is unset: they are created by the pinned main thread and would inherit
+// rx_cpu otherwise.
+static cpu_set_t g_start_cpus;
+static bool g_have_start_cpus = false;
+
+void cpu_setup_placement(const ThreadConfig& tc, const std::string& ifname) {
+    if (tc.rx_cpu >= 0 && !g_have_start_cpus) {
+        g_have_start_cpus = ::pthread_getaffinity_np(::pthread_self(), sizeof(g_start_cpus), &g_start_cpus) == 0;
+        // off the receive core, unless it is the only one allowed
+        if (g_have_start_cpus && tc.rx_cpu < CPU_SETSIZE && CPU_COUNT(&g_start_cpus) > 1) {
+            CPU_CLR(tc.rx_cpu, &g_start_cpus);
+        }
+    }
+    if (tc.rx_cpu >= 0) {
+        if (pin_current_thread(tc.rx_cpu)) {
+            std::cerr << "INFO: receive thread pinned to cpu " << tc.rx_cpu << "\n";
+        } else {
+            std::cerr << "WARN: cannot pin to cpu " << tc.rx_cpu << " (errno=" << errno << ")\n";
+        }
+    }
+
+    int node = -1;
+    if (tc.numa_node == "auto") {
+        node = interface_numa_node(ifname);
+    } else if (!tc.numa_node.empty() && tc.numa_node != "off") {
+        node = std::atoi(tc.numa_node.c_str());
+    }
+
+    if (node >= 0) {
+        if (prefer_numa_node(node)) {
+            std::cerr << "INFO: buffers placed on NUMA node " << node << "\n";
+        } else {
+            std::cerr << "WARN: set_mempolicy(node " << node << ") failed (errno=" << errno << ")\n";
+        }
+        if (tc.rx_cpu >= 0) {
+            const int cpu_node = cpu_numa_node(tc.rx_cpu);
+            if (cpu_node >= 0 && cpu_node != node) {
+                std::cerr << "WARN: rx_cpu " << tc.rx_cpu << " is on node " << cpu_node
+                          << ", NIC memory on node " << node << "\n";
+            }
+        }
+    }
+}
+
+void cpu_setup_realtime(const ThreadConfig& tc) {
+    if (tc.mlockall) {
+        if (::mlockall(MCL_CURRENT | MCL_FUTURE) == 0) {
+            std::cerr << "INFO: memory locked (mlockall)\n";
+        } else {
+            std::cerr << "WARN: mlockall failed (errno=" << errno << ")\n";
+        }
+    }
+
+    if (tc.rt_priority > 0) {
+        sched_param sp{};
+        sp.sched_priority = tc.rt_priority;
+        errno = ::pthread_setschedparam(::pthread_self(), SCHED_FIFO, &sp);
+        if (errno == 0) {
+            std::cerr << "INFO: receive thread SCHED_FIFO priority " << tc.rt_priority << "\n";
+        } else {
+            std::cerr << "WARN: SCHED_FIFO failed (errno=" << errno << ", needs CAP_SYS_NICE)\n";
+        }
+    }
+}
+
+void cpu_pin_aux_thread() {
+    const std::string& list = config().threads.aux_cpus;
+    if (list.empty()) {
+        if (g_have_start_cpus) {
+            errno = ::pthread_setaffinity_np(::pthread_self(), sizeof(g_start_cpus), &g_start_cpus);
+            if (errno) std::cerr << "WARN: cannot move background thread off the receive cpu (errno=" << errno << ")\n";
+        }
+        return;
+    }
+    if (!pin_current_thread(list)) {
+        std::cerr << "WARN: cannot pin background thread to '" << list << "'\n";
+    }
+}
+
+std::thread cpu_start_aux_thread(std::function<void()> fn) {
+    // The new thread inherits the creator's signal mask.
+    sigset_t all, old;
+    sigfillset(&all);
+    ::pthread_sigmask(SIG_SETMASK, &all, &old);
+    std::thread t([fn = std::move(fn)] {
+        cpu_pin_aux_thread();
+        fn();
+    });
+    ::pthread_sigmask(SIG_SETMASK, &old, nullptr);
+    return t;
+}
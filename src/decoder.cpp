@@ -1,6 +1,7 @@
 #include "decoder.h"
 #include "config.h"
 
+#include <algorithm>
 #include <cstdio>
 #include <cstring>
 #include <string_view>
@@ -16,14 +17,23 @@ struct MoldHeaderRaw {
 #pragma pack(pop)
 
 static const MsgSpec* g_fast_specs[256] = {nullptr};
+static uint32_t g_text_max[256] = {0};   // longest text one message of the type can produce
+
+// Longest ">> {'Session':'..........', 'SeqNum':<u64>, 'MsgCount':<u16>}\n" (either form)
+constexpr size_t TEXT_HEADER_MAX = 96;
 
 static void init_fast_specs() {
     static bool initialized = false;
     if (initialized) return;
 
+    for (int t = 0; t < 256; ++t) g_text_max[t] = (uint32_t)TEXT_HEADER_MAX;
     for (const auto& kv : config().msg_specs) {
         unsigned char t = static_cast<unsigned char>(kv.first);
         g_fast_specs[t] = &kv.second;
+        // ", 'Name': '" + value + "'": values are at most 20 digits or `size` characters
+        size_t n = TEXT_HEADER_MAX;
+        for (const auto& f : kv.second.fields) n += 8 + f.name.size() + (f.size > 20 ? f.size : 20);
+        g_text_max[t] = (uint32_t)n;
     }
     initialized = true;
 }
@@ -147,19 +157,103 @@ static inline void append_field_kv(char*& cur, char* end, const uint8_t* msg_bas
     }
 }
 
-size_t decode_moldudp64_packet_to_buffer(
+static inline void append_message(char*& cur, char* end,
+                                  std::string_view session, uint64_t seq, uint16_t cnt,
+                                  const uint8_t* msg, const MsgSpec* spec,
+                                  const DecodeOptions& opt) {
+    if (opt.verbose) {
+        append(cur, end, ">> {'Session':'%.*s', 'SeqNum':%llu, 'MsgCount':%u",
+               (int)session.size(), session.data(),
+               (unsigned long long)seq,
+               (unsigned)cnt);
+
+        if (spec) {
+            for (const auto& f : spec->fields) {
+                append_field_kv(cur, end, msg, f);
+            }
+        }
+
+        append(cur, end, "}\n");
+    } else {
+        append(cur, end, ">> {'%.*s', %llu, %u",
+               (int)session.size(), session.data(),
+               (unsigned long long)seq,
+               (unsigned)cnt);
+
+        if (spec) {
+            for (const auto& f : spec->fields) {
+                append(cur, end, ", '");
+                append_field_value_only(cur, end, msg, f);
+                append(cur, end, "'");
+            }
+        }
+
+        append(cur, end, "}\n");
+    }
+}
+
+bool parse_type_list(const char* list, uint64_t mask[4]) {
+    if (!list) return false;
+    mask[0] = mask[1] = mask[2] = mask[3] = 0;
+
+    bool any = false;
+    for (const char* p = list; *p; ++p) {
+        unsigned char c = (unsigned char)*p;
+        if (c == ',' || c == ' ' || c == '\t') continue;
+        if (c == '*') {
+            mask[0] = mask[1] = mask[2] = mask[3] = ~0ULL;
+        } else {
+            mask[c >> 6] |= (1ULL << (c & 63));
+        }
+        any = true;
+    }
+    return any;
+}
+
+size_t split_moldudp64_packet(const uint8_t* buf, size_t len,
+                              const DecodeOptions& opt,
+                              MoldMessageView* out, size_t max) {
+    if (!buf || len < sizeof(MoldHeaderRaw) || !out) return 0;
+
+    const auto* h = reinterpret_cast<const MoldHeaderRaw*>(buf);
+    uint64_t seq = be64(reinterpret_cast<const uint8_t*>(&h->sequence_number_be));
+    uint16_t cnt = be16(reinterpret_cast<const uint8_t*>(&h->message_count_be));
+    if (cnt == 0xFFFF) return 0;
+
+    size_t off = sizeof(MoldHeaderRaw);
+    size_t n = 0;
+
+    for (uint16_t i = 0; i < cnt && n < max; ++i) {
+        if (off + 2 > len) break;
+
+        uint16_t msg_len = be16(buf + off);
+        off += 2;
+        if (off + msg_len > len) break;
+        if (msg_len == 0) continue;
+
+        const uint8_t* msg = buf + off;
+        off += msg_len;
+
+        if (!opt.type_enabled(msg[0])) continue;
+
+        out[n].seq  = seq + i;
+        out[n].data = msg;
+        out[n].len  = msg_len;
+        ++n;
+    }
+    return n;
+}
+
+size_t decode_moldudp64_packet_to_routes(
     const uint8_t* buf, size_t len,
     const DecodeOptions& opt,
-    char* out, size_t out_cap)
+    DecodeRoute* routes, size_t nroutes)
 {
     init_fast_specs();
 
-    if (!buf || len < sizeof(MoldHeaderRaw) || !out || out_cap == 0)
+    if (!buf || len < sizeof(MoldHeaderRaw) || !routes || nroutes == 0)
         return 0;
 
-    char* cur = out;
-    char* end = out + out_cap;
-
     const auto* h = reinterpret_cast<const MoldHeaderRaw*>(buf);
     std::string_view session(h->session, 10);
 
@@ -167,9 +261,13 @@ size_t decode_moldudp64_packet_to_buffer(
     uint16_t cnt = be16(reinterpret_cast<const uint8_t*>(&h->message_count_be));
 
     size_t off = sizeof(MoldHeaderRaw);
+    size_t total = 0;
 
-    // End-of-session
+    // End-of-session (always default route)
     if (cnt == 0xFFFF) {
+        DecodeRoute& r = routes[0];
+        char* cur = r.out + r.len;
+        char* end = r.out + r.cap;
         if (opt.verbose) {
             append(cur, end, ">> {'Session':'%.*s', 'SeqNum':%llu, 'MsgCount':%u, 'end':true}\n",
                    (int)session.size(), session.data(),
@@ -179,7 +277,9 @@ size_t decode_moldudp64_packet_to_buffer(
                    (int)session.size(), session.data(),
                    (unsigned long long)seq, (unsigned)cnt);
         }
-        return (size_t)(cur - out);
+        total = (size_t)(cur - r.out) - r.len;
+        r.len = (size_t)(cur - r.out);
+        return total;
     }
 
     for (uint16_t i = 0; i < cnt; ++i) {
@@ -192,41 +292,186 @@ size_t decode_moldudp64_packet_to_buffer(
 
         const uint8_t* msg = buf + off;
         uint8_t msg_type = msg[0];
-        const MsgSpec* spec = g_fast_specs[msg_type];
+        off += msg_len;
 
-        if (opt.verbose) {
-            append(cur, end, ">> {'Session':'%.*s', 'SeqNum':%llu, 'MsgCount':%u",
-                   (int)session.size(), session.data(),
-                   (unsigned long long)(seq + i),
-                   (unsigned)cnt);
+        // Filter before any formatting work.
+        if (!opt.type_enabled(msg_type)) continue;
 
-            if (spec) {
-                for (const auto& f : spec->fields) {
-                    append_field_kv(cur, end, msg, f);
-                }
-            }
+        size_t ri = (nroutes > 1) ? opt.type_route[msg_type] : 0;
+        if (ri >= nroutes) ri = 0;
+        DecodeRoute& r = routes[ri];
 
-            append(cur, end, "}\n");
-        } else {
-            append(cur, end, ">> {'%.*s', %llu, %u",
-                   (int)session.size(), session.data(),
-                   (unsigned long long)(seq + i),
-                   (unsigned)cnt);
-
-            if (spec) {
-                for (const auto& f : spec->fields) {
-                    append(cur, end, ", '");
-                    append_field_value_only(cur, end, msg, f);
-                    append(cur, end, "'");
-                }
-            }
+        // A full route drops the rest of its messages; the others go on.
+        char* cur = r.out + r.len;
+        char* end = r.out + r.cap;
+        if (cur >= end) continue;
+        append_message(cur, end, session, seq + i, cnt, msg, g_fast_specs[msg_type], opt);
+
+        total += (size_t)(cur - r.out) - r.len;
+        r.len = (size_t)(cur - r.out);
+    }
+
+    return total;
+}
+
+size_t decode_moldudp64_packet_to_buffer(
+    const uint8_t* buf, size_t len,
+    const DecodeOptions& opt,
+    char* out, size_t out_cap)
+{
+    if (!out || out_cap == 0) return 0;
+
+    // Single route: type filtering still applies, routing does not.
+    DecodeRoute r{out, out_cap, 0};
+    return decode_moldudp64_packet_to_routes(buf, len, opt, &r, 1);
+}
+
+static inline void put_le(uint8_t* p, uint64_t v, int bytes) {
+    for (int i = 0; i < bytes; ++i) p[i] = uint8_t(v >> (8 * i));
+}
 
-            append(cur, end, "}\n");
+// Append one record (header + payload + padding) at r.out + r.len.
+// Returns false if it does not fit.
+static bool append_record(DecodeRoute& r, uint64_t seq, uint64_t recv_ns, uint8_t type, uint8_t flags,
+                          const uint8_t* msg, uint16_t msg_len, const MsgSpec* spec) {
+    const size_t size = (sizeof(MoldRecordHeader) + msg_len + 7) & ~size_t(7);
+    if (r.cap - r.len < size) return false;
+
+    uint8_t* p = reinterpret_cast<uint8_t*>(r.out + r.len);
+    put_le(p,      seq,     8);
+    put_le(p + 8,  recv_ns, 8);
+    put_le(p + 16, size,    4);
+    put_le(p + 20, msg_len, 2);
+    p[22] = type;
+    p[23] = flags;
+
+    uint8_t* payload = p + sizeof(MoldRecordHeader);
+    if (msg_len) std::memcpy(payload, msg, msg_len);
+    std::memset(payload + msg_len, 0, size - sizeof(MoldRecordHeader) - msg_len);
+
+    if (spec) {
+        for (const auto& f : spec->fields) {
+            if (f.offset + f.size > msg_len) continue;
+            switch (f.type) {
+                case FieldType::UINT16: case FieldType::INT16:
+                case FieldType::UINT32: case FieldType::INT32:
+                case FieldType::UINT64: case FieldType::INT64:
+                    std::reverse(payload + f.offset, payload + f.offset + f.size);
+                    break;
+                default:
+                    break;
+            }
         }
+    }
+
+    r.len += size;
+    return true;
+}
+
+size_t encode_moldudp64_packet_to_routes(
+    const uint8_t* buf, size_t len,
+    const DecodeOptions& opt,
+    uint64_t recv_ns, bool normalize,
+    DecodeRoute* routes, size_t nroutes)
+{
+    init_fast_specs();
+
+    if (!buf || len < sizeof(MoldHeaderRaw) || !routes || nroutes == 0)
+        return 0;
+
+    const uint64_t seq = be64(buf + 10);
+    const uint16_t cnt = be16(buf + 18);
+
+    // End-of-session (always default route)
+    if (cnt == 0xFFFF) {
+        DecodeRoute& r = routes[0];
+        const size_t before = r.len;
+        append_record(r, seq, recv_ns, 0, MOLD_RECORD_END_OF_SESSION, nullptr, 0, nullptr);
+        return r.len - before;
+    }
+
+    size_t off = sizeof(MoldHeaderRaw);
+    size_t total = 0;
+
+    for (uint16_t i = 0; i < cnt; ++i) {
+        if (off + 2 > len) break;
+
+        uint16_t msg_len = be16(buf + off);
+        off += 2;
+        if (off + msg_len > len) break;
+        if (msg_len == 0) continue;
 
-        if (cur >= end) break;
+        const uint8_t* msg = buf + off;
+        uint8_t msg_type = msg[0];
         off += msg_len;
+
+        if (!opt.type_enabled(msg_type)) continue;
+
+        size_t ri = (nroutes > 1) ? opt.type_route[msg_type] : 0;
+        if (ri >= nroutes) ri = 0;
+        DecodeRoute& r = routes[ri];
+
+        // A record that does not fit is dropped; other routes go on.
+        const MsgSpec* spec = normalize ? g_fast_specs[msg_type] : nullptr;
+        const size_t before = r.len;
+        append_record(r, seq + i, recv_ns, msg_type, spec ? MOLD_RECORD_NORMALIZED : 0,
+                      msg, msg_len, spec);
+        total += r.len - before;
+    }
+
+    return total;
+}
+
+void moldudp64_output_bound(const uint8_t* buf, size_t len,
+                            const DecodeOptions& opt, bool binary,
+                            size_t* need, size_t nroutes)
+{
+    init_fast_specs();
+
+    for (size_t i = 0; i < nroutes; ++i) need[i] = 0;
+    if (!buf || len < sizeof(MoldHeaderRaw) || nroutes == 0) return;
+
+    const uint16_t cnt = be16(buf + 18);
+    if (cnt == 0xFFFF) {
+        need[0] = binary ? sizeof(MoldRecordHeader) : TEXT_HEADER_MAX;
+        return;
     }
 
-    return (size_t)(cur - out);
+    size_t off = sizeof(MoldHeaderRaw);
+    for (uint16_t i = 0; i < cnt; ++i) {
+        if (off + 2 > len) break;
+        const uint16_t msg_len = be16(buf + off);
+        off += 2;
+        if (off + msg_len > len) break;
+        if (msg_len == 0) continue;
+
+        const uint8_t t = buf[off];
+        off += msg_len;
+        if (!opt.type_enabled(t)) continue;
+
+        size_t ri = (nroutes > 1) ? opt.type_route[t] : 0;
+        if (ri >= nroutes) ri = 0;
+        need[ri] += binary ? ((sizeof(MoldRecordHeader) + msg_len + 7) & ~size_t(7)) : g_text_max[t];
+    }
+}
+
+bool validate_moldudp64_packet(const uint8_t* buf, size_t len) {
+    init_fast_specs();
+
+    if (!buf || len < sizeof(MoldHeaderRaw)) return false;
+    const uint16_t cnt = be16(buf + 18);
+    if (cnt == 0 || cnt == 0xFFFF) return len == sizeof(MoldHeaderRaw);
+
+    size_t off = sizeof(MoldHeaderRaw);
+    for (uint16_t i = 0; i < cnt; ++i) {
+        if (off + 2 > len) return false;
+        const uint16_t msg_len = be16(buf + off);
+        off += 2;
+        if (msg_len == 0 || off + msg_len > len) return false;
+
+        const MsgSpec* spec = g_fast_specs[buf[off]];
+        if (spec && msg_len < spec->total_length) return false;
+        off += msg_len;
+    }
+    return off == len;
 }
@@ -0,0 +1,407 @@
+#include "feedgen.h"
+#include "builder.h"
+#include "config.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+#pragma pack(push, 1)
+struct RereqPkt {
+    char     session[10];
+    uint64_t seq_be;
+    uint16_t count_be;
+};
+#pragma pack(pop)
+
+static inline uint64_t mono_ns() {
+    timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static inline uint64_t be64_load(const void* p) {
+    uint64_t v;
+    std::memcpy(&v, p, 8);
+    return be64toh(v);
+}
+
+FeedGenerator::FeedGenerator()
+    : session_{}, tx_fd_(-1), rr_fd_(-1), next_seq_(1), rng_(1),
+      cum_weight_{}, total_weight_(0), pending_type_(-1), last_send_ns_(0), out_n_(0) {}
+
+FeedGenerator::~FeedGenerator() { close(); }
+
+void FeedGenerator::close() {
+    flush_sends();
+    if (tx_fd_ >= 0) ::close(tx_fd_);
+    if (rr_fd_ >= 0) ::close(rr_fd_);
+    tx_fd_ = rr_fd_ = -1;
+}
+
+// "A:50,E:30,P" -> weights (missing weight = 1)
+static bool parse_mix(const std::string& mix, uint32_t w[256]) {
+    size_t i = 0;
+    while (i < mix.size()) {
+        if (mix[i] == ',' || mix[i] == ' ') { ++i; continue; }
+        const uint8_t t = (uint8_t)mix[i++];
+        uint32_t weight = 1;
+        if (i < mix.size() && mix[i] == ':') {
+            char* end = nullptr;
+            weight = (uint32_t)std::strtoul(mix.c_str() + i + 1, &end, 10);
+            i = (size_t)(end - mix.c_str());
+        }
+        w[t] = weight;
+    }
+    return true;
+}
+
+bool FeedGenerator::build_templates() {
+    const auto& specs = config().msg_specs;
+
+    uint32_t w[256] = {};
+    if (cfg_.mix.empty()) {
+        for (const auto& kv : specs) w[(uint8_t)kv.first] = 1;
+    } else {
+        parse_mix(cfg_.mix, w);
+    }
+
+    total_weight_ = 0;
+    types_in_mix_.clear();
+    for (int t = 0; t < 256; ++t) {
+        templates_[t].clear();
+        if (w[t] && !specs.count((char)t)) {
+            std::cerr << "WARN: feedgen: no spec for type '" << (char)t << "' in mix, ignored\n";
+            w[t] = 0;
+        }
+        if (w[t]) {
+            for (int v = 0; v < VARIANTS; ++v) templates_[t].push_back(build_message(specs.at((char)t), (uint64_t)v));
+            types_in_mix_.push_back((uint8_t)t);
+        }
+        total_weight_ += w[t];
+        cum_weight_[t] = total_weight_;
+    }
+    return total_weight_ > 0;
+}
+
+bool FeedGenerator::open(const FeedGenConfig& cfg) {
+    close();
+    cfg_ = cfg;
+    stats_ = FeedGenStats{};
+    next_seq_ = cfg.start_seq ? cfg.start_seq : 1;
+    rng_ = cfg.seed ? cfg.seed : 1;
+    pending_type_ = -1;
+
+    std::memset(session_, ' ', sizeof(session_));
+    std::memcpy(session_, cfg.session.data(), std::min<size_t>(cfg.session.size(), 10));
+
+    if (!build_templates()) {
+        std::cerr << "ERROR: feedgen: no message types to generate\n";
+        return false;
+    }
+    if (cfg_.history == 0) cfg_.history = 1;
+    history_.assign(cfg_.history, 0);
+
+    tx_fd_ = ::socket(AF_INET, SOCK_DGRAM, 0);
+    if (tx_fd_ < 0) {
+        perror("socket");
+        return false;
+    }
+
+    in_addr_t dst = ::inet_addr(cfg.dest_ip.c_str());
+    if (IN_MULTICAST(ntohl(dst))) {
+        unsigned char ttl = (unsigned char)cfg.ttl, loop = 1;
+        ::setsockopt(tx_fd_, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+        ::setsockopt(tx_fd_, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+        if (!cfg.interface_ip.empty()) {
+            in_addr ifa{};
+            ifa.s_addr = ::inet_addr(cfg.interface_ip.c_str());
+            if (::setsockopt(tx_fd_, IPPROTO_IP, IP_MULTICAST_IF, &ifa, sizeof(ifa)) < 0) {
+                perror("IP_MULTICAST_IF");
+                return false;
+            }
+        }
+    }
+    int sndbuf = 8 * 1024 * 1024;
+    ::setsockopt(tx_fd_, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+
+    sockaddr_in to{};
+    to.sin_family = AF_INET;
+    to.sin_port = htons(cfg.dest_port);
+    to.sin_addr.s_addr = dst;
+    if (::connect(tx_fd_, (sockaddr*)&to, sizeof(to)) < 0) {
+        perror("connect");
+        return false;
+    }
+
+    if (cfg.rereq_port) {
+        rr_fd_ = ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+        if (rr_fd_ < 0) {
+            perror("rerequest socket");
+            return false;
+        }
+        sockaddr_in a{};
+        a.sin_family = AF_INET;
+        a.sin_port = htons(cfg.rereq_port);
+        a.sin_addr.s_addr = cfg.interface_ip.empty() ? INADDR_ANY : ::inet_addr(cfg.interface_ip.c_str());
+        int reuse = 1;
+        ::setsockopt(rr_fd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        if (::bind(rr_fd_, (sockaddr*)&a, sizeof(a)) < 0) {
+            perror("rerequest bind");
+            return false;
+        }
+    }
+
+    if (cfg_.mtu < 64) cfg_.mtu = 64;
+    out_bufs_.assign((size_t)SEND_BATCH * cfg_.mtu, 0);
+    out_lens_.assign(SEND_BATCH, 0);
+    out_iov_.resize(SEND_BATCH);
+    out_msgs_.resize(SEND_BATCH);
+    out_n_ = 0;
+    held_.clear();
+    last_send_ns_ = mono_ns();
+    return true;
+}
+
+void FeedGenerator::set_rate(double msgs_per_sec) { cfg_.rate = msgs_per_sec; }
+
+double FeedGenerator::next_random() {
+    // xorshift64*
+    rng_ ^= rng_ >> 12;
+    rng_ ^= rng_ << 25;
+    rng_ ^= rng_ >> 27;
+    return (double)((rng_ * 2685821657736338717ULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+uint8_t FeedGenerator::pick_type() {
+    if (types_in_mix_.size() == 1) return types_in_mix_[0];
+    const uint32_t r = (uint32_t)(next_random() * total_weight_);
+    for (uint8_t t : types_in_mix_) {
+        if (r < cum_weight_[t]) return t;
+    }
+    return types_in_mix_.back();
+}
+
+const std::vector<uint8_t>& FeedGenerator::message_for(uint8_t type, uint64_t seq) const {
+    return templates_[type][seq % VARIANTS];
+}
+
+// Messages owed at time t (seconds into run()): base rate plus the extra
+// rate of every burst window that has started so far.
+double FeedGenerator::due_messages(double t) const {
+    double due = cfg_.rate * t;
+    if (cfg_.burst_period_ms > 0 && cfg_.burst_ms > 0 && cfg_.burst_factor > 1.0) {
+        const double period = cfg_.burst_period_ms / 1000.0;
+        const double len = std::min(cfg_.burst_ms / 1000.0, period);
+        const double full = std::floor(t / period);
+        const double in_burst = full * len + std::min(t - full * period, len);
+        due += (cfg_.burst_factor - 1.0) * cfg_.rate * in_burst;
+    }
+    return due;
+}
+
+void FeedGenerator::queue_packet(const uint8_t* data, size_t len) {
+    if (out_n_ == SEND_BATCH) flush_sends();
+    uint8_t* slot = out_bufs_.data() + (size_t)out_n_ * cfg_.mtu;
+    std::memcpy(slot, data, len);
+    out_lens_[out_n_] = (uint32_t)len;
+    ++out_n_;
+}
+
+void FeedGenerator::flush_sends() {
+    if (out_n_ == 0 || tx_fd_ < 0) {
+        out_n_ = 0;
+        return;
+    }
+    for (int i = 0; i < out_n_; ++i) {
+        out_iov_[i].iov_base = out_bufs_.data() + (size_t)i * cfg_.mtu;
+        out_iov_[i].iov_len  = out_lens_[i];
+        std::memset(&out_msgs_[i], 0, sizeof(out_msgs_[i]));
+        out_msgs_[i].msg_hdr.msg_iov = &out_iov_[i];
+        out_msgs_[i].msg_hdr.msg_iovlen = 1;
+    }
+    int off = 0;
+    while (off < out_n_) {
+        int n = ::sendmmsg(tx_fd_, out_msgs_.data() + off, (unsigned)(out_n_ - off), 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == ENOBUFS || errno == EAGAIN) {   // local queue full: back off briefly
+                ::usleep(50);
+                continue;
+            }
+            perror("sendmmsg");
+            break;
+        }
+        off += n;
+    }
+    out_n_ = 0;
+    last_send_ns_ = mono_ns();
+}
+
+void FeedGenerator::emit_live_packet(size_t n_msgs) {
+    MoldPacketBuilder b(cfg_.mtu);
+    b.begin(session_, next_seq_);
+
+    for (size_t i = 0; i < n_msgs; ++i) {
+        const uint64_t seq = next_seq_ + b.count();
+        const uint8_t t = (pending_type_ >= 0) ? (uint8_t)pending_type_ : pick_type();
+        const auto& m = message_for(t, seq);
+        if (!b.add(m.data(), (uint16_t)m.size())) {
+            pending_type_ = t;           // did not fit: it opens the next packet
+            break;
+        }
+        pending_type_ = -1;
+        history_[seq % cfg_.history] = t;
+    }
+    if (b.count() == 0) return;
+
+    next_seq_ += b.count();
+    stats_.messages += b.count();
+    ++stats_.packets;
+
+    if (cfg_.drop > 0 && next_random() < cfg_.drop) {
+        ++stats_.dropped;
+        return;
+    }
+
+    if (held_.empty() && cfg_.reorder > 0 && next_random() < cfg_.reorder) {
+        held_.assign(b.data(), b.data() + b.size());
+        ++stats_.reordered;
+        return;
+    }
+
+    queue_packet(b.data(), b.size());
+    if (cfg_.dup > 0 && next_random() < cfg_.dup) {
+        queue_packet(b.data(), b.size());
+        ++stats_.duplicated;
+    }
+    if (!held_.empty()) {
+        queue_packet(held_.data(), held_.size());
+        held_.clear();
+    }
+}
+
+void FeedGenerator::heartbeat() {
+    MoldPacketBuilder b(64);
+    b.begin(session_, next_seq_);
+    queue_packet(b.data(), b.size());
+    flush_sends();
+    ++stats_.heartbeats;
+}
+
+void FeedGenerator::end_of_session() {
+    if (!held_.empty()) {
+        queue_packet(held_.data(), held_.size());
+        held_.clear();
+    }
+    MoldPacketBuilder b(64);
+    b.begin(session_, next_seq_);
+    b.end_of_session();
+    for (int i = 0; i < 3; ++i) queue_packet(b.data(), b.size());
+    flush_sends();
+}
+
+void FeedGenerator::poll_rerequests() {
+    if (rr_fd_ < 0) return;
+
+    for (;;) {
+        RereqPkt req{};
+        sockaddr_in from{};
+        socklen_t fl = sizeof(from);
+        ssize_t n = ::recvfrom(rr_fd_, &req, sizeof(req), 0, (sockaddr*)&from, &fl);
+        if (n < 0) return;
+        if ((size_t)n < sizeof(req) || std::memcmp(req.session, session_, 10) != 0) continue;
+
+        ++stats_.rereq_requests;
+        const uint64_t oldest = (next_seq_ > cfg_.history) ? next_seq_ - cfg_.history : 1;
+        uint64_t seq = be64_load(&req.seq_be);
+        uint64_t end = seq + be16toh(req.count_be);
+        if (seq < oldest) seq = oldest;
+        if (end > next_seq_) end = next_seq_;
+
+        MoldPacketBuilder b(cfg_.mtu);
+        while (seq < end) {
+            b.begin(session_, seq);
+            while (seq < end) {
+                const auto& m = message_for(history_[seq % cfg_.history], seq);
+                if (!b.add(m.data(), (uint16_t)m.size())) break;
+                ++seq;
+            }
+            if (b.count() == 0) break;
+            ::sendto(rr_fd_, b.data(), b.size(), 0, (sockaddr*)&from, fl);
+            stats_.rereq_messages += b.count();
+        }
+    }
+}
+
+uint64_t FeedGenerator::run(uint64_t max_msgs, double seconds, const std::atomic<bool>* stop) {
+    if (tx_fd_ < 0) return 0;
+
+    const size_t per_pkt = cfg_.max_per_packet > 0 ? (size_t)cfg_.max_per_packet : 0xFFFE;
+    const uint64_t hb_ns = (uint64_t)cfg_.heartbeat_ms * 1000000ULL;
+    const uint64_t t0 = mono_ns();
+    const uint64_t start_msgs = stats_.messages;
+    uint64_t batches = 0;
+
+    for (;;) {
+        const uint64_t now = mono_ns();
+        const double t = (double)(now - t0) / 1e9;
+        const uint64_t sent = stats_.messages - start_msgs;
+
+        if (stop && stop->load(std::memory_order_relaxed)) break;
+        if (max_msgs && sent >= max_msgs) break;
+        if (seconds > 0 && t >= seconds) break;
+
+        double due = (cfg_.rate > 0) ? due_messages(t) - (double)sent : 1e18;
+        if (max_msgs && due > (double)(max_msgs - sent)) due = (double)(max_msgs - sent);
+
+        if (due >= 1.0) {
+            size_t n = (due > (double)per_pkt) ? per_pkt : (size_t)due;
+            emit_live_packet(n);
+            if (out_n_ == SEND_BATCH) {
+                flush_sends();
+                if (++batches % RR_POLL_BATCHES == 0) poll_rerequests();
+            }
+            continue;
+        }
+
+        // caught up: push out what is queued, answer rerequests, wait a bit
+        flush_sends();
+        poll_rerequests();
+        if (hb_ns && mono_ns() - last_send_ns_ >= hb_ns) heartbeat();
+
+        const double gap_s = (1.0 - due) / std::max(cfg_.rate, 1.0);
+        if (gap_s > 50e-6) {
+            timespec ts{0, (long)(std::min(gap_s, 200e-6) * 1e9)};
+            ::nanosleep(&ts, nullptr);
+        }
+    }
+
+    if (!held_.empty()) {
+        queue_packet(held_.data(), held_.size());
+        held_.clear();
+    }
+    flush_sends();
+    return stats_.messages - start_msgs;
+}
+
+void FeedGenerator::serve(double seconds, const std::atomic<bool>* stop) {
+    const uint64_t hb_ns = (uint64_t)cfg_.heartbeat_ms * 1000000ULL;
+    const uint64_t t0 = mono_ns();
+    for (;;) {
+        const uint64_t now = mono_ns();
+        if (stop && stop->load(std::memory_order_relaxed)) break;
+        if (seconds > 0 && (double)(now - t0) / 1e9 >= seconds) break;
+
+        poll_rerequests();
+        if (hb_ns && mono_ns() - last_send_ns_ >= hb_ns) heartbeat();
+        ::usleep(200);
+    }
+}
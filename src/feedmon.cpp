@@ -0,0 +1,48 @@
+#include "feedmon.h"
+#include "logger.h"
+#include "metrics.h"
+
+FeedMonitor::FeedMonitor(ThreadMetrics& mt, uint64_t stall_ns, uint64_t now_ns)
+    : mt_(mt), stall_ns_(stall_ns), last_rx_ns_(now_ns), drops_seen_(0), stalled_(false) {}
+
+FeedVerdict FeedMonitor::classify(uint64_t expected_seq, uint64_t seq, uint16_t cnt, bool ended) const {
+    if (cnt == 0xFFFF && ended) return FeedVerdict::REPEAT_END;
+    if (seq > expected_seq) return FeedVerdict::GAP;
+    if (seq < expected_seq && cnt != 0 && cnt != 0xFFFF) return FeedVerdict::DUPLICATE;
+    return FeedVerdict::DELIVER;
+}
+
+uint64_t FeedMonitor::gap(const char session10[10], uint64_t expected_seq, uint64_t seq, uint16_t cnt,
+                          uint64_t drops) {
+    const uint64_t n = seq - expected_seq;
+    const uint64_t new_drops = drops - drops_seen_;
+    drops_seen_ = drops;
+
+    metrics_add(mt_.gaps, 1);
+    metrics_add(mt_.gap_messages, n);
+    if (cnt == 0 || cnt == 0xFFFF) metrics_add(mt_.tail_gaps, 1);
+    metrics_set(mt_.local_drops, drops);
+    if (new_drops) metrics_add(mt_.gaps_local, 1);
+
+    if (new_drops) log_session(LOG_GAP_LOCAL, session10, expected_seq, seq - 1, n, new_drops);
+    else           log_session(LOG_GAP_UPSTREAM, session10, expected_seq, seq - 1, n);
+    return new_drops;
+}
+
+bool FeedMonitor::idle(uint64_t now_ns, const char session10[10], uint64_t expected_seq) {
+    if (!stall_ns_ || stalled_ || now_ns - last_rx_ns_ < stall_ns_) return false;
+    stalled_ = true;
+    metrics_add(mt_.stalls, 1);
+    log_session(LOG_FEED_STALL, session10, (now_ns - last_rx_ns_) / 1000000ULL, expected_seq);
+    return true;
+}
+
+bool FeedMonitor::active(uint64_t now_ns, const char session10[10]) {
+    const bool resumed = stalled_;
+    if (resumed) {
+        stalled_ = false;
+        log_session(LOG_FEED_RESUMED, session10, (now_ns - last_rx_ns_) / 1000000ULL);
+    }
+    last_rx_ns_ = now_ns;
+    return resumed;
+}
@@ -0,0 +1,192 @@
+#include "logger.h"
+#include "cpu.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+
+struct LogFormat {
+    int         sessions;  // format starts with this many sessions (%.10s)
+    const char* fmt;       // remaining conversions are %llu, in argument order
+};
+
+static const LogFormat g_formats[LOG_ID_COUNT] = {
+    /* LOG_GAP_UPSTREAM         */ {1,  "GAP session=%.10s range=%llu-%llu count=%llu cause=upstream\n"},
+    /* LOG_GAP_LOCAL            */ {1,  "GAP session=%.10s range=%llu-%llu count=%llu cause=local kernel_drops=%llu\n"},
+    /* LOG_DOWNLOAD             */ {1,  "DOWNLOAD session=%.10s from=%llu count=%llu\n"},
+    /* LOG_RECOVERY_PARTIAL     */ {0, "WARN: RECOVERY partial recovered=%llu still_missing=%llu\n"},
+    /* LOG_RECOVERY_REQUEST     */ {0, "RECOVERY request start=%llu count=%llu\n"},
+    /* LOG_RECOVERY_STALLED     */ {0, "RECOVERY stalled start=%llu req=%llu\n"},
+    /* LOG_RECOVERY_DONE        */ {0, "RECOVERY done recovered=%llu\n"},
+    /* LOG_RECOVERY_SEND_FAILED */ {0, "RECOVERY sendto failed errno=%llu\n"},
+    /* LOG_RECOVERY_RECV_FAILED */ {0, "RECOVERY recvfrom failed errno=%llu\n"},
+    /* LOG_SESSION_ROLLOVER     */ {2, "SESSION rollover from=%.10s to=%.10s last_seq=%llu ended=%llu\n"},
+    /* LOG_SESSION_END          */ {1, "SESSION end session=%.10s next_seq=%llu\n"},
+    /* LOG_FEED_STALL           */ {1, "WARN: STALL session=%.10s idle_ms=%llu expected_seq=%llu\n"},
+    /* LOG_FEED_RESUMED         */ {1, "INFO: STALL cleared session=%.10s idle_ms=%llu\n"},
+    /* LOG_RECOVERY_FAILOVER    */ {0, "WARN: RECOVERY endpoint=%llu no answer start=%llu count=%llu; failing over\n"},
+    /* LOG_RECOVERY_SPLIT       */ {0, "RECOVERY split start=%llu count=%llu endpoints=%llu\n"},
+    /* LOG_DOWNLOAD_PROGRESS    */ {0, "DOWNLOAD progress=%llu/%llu msgs_per_sec=%llu lanes=%llu\n"},
+};
+
+struct LogRecord {
+    uint16_t id;
+    char     session[10];
+    char     session2[10];
+    uint8_t  pad[2];
+    uint64_t a[4];
+};
+
+// Bounded MPSC ring: a slot's stamp says whose turn it is (pos: free for the
+// producer claiming pos, pos + 1: filled, readable by the consumer).
+struct alignas(64) LogSlot {
+    std::atomic<uint64_t> stamp;
+    LogRecord rec;
+};
+static_assert(sizeof(LogSlot) == 64, "one cache line per record");
+
+static constexpr uint64_t LOG_SLOTS = 8192;   // power of two
+static constexpr size_t   LOG_OUT_BYTES = 64 * 1024;
+
+static LogSlot g_slots[LOG_SLOTS];
+alignas(64) static std::atomic<uint64_t> g_tail{0};   // next slot to claim
+alignas(64) static uint64_t g_head = 0;               // next slot to read (writer thread only)
+static std::atomic<uint64_t> g_dropped{0};
+static std::atomic<bool> g_running{false};
+static std::atomic<bool> g_stop{false};
+static std::thread g_writer;
+static int g_fd = 2;
+
+static size_t format_record(const LogRecord& r, char* out, size_t cap) {
+    if (r.id >= LOG_ID_COUNT) return 0;
+    const LogFormat& f = g_formats[r.id];
+    const auto* a = reinterpret_cast<const unsigned long long*>(r.a);
+
+    char s1[11], s2[11];
+    std::memcpy(s1, r.session, 10);
+    std::memcpy(s2, r.session2, 10);
+    s1[10] = s2[10] = '\0';
+
+    int n;
+    if (f.sessions == 2)      n = std::snprintf(out, cap, f.fmt, s1, s2, a[0], a[1], a[2], a[3]);
+    else if (f.sessions == 1) n = std::snprintf(out, cap, f.fmt, s1, a[0], a[1], a[2], a[3]);
+    else                      n = std::snprintf(out, cap, f.fmt, a[0], a[1], a[2], a[3]);
+    if (n <= 0) return 0;
+    return (size_t)n < cap ? (size_t)n : cap - 1;
+}
+
+static void write_all(const char* p, size_t n) {
+    while (n > 0) {
+        ssize_t w = ::write(g_fd, p, n);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) return;
+        p += w;
+        n -= (size_t)w;
+    }
+}
+
+// Format everything queued so far; one write() per full buffer.
+static size_t drain() {
+    static char out[LOG_OUT_BYTES];
+    size_t len = 0, n = 0;
+
+    for (;;) {
+        LogSlot& s = g_slots[g_head & (LOG_SLOTS - 1)];
+        if (s.stamp.load(std::memory_order_acquire) != g_head + 1) break;
+
+        if (len + 512 > sizeof(out)) {
+            write_all(out, len);
+            len = 0;
+        }
+        len += format_record(s.rec, out + len, sizeof(out) - len);
+        s.stamp.store(g_head + LOG_SLOTS, std::memory_order_release);
+        ++g_head;
+        ++n;
+    }
+    if (len) write_all(out, len);
+    return n;
+}
+
+static void writer_loop() {
+    const timespec idle{0, 1000000};   // 1 ms
+    while (!g_stop.load(std::memory_order_acquire)) {
+        if (drain() == 0) ::nanosleep(&idle, nullptr);
+    }
+    drain();
+}
+
+void log_sessions(LogId id, const char first10[10], const char second10[10],
+                  uint64_t a0, uint64_t a1, uint64_t a2, uint64_t a3) {
+    LogRecord rec;
+    rec.id = id;
+    if (first10)  std::memcpy(rec.session, first10, 10);
+    else          std::memset(rec.session, ' ', 10);
+    if (second10) std::memcpy(rec.session2, second10, 10);
+    else          std::memset(rec.session2, ' ', 10);
+    rec.a[0] = a0;
+    rec.a[1] = a1;
+    rec.a[2] = a2;
+    rec.a[3] = a3;
+
+    if (!g_running.load(std::memory_order_acquire)) {
+        char line[512];
+        size_t n = format_record(rec, line, sizeof(line));
+        write_all(line, n);
+        return;
+    }
+
+    uint64_t pos = g_tail.load(std::memory_order_relaxed);
+    LogSlot* s;
+    for (;;) {
+        s = &g_slots[pos & (LOG_SLOTS - 1)];
+        const uint64_t stamp = s->stamp.load(std::memory_order_acquire);
+        if (stamp == pos) {
+            if (g_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        } else if (stamp < pos) {
+            g_dropped.fetch_add(1, std::memory_order_relaxed);   // full: writer is behind
+            return;
+        } else {
+            pos = g_tail.load(std::memory_order_relaxed);
+        }
+    }
+    s->rec = rec;
+    s->stamp.store(pos + 1, std::memory_order_release);
+}
+
+void log_session(LogId id, const char session10[10], uint64_t a0, uint64_t a1, uint64_t a2, uint64_t a3) {
+    log_sessions(id, session10, nullptr, a0, a1, a2, a3);
+}
+
+void log_start(int fd) {
+    log_stop();
+    g_fd = fd;
+
+    const uint64_t base = g_tail.load();
+    for (uint64_t i = 0; i < LOG_SLOTS; ++i) g_slots[(base + i) & (LOG_SLOTS - 1)].stamp.store(base + i);
+    g_head = base;
+    g_dropped.store(0);
+    g_stop.store(false);
+    g_writer = cpu_start_aux_thread(writer_loop);
+    g_running.store(true, std::memory_order_release);
+}
+
+void log_stop() {
+    if (!g_writer.joinable()) return;
+    g_running.store(false, std::memory_order_release);
+    g_stop.store(true, std::memory_order_release);
+    g_writer.join();
+    drain();   // anything a producer finished after the writer's last pass
+
+    if (uint64_t d = g_dropped.load()) {
+        std::cerr << "WARN: log: " << d << " records dropped (writer fell behind)\n";
+    }
+}
+
+uint64_t log_dropped() {
+    return g_dropped.load(std::memory_order_relaxed);
+}
@@ -2,6 +2,16 @@
 #include "decoder.h"
 #include "socket.h"
 #include "recovery.h"
+#include "output.h"
+#include "progress.h"
+#include "arena.h"
+#include "cpu.h"
+#include "metrics.h"
+#include "logger.h"
+#include "session.h"
+#include "state.h"
+#include "feedmon.h"
+#include <algorithm>
 #include <csignal>
 #include <iostream>
 #include <cstring>
@@ -9,8 +19,8 @@
 #include <getopt.h>
 #include <sys/socket.h>
 #include <sys/uio.h>
-#include <cstdio>
 #include <time.h>
+#include <vector>
 
 static volatile std::sig_atomic_t g_stop = 0;
 static void on_sigint(int) { g_stop = 1; }
@@ -43,11 +53,13 @@ static bool read_mold_header(const uint8_t* buf, size_t len,
 
 static void usage(const char* prog) {
     std::cerr
-        << "Usage: " << prog << " [-g] [-s <seq>] [-n <count>] [-v]\n\n"
+        << "Usage: " << prog << " [-g] [-s <seq> | -R] [-n <count>] [-t <types>] [-v]\n\n"
         << "Options:\n"
         << "  -g            Live mode with recovery (rerequest on gaps)\n"
         << "  -s <seq>      Download starting at <seq> using rerequest (session discovered from first live packet)\n"
+        << "  -R            Resume: load the [SNAPSHOT] state, then rerequest only what came after it\n"
         << "  -n <count>    Stop after decoding <count> messages (QA testing)\n"
+        << "  -t <types>    Only output these message types, e.g. -t EP (overrides [OUTPUT] message_types)\n"
         << "  -v            Verbose decode (field names etc. if decoder supports)\n";
 }
 
@@ -63,26 +75,39 @@ static bool should_log_every_ms(uint64_t& last_ms, uint64_t interval_ms) {
     return false;
 }
 
+static inline uint64_t mono_ns() {
+    struct timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
 int main(int argc, char** argv) {
     std::setvbuf(stdout, nullptr, _IONBF, 0);
     std::setvbuf(stderr, nullptr, _IONBF, 0);
 
-    std::signal(SIGINT, on_sigint);
+    // No SA_RESTART: a receive blocked without a timeout must return on Ctrl-C.
+    struct sigaction sa{};
+    sa.sa_handler = on_sigint;
+    sigaction(SIGINT, &sa, nullptr);
 
     bool enable_gap_fill = false;
     bool verbose = false;
+    bool resume = false;
     uint64_t start_seq = 0;
     uint64_t max_msgs = 0;
+    const char* type_filter = nullptr;
 
     int opt;
-    while ((opt = ::getopt(argc, argv, "hgs:n:v")) != -1) {
+    while ((opt = ::getopt(argc, argv, "hgs:Rn:t:v")) != -1) {
         switch (opt) {
             case 'h': usage(argv[0]); return 0;
             case 'g': enable_gap_fill = true; break;
             case 's':
                 start_seq = std::stoull(optarg);
                 break;
+            case 'R': resume = true; break;
             case 'n': max_msgs = std::stoull(optarg); break;
+            case 't': type_filter = optarg; break;
             case 'v': verbose = true; break;
             default: usage(argv[0]); return 1;
         }
@@ -97,21 +122,85 @@ int main(int argc, char** argv) {
 
     const auto& cfg = config();
 
+    // Pin first so the arena is faulted in on the right NUMA node.
+    cpu_setup_placement(cfg.threads, interface_name_for_ip(cfg.net.interface_ip));
+
+    // Hot-path buffers come from here; allocations fall back to their own mappings without it.
+    if (cfg.memory.arena_bytes) arena_init(cfg.memory.arena_bytes, cfg.memory.hugepages, cfg.memory.mlock);
+
     // Multicast RX
-    UdpMcastReceiver rx;
-    if (!rx.open(cfg.net.mcast_ip,
-                 cfg.net.mcast_port,
-                 cfg.net.interface_ip,
-                 cfg.net.mcast_source_ip)) {
+    auto rx = make_receiver(cfg.rx);
+    if (!rx->open(cfg.net.mcast_ip,
+                  cfg.net.mcast_port,
+                  cfg.net.interface_ip,
+                  cfg.net.mcast_source_ip)) {
         std::cerr << "FATAL: multicast open failed\n";
         return 1;
     }
-    rx.set_rcvbuf(16 * 1024 * 1024);
+    rx->set_rcvbuf(16 * 1024 * 1024);
 
     // Decoder options
     DecodeOptions opt_dec;
     opt_dec.verbose = verbose;
 
+    // Type filter + per-type output routes
+    if (!output_open(cfg.output, opt_dec)) {
+        std::cerr << "FATAL: output setup failed\n";
+        return 1;
+    }
+    if (type_filter && !parse_type_list(type_filter, opt_dec.type_mask)) {
+        std::cerr << "FATAL: invalid -t '" << type_filter << "'\n";
+        return 1;
+    }
+
+    // Last-value state + snapshots; -R starts from the snapshot instead of sequence 1.
+    state_open(cfg.snapshot);
+    char resume_session[10] = {};
+    bool resumed = false;
+    if (resume) {
+        if (cfg.snapshot.path.empty()) {
+            std::cerr << "FATAL: -R requires [SNAPSHOT] path\n";
+            return 1;
+        }
+        uint64_t next_seq = 0;
+        if (state_load(cfg.snapshot.path, resume_session, next_seq)) {
+            const size_t n = state_replay(opt_dec);
+            std::cerr << "INFO: resumed from " << cfg.snapshot.path
+                      << " session=" << std::string(resume_session, 10)
+                      << " next_seq=" << next_seq << " cached=" << n << "\n";
+            start_seq = next_seq ? next_seq : 1;
+            resumed = true;
+        } else {
+            std::cerr << "WARN: no usable snapshot at " << cfg.snapshot.path << "; downloading from 1\n";
+            start_seq = 1;
+        }
+    }
+
+    // Where the last run stopped. A -g run given no explicit start picks up
+    // after the last message it delivered, so a restart only rerequests what
+    // it missed while down, plus the ranges its recovery gave up on.
+    bool auto_resumed = false;
+    std::vector<ProgressGap> resume_gaps;
+    if (!cfg.snapshot.progress.empty() && progress_open(cfg.snapshot.progress) &&
+        enable_gap_fill && start_seq == 0) {
+        uint64_t last_expected = 0;
+        if (progress_last(resume_session, last_expected, resume_gaps)) {
+            std::cerr << "INFO: resuming session=" << std::string(resume_session, 10)
+                      << " from seq=" << last_expected << " (" << resume_gaps.size()
+                      << " unrecovered ranges to retry)\n";
+            start_seq = last_expected;
+            auto_resumed = true;
+        }
+    }
+
+    // wake up often enough to honour flush_usec and to notice a stall when traffic stops
+    int wake_ms = output_linger_ms();
+    if (cfg.rx.stall_ms) {
+        const int stall_check = (int)std::min<uint32_t>(std::max<uint32_t>(cfg.rx.stall_ms / 4, 10), 1000);
+        wake_ms = wake_ms ? std::min(wake_ms, stall_check) : stall_check;
+    }
+    if (wake_ms) rx->set_timeout_ms(wake_ms);
+
     const bool start_mode = (start_seq != 0);
     const bool need_rereq = (enable_gap_fill || start_mode);
 
@@ -120,9 +209,15 @@ int main(int argc, char** argv) {
     bool rr_ok = false;
     if (need_rereq) {
         rr_ok = rr.open(cfg.net.rerequest_ip.c_str(), cfg.net.rerequest_port);
+        for (size_t i = 0; rr_ok && i < cfg.recovery.endpoints.size(); ++i) {
+            const RerequestEndpoint& e = cfg.recovery.endpoints[i];
+            if (!rr.add_endpoint(e.ip.c_str(), e.port)) {
+                std::cerr << "WARN: rerequest endpoint " << e.ip << ":" << e.port << " unusable; skipped\n";
+            }
+        }
         if (!rr_ok) {
-            if (start_mode) {
-                std::cerr << "FATAL: -s requires rerequest, but rerequester open failed\n";
+            if (start_mode && !auto_resumed) {
+                std::cerr << "FATAL: -s/-R requires rerequest, but rerequester open failed\n";
                 return 1;
             }
             if (enable_gap_fill) {
@@ -132,25 +227,9 @@ int main(int argc, char** argv) {
         }
     }
 
-    // One write per UDP packet (decoder writes into this buffer)
-    alignas(64) static char outbuf[256 * 1024];
-
-    // Batch receive
-    constexpr int BATCH = 32;
-    constexpr int MTU   = 65536;
-
-    alignas(64) static uint8_t bufs[BATCH][MTU];
-    static struct iovec iov[BATCH];
-    static struct mmsghdr msgs[BATCH];
-
-    for (int i = 0; i < BATCH; ++i) {
-        std::memset(&msgs[i], 0, sizeof(msgs[i]));
-        std::memset(&iov[i], 0, sizeof(iov[i]));
-        iov[i].iov_base = bufs[i];
-        iov[i].iov_len  = MTU;
-        msgs[i].msg_hdr.msg_iov = &iov[i];
-        msgs[i].msg_hdr.msg_iovlen = 1;
-    }
+    // Batch receive (buffers owned by the receiver backend)
+    static RxPacket pkts[MAX_RX_BATCH];
+    const int BATCH = (int)std::min<uint32_t>(std::max<uint32_t>(cfg.rx.batch, 1), MAX_RX_BATCH);
 
     uint64_t expected_seq = start_seq;  // 0 means "sync to first packet" (but we prevent pre-join backfill)
     uint64_t total_msgs = 0;
@@ -164,41 +243,130 @@ int main(int argc, char** argv) {
     // rate-limit timer for partial recovery warnings
     uint64_t last_partial_log_ms = 0;
 
+    // Session of the feed; sequence numbers only compare within one session.
+    SessionTracker sessions;
+
+    // Gap attribution: kernel drops on our side since the last gap mean the
+    // loss happened here (receive queue overflow), otherwise upstream.
+    uint64_t missing_local = 0;
+
+    // Counters for the metrics exporter; this thread is their only writer.
+    ThreadMetrics& mt = metrics_thread("rx");
+
+    // Gaps, tail gaps and stalls; any packet (data or heartbeat) resets the
+    // stall clock.
+    FeedMonitor mon(mt, (uint64_t)cfg.rx.stall_ms * 1000000ULL, mono_ns());
+    rr.set_metrics(mt);
+    metrics_start(cfg.metrics);
+
+    // GAP / RECOVERY lines are formatted and written off the receive thread
+    log_start();
+
+    // Hand one in-sequence packet on: data is decoded, a heartbeat only
+    // counts, end of session is printed and flushes the session's output.
+    auto deliver = [&](const uint8_t* pkt, size_t bytes, const char* session10, uint64_t seq, uint16_t cnt) {
+        if (cnt == 0xFFFF) {
+            // >> {'1234567891', 4345, 65535}
+            sessions.end(seq);
+            log_session(LOG_SESSION_END, session10, seq);
+            output_packet(pkt, bytes, opt_dec);
+            output_flush();
+            return;
+        }
+        if (cnt == 0) {
+            metrics_add(mt.heartbeats, 1);
+            return;
+        }
+        state_apply(pkt, bytes);
+        output_packet(pkt, bytes, opt_dec);
+        metrics_count_types(mt, pkt, bytes, cnt);
+        metrics_add(mt.messages, cnt);
+    };
+
+    cpu_setup_realtime(cfg.threads);
+
     while (!g_stop) {
         if (max_msgs > 0 && total_msgs >= max_msgs) break;
 
-        int n = rx.recv_batch(msgs, BATCH);
-        if (n <= 0) continue;
+        int n = rx->recv_packets(pkts, BATCH);
+        if (n <= 0) {
+            output_batch_end();
+            mon.idle(mono_ns(), sessions.current(), expected_seq);
+            continue;
+        }
+        const uint64_t batch_t0 = mono_ns();
+        mon.active(batch_t0, sessions.current());
 
         for (int i = 0; i < n; ++i) {
             if (max_msgs > 0 && total_msgs >= max_msgs) break;
 
-            size_t bytes = (size_t)msgs[i].msg_len;
+            const uint8_t* pkt = pkts[i].data;
+            size_t bytes = (size_t)pkts[i].len;
             if (bytes == 0) continue;
 
+            metrics_add(mt.packets, 1);
+            metrics_add(mt.bytes, bytes);
+
             char session10[10];
             uint64_t seq;
             uint16_t cnt;
 
-            if (!read_mold_header(bufs[i], bytes, session10, seq, cnt)) continue;
+            if (!read_mold_header(pkt, bytes, session10, seq, cnt)) continue;
 
-            // End of Session
-            // >> {'1234567891', 4345, 65535}
-            if (cnt == 0xFFFF) {
-                char line[128];
-                int  l = std::snprintf(line, sizeof(line),
-                                       ">> {'%.*s', %llu, %u}\n",
-                                       10, session10,
-                                       (unsigned long long)seq,
-                                       (unsigned)cnt);
-                if (l > 0) (void)!::write(1, line, (size_t)l);
+            const SessionEvent sev = sessions.observe(session10);
+            if (sev == SessionEvent::STALE) {
+                // late packet of a session we already left
+                metrics_add(mt.stale_packets, 1);
                 continue;
             }
+            if (sev == SessionEvent::ROLLOVER) {
+                // Old session's output goes out first; the new session is
+                // taken from sequence 1, so anything before this packet is a gap.
+                output_flush();
+                log_sessions(LOG_SESSION_ROLLOVER, sessions.previous(), session10,
+                             expected_seq ? expected_seq - 1 : 0, sessions.previous_ended() ? 1 : 0);
+                metrics_add(mt.session_rollovers, 1);
+                expected_seq = 1;
+                joined_live = true;
+                mon.reset_drops(rx->local_drops());
+                state_reset();
+            }
+
+            // Heartbeats and end of session can reveal a tail gap (see
+            // feedmon.h); only the first end-of-session packet counts.
+            const FeedVerdict verdict = mon.classify(expected_seq, seq, cnt, sessions.ended());
+            if (verdict == FeedVerdict::REPEAT_END) continue;
+            const uint16_t msgs = (cnt == 0xFFFF) ? 0 : cnt;
 
             // If -s was provided, the first live packet is used to discover session + "current".
             if (start_mode && !initial_done) {
                 if (expected_seq == 0) expected_seq = 1; // safety; user likely passed -s anyway
 
+                // A snapshot of an earlier session is no base for this one.
+                if (resumed && std::memcmp(resume_session, session10, 10) != 0) {
+                    std::cerr << "WARN: snapshot session " << std::string(resume_session, 10)
+                              << " is not the live session " << std::string(session10, 10)
+                              << "; downloading from 1\n";
+                    state_reset();
+                    expected_seq = 1;
+                }
+                // The last run was on an earlier session: nothing to catch up on, join live.
+                if (auto_resumed && std::memcmp(resume_session, session10, 10) != 0) {
+                    expected_seq = seq;
+                } else if (auto_resumed && rr_ok && !resume_gaps.empty()) {
+                    // What the last run could not recover, once more; whatever
+                    // still fails is recorded again.
+                    progress_clear_gaps();
+                    for (const ProgressGap& g : resume_gaps) {
+                        log_session(LOG_DOWNLOAD, session10, g.seq, g.count);
+                        const uint64_t rec = rr.recover(session10, g.seq, g.count, opt_dec);
+                        metrics_add(mt.recovered, rec);
+                        metrics_add(mt.messages, rec);
+                        total_msgs += rec;
+                        if (rec < g.count) progress_add_gap(g.seq + rec, g.count - rec);
+                    }
+                }
+
                 // Initial download via rerequest: [expected_seq .. seq-1]
                 if (rr_ok && seq > expected_seq) {
                     uint64_t gap = seq - expected_seq;
@@ -214,18 +382,21 @@ int main(int argc, char** argv) {
                     }
 
                     if (need > 0) {
-                        std::cerr << "DOWNLOAD session=" << std::string(session10, 10)
-                                  << " from=" << expected_seq << " count=" << need << "\n";
+                        log_session(LOG_DOWNLOAD, session10, expected_seq, need);
 
-                        uint64_t rec = rr.recover(session10, expected_seq, need, opt_dec);
+                        const uint64_t rec_t0 = mono_ns();
+                        uint64_t rec = rr.download(session10, expected_seq, need, opt_dec);
+                        metrics_observe(mt.recovery_ns, mono_ns() - rec_t0);
+                        metrics_add(mt.recovered, rec);
+                        metrics_add(mt.messages, rec);
                         total_msgs += rec;
                         expected_seq += rec;
 
                         // rate-limited partial recovery warning (download path)
                         if (rec < need && should_log_every_ms(last_partial_log_ms, 1000)) {
-                            std::cerr << "WARN: RECOVERY partial recovered=" << rec
-                                      << " still_missing=" << (need - rec) << "\n";
+                            log_event(LOG_RECOVERY_PARTIAL, rec, need - rec);
                         }
+                        if (rec < need) progress_add_gap(expected_seq, need - rec);
                     }
                 }
 
@@ -238,15 +409,14 @@ int main(int argc, char** argv) {
                 // Sync to this live packet (best-effort) and decode it.
                 expected_seq = seq;
 
-                size_t outn = decode_moldudp64_packet_to_buffer(bufs[i], bytes, opt_dec, outbuf, sizeof(outbuf));
-                if (outn) (void)!::write(1, outbuf, outn);
+                deliver(pkt, bytes, session10, seq, cnt);
 
-                total_msgs += cnt;
-                expected_seq += cnt;
+                total_msgs += msgs;
+                expected_seq += msgs;
                 initial_done = true;
 
                 // -s without -g: "download then exit"
-                if (!enable_gap_fill) {
+                if (!enable_gap_fill && !auto_resumed) {
                     if (max_msgs == 0 || total_msgs >= max_msgs) {
                         g_stop = 1;
                         break;
@@ -262,23 +432,19 @@ int main(int argc, char** argv) {
                 joined_live = true;
 
                 // decode/print the packet we actually received
-                size_t outn = decode_moldudp64_packet_to_buffer(bufs[i], bytes, opt_dec, outbuf, sizeof(outbuf));
-                if (outn) (void)!::write(1, outbuf, outn);
+                deliver(pkt, bytes, session10, seq, cnt);
 
-                total_msgs += cnt;
+                total_msgs += msgs;
 
                 // next expected starts AFTER this packet
-                expected_seq = seq + cnt;
+                expected_seq = seq + msgs;
                 continue;
             }
 
             // GAP detection (after join)
-            if (seq > expected_seq) {
+            if (verdict == FeedVerdict::GAP) {
                 uint64_t gap = seq - expected_seq;
-
-                std::cerr << "GAP session=" << std::string(session10, 10)
-                          << " range=" << expected_seq << "-" << (seq - 1)
-                          << " count=" << gap << "\n";
+                if (mon.gap(session10, expected_seq, seq, cnt, rx->local_drops())) missing_local += gap;
 
                 if (enable_gap_fill && rr_ok) {
                     uint64_t remaining = (max_msgs > 0 && total_msgs < max_msgs) ? (max_msgs - total_msgs) : 0;
@@ -291,39 +457,65 @@ int main(int argc, char** argv) {
                         if (need > remaining) need = remaining;
                     }
 
+                    const uint64_t rec_t0 = mono_ns();
                     uint64_t rec = rr.recover(session10, expected_seq, need, opt_dec);
+                    metrics_observe(mt.recovery_ns, mono_ns() - rec_t0);
+                    metrics_add(mt.recovered, rec);
+                    metrics_add(mt.messages, rec);
                     total_msgs += rec;
                     expected_seq += rec;
 
                     // rate-limited partial recovery warning (gap-fill path)
                     if (rec < need && should_log_every_ms(last_partial_log_ms, 1000)) {
-                        std::cerr << "WARN: RECOVERY partial recovered=" << rec
-                                  << " still_missing=" << (need - rec) << "\n";
+                        log_event(LOG_RECOVERY_PARTIAL, rec, need - rec);
                     }
+                    if (rec < need) progress_add_gap(expected_seq, need - rec);
                 }
 
                 // Sync to live packet after recovery attempt (or after logging gap if -g not enabled)
                 expected_seq = seq;
-            } else if (seq < expected_seq) {
+            } else if (verdict == FeedVerdict::DUPLICATE) {
                 // stale/duplicate
+                metrics_add(mt.duplicates, msgs);
                 continue;
             }
 
-            // Decode live packet (one write per packet)
-            size_t outn = decode_moldudp64_packet_to_buffer(bufs[i], bytes, opt_dec, outbuf, sizeof(outbuf));
-            if (outn) (void)!::write(1, outbuf, outn);
+            // Decode live packet (one write per route per packet)
+            deliver(pkt, bytes, session10, seq, cnt);
 
             // Count & advance state
-            total_msgs += cnt;
-            expected_seq += cnt;
+            total_msgs += msgs;
+            expected_seq += msgs;
 
             if (max_msgs > 0 && total_msgs >= max_msgs) {
                 g_stop = 1;
                 break;
             }
         }
+
+        // buffers go back to the backend; decoded text was already copied out
+        rx->release();
+
+        // one flush decision per receive batch
+        output_batch_end();
+        state_maybe_checkpoint();
+        if (sessions.known()) {
+            progress_update(sessions.current(), expected_seq);
+        }
+        metrics_observe(mt.batch_ns, mono_ns() - batch_t0);
     }
 
+    log_stop();
+    metrics_stop();
+    state_close();
+    output_close();
+    progress_close();
     std::cerr << "INFO: stopped msgs=" << total_msgs << " expected_seq=" << expected_seq << "\n";
+    const uint64_t gaps = mt.gaps.load(), gaps_local = mt.gaps_local.load();
+    if (gaps) {
+        std::cerr << "INFO: gaps local=" << gaps_local << " (" << missing_local << " msgs, "
+                  << rx->local_drops() << " kernel drops)"
+                  << " upstream=" << (gaps - gaps_local) << " (" << (mt.gap_messages.load() - missing_local) << " msgs)\n";
+    }
     return 0;
 }
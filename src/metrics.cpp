@@ -0,0 +1,275 @@
+#include "metrics.h"
+#include "config.h"
+#include "cpu.h"
+
+#include <cerrno>
+#include <cstdarg>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// One block per registered thread plus a spare for overflow; static storage,
+// so every counter starts at zero.
+static ThreadMetrics g_blocks[METRICS_MAX_THREADS + 1];
+static std::atomic<int> g_nclaimed{0};   // blocks handed out
+static std::atomic<int> g_nblocks{0};    // blocks visible to the exporter
+
+static std::thread g_exporter;
+static std::atomic<bool> g_exporter_stop{false};
+static int g_listen_fd = -1;
+static bool g_http = false;
+static std::string g_unix_path;
+
+ThreadMetrics& metrics_thread(const char* name) {
+    thread_local ThreadMetrics* mine = nullptr;
+    if (mine) return *mine;
+
+    const int i = g_nclaimed.fetch_add(1, std::memory_order_relaxed);
+    if (i >= METRICS_MAX_THREADS) {
+        mine = &g_blocks[METRICS_MAX_THREADS];
+        return *mine;
+    }
+    mine = &g_blocks[i];
+    std::snprintf(mine->name, sizeof(mine->name), "%s", name ? name : "");
+
+    // publish after the name is set, in claim order (wait for earlier claims)
+    int expect = i;
+    while (!g_nblocks.compare_exchange_weak(expect, i + 1, std::memory_order_release, std::memory_order_relaxed)) {
+        expect = i;
+    }
+    return *mine;
+}
+
+static void appendf(std::string& s, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+static void appendf(std::string& s, const char* fmt, ...) {
+    char buf[256];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = std::vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    if (n > 0) s.append(buf, (size_t)n < sizeof(buf) ? (size_t)n : sizeof(buf) - 1);
+}
+
+static inline uint64_t rd(const std::atomic<uint64_t>& c) { return c.load(std::memory_order_relaxed); }
+
+static void render_hist(std::string& s, const char* metric, const char* help, const MetricsHist* const* h,
+                        const ThreadMetrics* blocks, int n) {
+    appendf(s, "# HELP %s %s\n# TYPE %s histogram\n", metric, help, metric);
+    for (int t = 0; t < n; ++t) {
+        uint64_t cum = 0;
+        for (int b = 0; b <= METRICS_HIST_BUCKETS; ++b) {
+            cum += rd(h[t]->bucket[b]);
+            if (b < METRICS_HIST_BUCKETS) {
+                appendf(s, "%s_bucket{thread=\"%s\",le=\"%.9g\"} %llu\n", metric, blocks[t].name,
+                        (double)(256ull << b) / 1e9, (unsigned long long)cum);
+            } else {
+                appendf(s, "%s_bucket{thread=\"%s\",le=\"+Inf\"} %llu\n", metric, blocks[t].name,
+                        (unsigned long long)cum);
+            }
+        }
+        appendf(s, "%s_sum{thread=\"%s\"} %.9f\n", metric, blocks[t].name, (double)rd(h[t]->sum_ns) / 1e9);
+        appendf(s, "%s_count{thread=\"%s\"} %llu\n", metric, blocks[t].name, (unsigned long long)rd(h[t]->count));
+    }
+}
+
+std::string metrics_render() {
+    const int n = g_nblocks.load(std::memory_order_acquire);
+    const ThreadMetrics* m = g_blocks;
+    std::string s;
+    s.reserve(8192);
+
+    struct Counter {
+        const char* name;
+        const char* help;
+        std::atomic<uint64_t> ThreadMetrics::* field;
+    };
+    static const Counter counters[] = {
+        {"moldudp64_packets_total",            "Datagrams received",                      &ThreadMetrics::packets},
+        {"moldudp64_bytes_total",              "Datagram bytes received",                 &ThreadMetrics::bytes},
+        {"moldudp64_messages_total",           "Messages delivered, live and recovered",  &ThreadMetrics::messages},
+        {"moldudp64_gap_messages_total",       "Messages missing across detected gaps",   &ThreadMetrics::gap_messages},
+        {"moldudp64_recovered_messages_total", "Messages filled in by rerequest",         &ThreadMetrics::recovered},
+        {"moldudp64_duplicate_messages_total", "Messages received more than once",        &ThreadMetrics::duplicates},
+        {"moldudp64_local_drops_total",        "Datagrams dropped by the kernel on the receive side", &ThreadMetrics::local_drops},
+        {"moldudp64_session_rollovers_total",  "Switches to a new MoldUDP64 session",     &ThreadMetrics::session_rollovers},
+        {"moldudp64_stale_packets_total",      "Packets of a session already left",       &ThreadMetrics::stale_packets},
+        {"moldudp64_heartbeats_total",         "Heartbeat packets received",              &ThreadMetrics::heartbeats},
+        {"moldudp64_tail_gaps_total",          "Gaps detected on a heartbeat or end of session", &ThreadMetrics::tail_gaps},
+        {"moldudp64_stalls_total",             "Feed stalls (no data or heartbeat within stall_ms)", &ThreadMetrics::stalls},
+        {"moldudp64_rerequest_retransmits_total", "Rerequests sent again for the outstanding range", &ThreadMetrics::rerequest_retransmits},
+        {"moldudp64_rerequest_rejected_total", "Rerequest answers dropped: wrong source or session, malformed", &ThreadMetrics::rerequest_rejected},
+    };
+    for (const Counter& c : counters) {
+        appendf(s, "# HELP %s %s\n# TYPE %s counter\n", c.name, c.help, c.name);
+        for (int t = 0; t < n; ++t) {
+            appendf(s, "%s{thread=\"%s\"} %llu\n", c.name, m[t].name, (unsigned long long)rd(m[t].*c.field));
+        }
+    }
+
+    appendf(s, "# HELP moldudp64_gaps_total Sequence gaps detected, by cause\n# TYPE moldudp64_gaps_total counter\n");
+    for (int t = 0; t < n; ++t) {
+        const uint64_t all = rd(m[t].gaps), local = rd(m[t].gaps_local);
+        appendf(s, "moldudp64_gaps_total{thread=\"%s\",cause=\"local\"} %llu\n", m[t].name, (unsigned long long)local);
+        appendf(s, "moldudp64_gaps_total{thread=\"%s\",cause=\"upstream\"} %llu\n", m[t].name,
+                (unsigned long long)(all - local));
+    }
+
+    appendf(s, "# HELP moldudp64_type_messages_total Live messages by message type\n# TYPE moldudp64_type_messages_total counter\n");
+    for (int t = 0; t < n; ++t) {
+        for (int ty = 0; ty < 256; ++ty) {
+            const uint64_t v = rd(m[t].type_count[ty]);
+            if (!v) continue;
+            if (ty > ' ' && ty < 0x7f && ty != '"' && ty != '\\') {
+                appendf(s, "moldudp64_type_messages_total{thread=\"%s\",type=\"%c\"} %llu\n", m[t].name, ty,
+                        (unsigned long long)v);
+            } else {
+                appendf(s, "moldudp64_type_messages_total{thread=\"%s\",type=\"0x%02x\"} %llu\n", m[t].name, ty,
+                        (unsigned long long)v);
+            }
+        }
+    }
+
+    const MetricsHist* batch[METRICS_MAX_THREADS];
+    const MetricsHist* rec[METRICS_MAX_THREADS];
+    const MetricsHist* rtt[METRICS_MAX_THREADS];
+    for (int t = 0; t < n; ++t) {
+        batch[t] = &m[t].batch_ns;
+        rec[t] = &m[t].recovery_ns;
+        rtt[t] = &m[t].rerequest_rtt_ns;
+    }
+    render_hist(s, "moldudp64_batch_seconds", "Decode and output time per receive batch", batch, m, n);
+    render_hist(s, "moldudp64_recovery_seconds", "Duration of one gap recovery", rec, m, n);
+    render_hist(s, "moldudp64_rerequest_rtt_seconds", "Rerequest sent to first answer", rtt, m, n);
+    return s;
+}
+
+// ---------- exporter ----------
+
+static void write_all(int fd, const char* p, size_t n) {
+    while (n > 0) {
+        ssize_t w = ::send(fd, p, n, MSG_NOSIGNAL);   // scraper may hang up early
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) return;
+        p += w;
+        n -= (size_t)w;
+    }
+}
+
+static void serve_one(int cfd) {
+    if (g_http) {
+        // Read (and ignore) the request; scrapers send it in one segment.
+        pollfd pfd{cfd, POLLIN, 0};
+        char req[1024];
+        if (::poll(&pfd, 1, 1000) > 0) (void)::read(cfd, req, sizeof(req));
+    }
+
+    const std::string body = metrics_render();
+    if (g_http) {
+        char hdr[160];
+        int l = std::snprintf(hdr, sizeof(hdr),
+                              "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                              "Content-Length: %zu\r\nConnection: close\r\n\r\n", body.size());
+        write_all(cfd, hdr, (size_t)l);
+    }
+    write_all(cfd, body.data(), body.size());
+}
+
+static void exporter_loop() {
+    while (!g_exporter_stop.load(std::memory_order_relaxed)) {
+        pollfd pfd{g_listen_fd, POLLIN, 0};
+        if (::poll(&pfd, 1, 200) <= 0) continue;
+
+        int cfd = ::accept(g_listen_fd, nullptr, nullptr);
+        if (cfd < 0) continue;
+        serve_one(cfd);
+        ::close(cfd);
+    }
+}
+
+static int listen_http(const std::string& hostport) {
+    const size_t colon = hostport.rfind(':');
+    if (colon == std::string::npos) return -1;
+    std::string host = hostport.substr(0, colon);
+    if (host.empty()) host = "0.0.0.0";
+
+    const unsigned long port = std::strtoul(hostport.c_str() + colon + 1, nullptr, 10);
+    if (port == 0 || port > 65535) return -1;
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    if (::inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1) return -1;
+
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    int reuse = 1;
+    ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    if (::bind(fd, (sockaddr*)&addr, sizeof(addr)) < 0 || ::listen(fd, 16) < 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int listen_unix(const std::string& path) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) return -1;
+    std::memcpy(addr.sun_path, path.c_str(), path.size());
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    ::unlink(path.c_str());   // stale socket from a previous run
+    if (::bind(fd, (sockaddr*)&addr, sizeof(addr)) < 0 || ::listen(fd, 16) < 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool metrics_start(const MetricsConfig& cfg) {
+    metrics_stop();
+    if (cfg.listen.empty()) return true;
+
+    const std::string& l = cfg.listen;
+    if (l.compare(0, 5, "unix:") == 0) {
+        g_http = false;
+        g_unix_path = l.substr(5);
+        g_listen_fd = listen_unix(g_unix_path);
+    } else if (l.compare(0, 7, "http://") == 0) {
+        g_http = true;
+        g_listen_fd = listen_http(l.substr(7));
+    } else {
+        std::cerr << "WARN: metrics listen '" << l << "' not understood (unix:/path | http://host:port)\n";
+        return false;
+    }
+    if (g_listen_fd < 0) {
+        std::cerr << "WARN: metrics listener '" << l << "' failed errno=" << errno << "\n";
+        g_unix_path.clear();
+        return false;
+    }
+
+    g_exporter_stop.store(false);
+    g_exporter = cpu_start_aux_thread(exporter_loop);
+    std::cerr << "INFO: metrics on " << l << "\n";
+    return true;
+}
+
+void metrics_stop() {
+    if (g_exporter.joinable()) {
+        g_exporter_stop.store(true);
+        g_exporter.join();
+    }
+    if (g_listen_fd >= 0) ::close(g_listen_fd);
+    g_listen_fd = -1;
+    if (!g_unix_path.empty()) ::unlink(g_unix_path.c_str());
+    g_unix_path.clear();
+}
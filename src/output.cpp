@@ -0,0 +1,333 @@
+#include "output.h"
+#include "decoder.h"
+#include "config.h"
+#include "sink.h"
+#include "shmbus.h"
+#include "arena.h"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <sys/uio.h>
+#include <time.h>
+
+// Decoded text accumulates per route in fixed chunks and is flushed with
+// one writev() per route according to the flush policy.
+constexpr size_t CHUNK_BYTES     = 512 * 1024;
+constexpr int    MAX_CHUNKS      = 16;
+
+enum class FlushPolicy : uint8_t {
+    PACKET,   // flush after every packet (lowest latency)
+    BATCH,    // flush at the end of every receive batch / recovery request
+    BYTES     // flush at flush_bytes pending, or after flush_usec
+};
+
+struct RouteState {
+    std::unique_ptr<OutputSink> sink;
+    char*  chunks[MAX_CHUNKS] = {};
+    size_t used[MAX_CHUNKS] = {};
+    int    cur = 0;
+    size_t pending = 0;
+};
+
+static RouteState g_routes[MAX_OUTPUT_ROUTES];
+static int g_nroutes = 0;
+static bool g_text = true;      // false with "sink: none" and no routes
+
+enum class OutputFormat : uint8_t {
+    TEXT,        // decoded lines
+    BINARY,      // MoldRecordHeader + message as received
+    BINARY_LE    // MoldRecordHeader + message with integer fields little-endian
+};
+static OutputFormat g_format = OutputFormat::TEXT;
+
+static FlushPolicy g_policy = FlushPolicy::BATCH;
+static size_t   g_flush_bytes = 1u << 20;
+static uint64_t g_flush_ns = 1000000;
+static size_t   g_pending = 0;
+static uint64_t g_pending_since_ns = 0;
+
+static ShmBusWriter g_bus;
+
+static uint64_t mono_ns() {
+    struct timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void flush_route(RouteState& r) {
+    if (r.pending == 0) return;
+
+    struct iovec iov[MAX_CHUNKS];
+    int k = 0;
+    for (int c = 0; c <= r.cur && c < MAX_CHUNKS; ++c) {
+        if (r.used[c] == 0) continue;
+        iov[k].iov_base = r.chunks[c];
+        iov[k].iov_len  = r.used[c];
+        ++k;
+        r.used[c] = 0;
+    }
+    if (k) r.sink->writev(iov, k);
+    r.sink->flush();
+
+    r.cur = 0;
+    r.pending = 0;
+}
+
+static void flush_all() {
+    for (int i = 0; i < g_nroutes; ++i) flush_route(g_routes[i]);
+    g_pending = 0;
+}
+
+// Make sure the current chunk can take a whole packet's worth of text.
+static bool reserve(RouteState& r, size_t need) {
+    if (r.chunks[r.cur] && CHUNK_BYTES - r.used[r.cur] >= need) return true;
+
+    if (r.chunks[r.cur] && r.used[r.cur] > 0) {
+        if (r.cur + 1 >= MAX_CHUNKS) {
+            g_pending -= r.pending;
+            flush_route(r);
+        } else {
+            ++r.cur;
+        }
+    }
+    if (!r.chunks[r.cur]) {
+        r.chunks[r.cur] = static_cast<char*>(arena_alloc(CHUNK_BYTES));
+        if (!r.chunks[r.cur]) return false;
+        r.used[r.cur] = 0;
+    }
+    return true;
+}
+
+static void after_append(size_t n) {
+    if (n == 0) return;
+    if (g_pending == 0 && g_policy == FlushPolicy::BYTES) g_pending_since_ns = mono_ns();
+    g_pending += n;
+
+    if (g_policy == FlushPolicy::PACKET ||
+        (g_policy == FlushPolicy::BYTES && g_pending >= g_flush_bytes)) {
+        flush_all();
+    }
+}
+
+bool output_open(const OutputConfig& cfg, DecodeOptions& opt) {
+    output_close();
+
+    if (!parse_type_list(cfg.message_types.c_str(), opt.type_mask)) {
+        std::cerr << "OUTPUT invalid message_types='" << cfg.message_types << "'\n";
+        return false;
+    }
+
+    if      (cfg.flush_policy == "packet") g_policy = FlushPolicy::PACKET;
+    else if (cfg.flush_policy == "batch")  g_policy = FlushPolicy::BATCH;
+    else if (cfg.flush_policy == "bytes")  g_policy = FlushPolicy::BYTES;
+    else {
+        std::cerr << "OUTPUT invalid flush_policy='" << cfg.flush_policy << "'\n";
+        return false;
+    }
+    if      (cfg.format == "text")      g_format = OutputFormat::TEXT;
+    else if (cfg.format == "binary")    g_format = OutputFormat::BINARY;
+    else if (cfg.format == "binary_le") g_format = OutputFormat::BINARY_LE;
+    else {
+        std::cerr << "OUTPUT invalid format='" << cfg.format << "'\n";
+        return false;
+    }
+    g_flush_bytes = cfg.flush_bytes ? cfg.flush_bytes : 1;
+    g_flush_ns = (uint64_t)cfg.flush_usec * 1000ULL;
+
+    const std::string& ifip = config().net.interface_ip;
+
+    const BusConfig& bus = config().bus;
+    if (!bus.name.empty()) {
+        if (!g_bus.open(bus.name, bus.slots, bus.slot_size)) {
+            std::cerr << "OUTPUT cannot open bus '" << bus.name << "'\n";
+            return false;
+        }
+        std::cerr << "INFO: publishing to bus " << bus.name << "\n";
+    }
+
+    g_text = (cfg.sink != "none") || !cfg.routes.empty();
+    g_routes[0].sink = make_sink(cfg.sink, cfg.file_buffer_bytes, ifip);
+    if (!g_routes[0].sink) {
+        std::cerr << "OUTPUT cannot open sink '" << cfg.sink << "'\n";
+        return false;
+    }
+    g_routes[0].sink->set_binary_records(g_format != OutputFormat::TEXT);
+    g_nroutes = 1;
+
+    std::memset(opt.type_route, 0, sizeof(opt.type_route));
+
+    for (const auto& r : cfg.routes) {
+        if (g_nroutes >= MAX_OUTPUT_ROUTES) {
+            std::cerr << "OUTPUT too many routes (max " << (MAX_OUTPUT_ROUTES - 1) << ")\n";
+            return false;
+        }
+
+        uint64_t mask[4];
+        if (!parse_type_list(r.types.c_str(), mask)) {
+            std::cerr << "OUTPUT invalid route types='" << r.types << "'\n";
+            return false;
+        }
+
+        auto sink = make_sink(r.target, cfg.file_buffer_bytes, ifip);
+        if (!sink) {
+            std::cerr << "OUTPUT cannot open sink '" << r.target << "'\n";
+            return false;
+        }
+
+        sink->set_binary_records(g_format != OutputFormat::TEXT);
+        const int idx = g_nroutes++;
+        g_routes[idx].sink = std::move(sink);
+
+        // later routes win for types listed more than once
+        for (int t = 0; t < 256; ++t) {
+            if ((mask[t >> 6] >> (t & 63)) & 1ULL) opt.type_route[t] = (uint8_t)idx;
+        }
+    }
+
+    return true;
+}
+
+static uint64_t realtime_ns() {
+    struct timespec ts{};
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// One publish per enabled message; the bus never sees the text path.
+static void publish_packet(const uint8_t* buf, size_t len, const DecodeOptions& opt, uint64_t now_ns) {
+    // as many as the largest datagram can carry (2-byte length + type byte each)
+    static MoldMessageView views[(65535 - 20) / 3];
+
+    size_t n = split_moldudp64_packet(buf, len, opt, views, sizeof(views) / sizeof(views[0]));
+    if (n == 0) return;
+
+    g_bus.set_session(reinterpret_cast<const char*>(buf));
+    for (size_t i = 0; i < n; ++i) {
+        g_bus.publish(views[i].seq, now_ns, views[i].data, views[i].len);
+    }
+}
+
+// A packet whose output can exceed a chunk (a jumbo datagram of small
+// messages): what is pending goes out first, then the packet is decoded
+// into buffers sized to its bound and written straight to the sinks.
+static void output_oversized(const uint8_t* buf, size_t len, const DecodeOptions& opt, bool binary,
+                             uint64_t now_ns, const size_t* need) {
+    static std::vector<char> big[MAX_OUTPUT_ROUTES];
+
+    flush_all();
+    DecodeRoute routes[MAX_OUTPUT_ROUTES];
+    for (int i = 0; i < g_nroutes; ++i) {
+        if (big[i].size() < need[i]) big[i].resize(need[i]);
+        routes[i].out = big[i].data();
+        routes[i].cap = need[i];
+        routes[i].len = 0;
+    }
+
+    const size_t total = binary
+        ? encode_moldudp64_packet_to_routes(buf, len, opt, now_ns, g_format == OutputFormat::BINARY_LE,
+                                            routes, (size_t)g_nroutes)
+        : decode_moldudp64_packet_to_routes(buf, len, opt, routes, (size_t)g_nroutes);
+    if (total == 0) return;
+
+    for (int i = 0; i < g_nroutes; ++i) {
+        if (routes[i].len == 0) continue;
+        g_routes[i].sink->write(routes[i].out, routes[i].len);
+        g_routes[i].sink->flush();
+    }
+}
+
+void output_packet(const uint8_t* buf, size_t len, const DecodeOptions& opt) {
+    const bool binary = g_format != OutputFormat::TEXT;
+    if (!g_bus.is_open() && (g_nroutes == 0 || !g_text)) return;
+
+    // one receive timestamp per packet, shared by the bus and binary records
+    const uint64_t now_ns = (g_bus.is_open() || binary) ? realtime_ns() : 0;
+    if (g_bus.is_open()) publish_packet(buf, len, opt, now_ns);
+    if (g_nroutes == 0 || !g_text) return;
+
+    // Reserve what this packet can produce per route, so chunks fill up
+    // before they are handed on.
+    size_t need[MAX_OUTPUT_ROUTES];
+    moldudp64_output_bound(buf, len, opt, binary, need, (size_t)g_nroutes);
+    for (int i = 0; i < g_nroutes; ++i) {
+        if (need[i] > CHUNK_BYTES) {
+            output_oversized(buf, len, opt, binary, now_ns, need);
+            return;
+        }
+    }
+
+    DecodeRoute routes[MAX_OUTPUT_ROUTES];
+    for (int i = 0; i < g_nroutes; ++i) {
+        RouteState& r = g_routes[i];
+        if (need[i] && !reserve(r, need[i])) return;
+        routes[i].out = r.chunks[r.cur];
+        routes[i].cap = r.chunks[r.cur] ? CHUNK_BYTES : 0;
+        routes[i].len = r.used[r.cur];
+    }
+
+    size_t total = binary
+        ? encode_moldudp64_packet_to_routes(buf, len, opt, now_ns, g_format == OutputFormat::BINARY_LE,
+                                            routes, (size_t)g_nroutes)
+        : decode_moldudp64_packet_to_routes(buf, len, opt, routes, (size_t)g_nroutes);
+    if (total == 0) return;
+
+    for (int i = 0; i < g_nroutes; ++i) {
+        RouteState& r = g_routes[i];
+        r.pending += routes[i].len - r.used[r.cur];
+        r.used[r.cur] = routes[i].len;
+    }
+    after_append(total);
+}
+
+void output_write(const char* data, size_t n) {
+    if (n == 0 || g_nroutes == 0 || !g_text || g_format != OutputFormat::TEXT) return;
+
+    RouteState& r = g_routes[0];
+    if (n > CHUNK_BYTES || !reserve(r, n)) {
+        flush_all();
+        r.sink->write(data, n);
+        return;
+    }
+    std::memcpy(r.chunks[r.cur] + r.used[r.cur], data, n);
+    r.used[r.cur] += n;
+    r.pending += n;
+    after_append(n);
+}
+
+void output_batch_end() {
+    if (g_pending == 0) return;
+    if (g_policy == FlushPolicy::BATCH ||
+        (g_policy == FlushPolicy::BYTES && mono_ns() - g_pending_since_ns >= g_flush_ns)) {
+        flush_all();
+    }
+}
+
+int output_linger_ms() {
+    if (g_policy != FlushPolicy::BYTES) return 0;
+    const uint64_t ms = g_flush_ns / 1000000ULL;
+    return ms ? (int)ms : 1;
+}
+
+void output_flush() {
+    flush_all();
+}
+
+void output_close() {
+    for (int i = 0; i < g_nroutes; ++i) {
+        RouteState& r = g_routes[i];
+        flush_route(r);
+        r.sink.reset();
+        for (int c = 0; c < MAX_CHUNKS; ++c) {
+            arena_free(r.chunks[c], CHUNK_BYTES);
+            r.chunks[c] = nullptr;
+            r.used[c] = 0;
+        }
+        r.cur = 0;
+    }
+    g_nroutes = 0;
+    g_pending = 0;
+    g_bus.close();
+}
@@ -0,0 +1,231 @@
+#include "socket.h"
+#include "config.h"
+#include "netparse.h"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <poll.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/mman.h>
+#include <linux/filter.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+
+static constexpr uint32_t RING_FRAME_SIZE = 2048;   // only a hint for V3; must divide block size
+
+static inline uint32_t block_status(const uint8_t* blk) {
+    auto* bd = reinterpret_cast<const tpacket_block_desc*>(blk);
+    return __atomic_load_n(&bd->hdr.bh1.block_status, __ATOMIC_ACQUIRE);
+}
+
+PacketRingReceiver::PacketRingReceiver(const ReceiveConfig& rc)
+    : ifindex_(0), group_be_(0), port_be_(0), source_be_(0),
+      block_size_(rc.ring_block_size), block_nr_(rc.ring_blocks), block_tov_ms_(rc.ring_block_timeout_ms),
+      pkt_fd_(-1), ring_(nullptr), ring_len_(0),
+      cur_block_(0), pkts_left_(0), next_pkt_(nullptr), cur_handed_(false), ring_drops_(0) {}
+
+PacketRingReceiver::~PacketRingReceiver() { close(); }
+
+void PacketRingReceiver::close_ring() {
+    if (pkt_fd_ >= 0 && PacketRingReceiver::local_drops()) {
+        std::cerr << "WARN: packet_ring: " << ring_drops_ << " frames dropped by the kernel (ring full)\n";
+    }
+    ring_drops_ = 0;
+    if (ring_) ::munmap(ring_, ring_len_);
+    if (pkt_fd_ >= 0) ::close(pkt_fd_);
+    ring_ = nullptr;
+    pkt_fd_ = -1;
+    cur_block_ = 0;
+    pkts_left_ = 0;
+    next_pkt_ = nullptr;
+    cur_handed_ = false;
+    done_.clear();
+}
+
+void PacketRingReceiver::close() {
+    close_ring();
+    UdpMcastReceiver::close();
+}
+
+void PacketRingReceiver::mute_udp_socket() {
+    sock_filter drop = BPF_STMT(BPF_RET | BPF_K, 0);
+    sock_fprog prog{1, &drop};
+    if (::setsockopt(fd_, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog)) != 0) {
+        // not fatal: the socket buffer just fills up and drops
+        int one = 1;
+        ::setsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &one, sizeof(one));
+    }
+}
+
+bool PacketRingReceiver::open_joined(const std::string& mcast_ip,
+                                     uint16_t mcast_port,
+                                     const std::string& interface_ip,
+                                     const std::string& source_ip) {
+    if (!UdpMcastReceiver::open(mcast_ip, mcast_port, interface_ip, source_ip)) return false;
+
+    group_be_ = ::inet_addr(mcast_ip.c_str());
+    port_be_  = htons(mcast_port);
+    source_be_ = source_ip.empty() ? 0 : ::inet_addr(source_ip.c_str());
+    ifname_   = interface_name_for_ip(interface_ip);
+    ifindex_  = ifname_.empty() ? 0 : (int)::if_nametoindex(ifname_.c_str());
+    if (ifindex_ == 0) {
+        std::cerr << "WARN: no interface with address " << interface_ip << " for raw receive\n";
+    }
+    return true;
+}
+
+bool PacketRingReceiver::open(const std::string& mcast_ip,
+                              uint16_t mcast_port,
+                              const std::string& interface_ip,
+                              const std::string& source_ip) {
+    if (!open_joined(mcast_ip, mcast_port, interface_ip, source_ip)) return false;
+
+    if (ifindex_ == 0 || !setup_ring()) {
+        std::cerr << "WARN: packet_ring setup failed (errno=" << errno << "), using recvmmsg\n";
+        close_ring();
+    }
+    return true;
+}
+
+bool PacketRingReceiver::setup_ring() {
+    if (block_size_ < RING_FRAME_SIZE || (block_size_ & (block_size_ - 1)) || block_nr_ == 0) {
+        std::cerr << "ERROR: ring_block_size must be a power of two >= " << RING_FRAME_SIZE << "\n";
+        errno = EINVAL;
+        return false;
+    }
+
+    // Protocol 0: nothing is queued until the filter is attached and we bind.
+    pkt_fd_ = ::socket(AF_PACKET, SOCK_RAW | SOCK_CLOEXEC, 0);
+    if (pkt_fd_ < 0) return false;
+
+    // Classic BPF: IPv4/UDP, not a fragment, dst == group:port and, for
+    // SSM, src == source (the raw socket sees every sender, the muted UDP
+    // socket's source filter does not apply). Loads are network order, so
+    // compare against host-order constants.
+    const sock_filter source_test = source_be_
+        ? sock_filter BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ntohl(source_be_), 0, 4)
+        : sock_filter BPF_JUMP(BPF_JMP | BPF_JA  | BPF_K, 0, 0, 0);   // ASM: any source
+    sock_filter code[] = {
+        BPF_STMT(BPF_LD  | BPF_H   | BPF_ABS, 12),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,   ETH_P_IP, 0, 12),
+        BPF_STMT(BPF_LD  | BPF_B   | BPF_ABS, 23),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,   IPPROTO_UDP, 0, 10),
+        BPF_STMT(BPF_LD  | BPF_H   | BPF_ABS, 20),
+        BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K,  0x3FFF, 8, 0),
+        BPF_STMT(BPF_LD  | BPF_W   | BPF_ABS, 30),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,   ntohl(group_be_), 0, 6),
+        BPF_STMT(BPF_LD  | BPF_W   | BPF_ABS, 26),
+        source_test,
+        BPF_STMT(BPF_LDX | BPF_B   | BPF_MSH, 14),              // X = IP header length
+        BPF_STMT(BPF_LD  | BPF_H   | BPF_IND, 16),              // 14 + ihl + 2
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,   ntohs(port_be_), 0, 1),
+        BPF_STMT(BPF_RET | BPF_K,             0x40000),
+        BPF_STMT(BPF_RET | BPF_K,             0),
+    };
+    sock_fprog fprog{(unsigned short)(sizeof(code) / sizeof(code[0])), code};
+    if (::setsockopt(pkt_fd_, SOL_SOCKET, SO_ATTACH_FILTER, &fprog, sizeof(fprog)) != 0) return false;
+
+    int ver = TPACKET_V3;
+    if (::setsockopt(pkt_fd_, SOL_PACKET, PACKET_VERSION, &ver, sizeof(ver)) != 0) return false;
+
+    tpacket_req3 req{};
+    req.tp_block_size = block_size_;
+    req.tp_block_nr   = block_nr_;
+    req.tp_frame_size = RING_FRAME_SIZE;
+    req.tp_frame_nr   = (block_size_ / RING_FRAME_SIZE) * block_nr_;
+    req.tp_retire_blk_tov = block_tov_ms_;
+    if (::setsockopt(pkt_fd_, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) != 0) return false;
+
+    ring_len_ = (size_t)block_size_ * block_nr_;
+    void* p = ::mmap(nullptr, ring_len_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, pkt_fd_, 0);
+    if (p == MAP_FAILED) {
+        ring_ = nullptr;
+        return false;
+    }
+    ring_ = static_cast<uint8_t*>(p);
+
+    sockaddr_ll sll{};
+    sll.sll_family   = AF_PACKET;
+    sll.sll_protocol = htons(ETH_P_IP);
+    sll.sll_ifindex  = ifindex_;
+    if (::bind(pkt_fd_, (sockaddr*)&sll, sizeof(sll)) != 0) return false;
+
+    mute_udp_socket();
+    done_.reserve(block_nr_);
+    std::cerr << "INFO: packet_ring receive backend active on " << ifname_
+              << " (" << block_nr_ << " x " << block_size_ << " byte blocks)\n";
+    return true;
+}
+
+void PacketRingReceiver::finish_block() {
+    if (cur_handed_) {
+        done_.push_back(cur_block_);
+    } else {
+        // nothing from this block reached the caller
+        auto* bd = reinterpret_cast<tpacket_block_desc*>(ring_ + (size_t)cur_block_ * block_size_);
+        __atomic_store_n(&bd->hdr.bh1.block_status, (uint32_t)TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+    }
+    cur_block_ = (cur_block_ + 1) % block_nr_;
+    cur_handed_ = false;
+}
+
+int PacketRingReceiver::recv_packets(RxPacket* out, int max) {
+    if (!ring_) return UdpMcastReceiver::recv_packets(out, max);
+
+    int n = 0;
+    while (n == 0) {
+        if (pkts_left_ == 0) {
+            uint8_t* blk = ring_ + (size_t)cur_block_ * block_size_;
+            if (!(block_status(blk) & TP_STATUS_USER)) {
+                pollfd pfd{pkt_fd_, POLLIN | POLLERR, 0};
+                ::poll(&pfd, 1, timeout_ms_ > 0 ? timeout_ms_ : -1);
+                if (!(block_status(blk) & TP_STATUS_USER)) return -1;
+            }
+            auto* bd = reinterpret_cast<tpacket_block_desc*>(blk);
+            pkts_left_ = bd->hdr.bh1.num_pkts;
+            next_pkt_  = blk + bd->hdr.bh1.offset_to_first_pkt;
+            if (pkts_left_ == 0) {       // empty block retired by timeout
+                finish_block();
+                continue;
+            }
+        }
+
+        while (pkts_left_ > 0 && n < max) {
+            auto* h = reinterpret_cast<const tpacket3_hdr*>(next_pkt_);
+            const uint8_t* payload = nullptr;
+            uint32_t plen = 0;
+            // the filter already matched; this re-checks lengths and VLAN tags
+            if (parse_udp_frame(next_pkt_ + h->tp_mac, h->tp_snaplen, group_be_, port_be_, &payload, &plen)) {
+                out[n].data = payload;
+                out[n].len  = plen;
+                ++n;
+                cur_handed_ = true;
+            }
+            next_pkt_ += h->tp_next_offset;
+            --pkts_left_;
+        }
+        if (pkts_left_ == 0) finish_block();
+    }
+    return n;
+}
+
+void PacketRingReceiver::release() {
+    for (uint32_t b : done_) {
+        auto* bd = reinterpret_cast<tpacket_block_desc*>(ring_ + (size_t)b * block_size_);
+        __atomic_store_n(&bd->hdr.bh1.block_status, (uint32_t)TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+    }
+    done_.clear();
+}
+
+uint64_t PacketRingReceiver::local_drops() {
+    if (pkt_fd_ < 0) return UdpMcastReceiver::local_drops();   // recvmmsg fallback
+
+    // tp_drops counts frames the ring had no room for; reading clears it
+    tpacket_stats_v3 st{};
+    socklen_t len = sizeof(st);
+    if (::getsockopt(pkt_fd_, SOL_PACKET, PACKET_STATISTICS, &st, &len) == 0) ring_drops_ += st.tp_drops;
+    return ring_drops_;
+}
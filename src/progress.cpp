@@ -0,0 +1,129 @@
+#include "progress.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static ProgressRecord* g_rec = nullptr;
+static size_t g_map_bytes = 0;
+
+static bool     g_have_last = false;
+static char     g_last_session[10];
+static uint64_t g_last_expected = 0;
+static std::vector<ProgressGap> g_last_gaps;
+
+bool progress_open(const std::string& path) {
+    progress_close();
+    g_have_last = false;
+    g_last_gaps.clear();
+
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        std::cerr << "WARN: progress file " << path << " open failed errno=" << errno << "\n";
+        return false;
+    }
+    const size_t bytes = (size_t)::sysconf(_SC_PAGESIZE);
+    struct stat st{};
+    const bool sized = ::fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(ProgressRecord);
+    if (!sized && ::ftruncate(fd, (off_t)bytes) != 0) {
+        std::cerr << "WARN: progress file " << path << " resize failed errno=" << errno << "\n";
+        ::close(fd);
+        return false;
+    }
+    void* p = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) {
+        std::cerr << "WARN: progress file " << path << " mmap failed errno=" << errno << "\n";
+        return false;
+    }
+    g_rec = static_cast<ProgressRecord*>(p);
+    g_map_bytes = bytes;
+
+    if (sized && g_rec->magic == PROGRESS_MAGIC && g_rec->version == PROGRESS_VERSION) {
+        if (g_rec->gen.load(std::memory_order_acquire) & 1) {
+            std::cerr << "WARN: progress file " << path << " was being updated when the last run stopped; ignored\n";
+        } else if (g_rec->expected_seq) {
+            std::memcpy(g_last_session, g_rec->session, 10);
+            g_last_expected = g_rec->expected_seq;
+            const uint64_t n = std::min<uint64_t>(g_rec->ngaps, PROGRESS_MAX_GAPS);
+            g_last_gaps.assign(g_rec->gaps, g_rec->gaps + n);
+            g_have_last = true;
+        }
+    }
+
+    if (!g_have_last) {   // nothing usable: start from an empty record
+        std::memset(g_rec->session, 0, sizeof(g_rec->session));
+        g_rec->expected_seq = 0;
+        g_rec->ngaps = 0;
+    }
+    g_rec->magic = PROGRESS_MAGIC;
+    g_rec->version = PROGRESS_VERSION;
+    g_rec->gen.store(0, std::memory_order_relaxed);
+    return true;
+}
+
+bool progress_last(char session10[10], uint64_t& expected_seq, std::vector<ProgressGap>& gaps) {
+    if (!g_have_last) return false;
+    std::memcpy(session10, g_last_session, 10);
+    expected_seq = g_last_expected;
+    gaps = g_last_gaps;
+    return true;
+}
+
+// Writers bracket every change with begin() / end() (odd gen while open).
+static uint64_t begin() {
+    const uint64_t g = g_rec->gen.load(std::memory_order_relaxed);
+    g_rec->gen.store(g + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    return g;
+}
+
+static void end(uint64_t g) {
+    g_rec->gen.store(g + 2, std::memory_order_release);
+}
+
+void progress_update(const char session10[10], uint64_t expected_seq) {
+    if (!g_rec || !session10) return;
+    const bool same = std::memcmp(g_rec->session, session10, 10) == 0;
+    if (same && g_rec->expected_seq == expected_seq) return;
+
+    const uint64_t g = begin();
+    if (!same) {
+        std::memcpy(g_rec->session, session10, 10);
+        g_rec->ngaps = 0;
+    }
+    g_rec->expected_seq = expected_seq;
+    end(g);
+}
+
+void progress_add_gap(uint64_t seq, uint64_t count) {
+    if (!g_rec || count == 0) return;
+    const uint64_t g = begin();
+    if (g_rec->ngaps >= (uint64_t)PROGRESS_MAX_GAPS) {
+        std::memmove(g_rec->gaps, g_rec->gaps + 1, sizeof(ProgressGap) * (PROGRESS_MAX_GAPS - 1));
+        g_rec->ngaps = PROGRESS_MAX_GAPS - 1;
+    }
+    g_rec->gaps[g_rec->ngaps] = ProgressGap{seq, count};
+    ++g_rec->ngaps;
+    end(g);
+}
+
+void progress_clear_gaps() {
+    if (!g_rec || g_rec->ngaps == 0) return;
+    const uint64_t g = begin();
+    g_rec->ngaps = 0;
+    end(g);
+}
+
+void progress_close() {
+    if (!g_rec) return;
+    ::msync(g_rec, g_map_bytes, MS_SYNC);
+    ::munmap(g_rec, g_map_bytes);
+    g_rec = nullptr;
+    g_map_bytes = 0;
+}
@@ -1,14 +1,21 @@
 #include "recovery.h"
 #include "decoder.h"
 #include "config.h"
+#include "output.h"
+#include "state.h"
+#include "arena.h"
+#include "logger.h"
+#include "metrics.h"
+#include <algorithm>
 #include <cstring>
 #include <cerrno>
 #include <endian.h>
+#include <poll.h>
+#include <time.h>
 #include <unistd.h>
 #include <arpa/inet.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
-#include <iostream>
 
 #pragma pack(push, 1)
 struct RereqPkt {
@@ -26,104 +33,581 @@ struct MoldHeaderRaw {
 };
 #pragma pack(pop)
 
+static constexpr size_t RXBUF_BYTES = 65536;
+static constexpr size_t MAX_SPLIT = 8;    // endpoints used at once by one split round
+static constexpr size_t MAX_LANES = 32;   // ranges in flight at once (bulk download)
+
 static inline uint16_t be16(const uint8_t* p) {
     return (uint16_t(p[0]) << 8) | uint16_t(p[1]);
 }
 
-Rerequester::Rerequester() : fd_(-1), ip_be_(0), port_be_(0) {}
+static inline uint64_t be64(const uint8_t* p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; ++i) v = (v << 8) | p[i];
+    return v;
+}
+
+static uint64_t mono_ns() {
+    struct timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static timespec to_timespec(uint64_t ns) {
+    return timespec{(time_t)(ns / 1000000000ULL), (long)(ns % 1000000000ULL)};
+}
+
+// Counters of a Rerequester nobody gave a metrics block to; not exported.
+static ThreadMetrics g_unexported;
+
+Rerequester::Rerequester()
+    : mt_(&g_unexported), cur_(0), rcvbuf_bytes_(0), min_timeout_ns_(1000000), max_timeout_ns_(500000000), rxbuf_(nullptr),
+      reorder_(nullptr), reorder_bytes_(0), tokens_(0), refill_ns_(0) {}
 Rerequester::~Rerequester() { close(); }
 
-bool Rerequester::open(const char* ip, uint16_t port, int rcvbuf_bytes, int timeout_ms) {
+void Rerequester::set_metrics(ThreadMetrics& mt) { mt_ = &mt; }
+
+bool Rerequester::open(const char* ip, uint16_t port, int rcvbuf_bytes) {
     close();
 
-    fd_ = ::socket(AF_INET, SOCK_DGRAM, 0);
-    if (fd_ < 0) return false;
+    const RecoverySettings& rs = config().recovery;
+    rcvbuf_bytes_ = rcvbuf_bytes;
+    max_timeout_ns_ = (uint64_t)std::max<uint32_t>(rs.timeout_ms, 1) * 1000000ULL;
+    min_timeout_ns_ = std::min<uint64_t>((uint64_t)rs.min_timeout_us * 1000ULL, max_timeout_ns_);
 
-    ::setsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &rcvbuf_bytes, sizeof(rcvbuf_bytes));
+    rxbuf_ = static_cast<uint8_t*>(arena_alloc(RXBUF_BYTES));
+    if (!rxbuf_) return false;
 
-    timeval tv{};
-    tv.tv_sec  = timeout_ms / 1000;
-    tv.tv_usec = (timeout_ms % 1000) * 1000;
-    ::setsockopt(fd_, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    if (rs.reorder_bytes) {
+        reorder_bytes_ = rs.reorder_bytes;
+        reorder_ = static_cast<uint8_t*>(arena_alloc(reorder_bytes_));
+        if (!reorder_) reorder_bytes_ = 0;   // no split, answers ahead of sequence are asked for again
+    }
+    tokens_ = std::max<uint32_t>(rs.request_burst, 1);
+    refill_ns_ = mono_ns();
 
-    ip_be_ = ::inet_addr(ip);
-    port_be_ = htons(port);
+    return add_endpoint(ip, port);
+}
 
-    return (ip_be_ != INADDR_NONE && port != 0);
+bool Rerequester::add_endpoint(const char* ip, uint16_t port) {
+    Endpoint ep;
+    ep.ip_be = ::inet_addr(ip);
+    ep.port_be = htons(port);
+    if (ep.ip_be == INADDR_NONE || port == 0) return false;
+
+    // one socket per endpoint, so answers of a split recovery stay apart
+    ep.fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (ep.fd < 0) return false;
+
+    ::setsockopt(ep.fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf_bytes_, sizeof(rcvbuf_bytes_));
+
+    eps_.push_back(ep);
+    return true;
 }
 
 void Rerequester::close() {
-    if (fd_ >= 0) {
-        ::close(fd_);
-        fd_ = -1;
+    for (Endpoint& ep : eps_) {
+        if (ep.fd >= 0) ::close(ep.fd);
     }
+    eps_.clear();
+    cur_ = 0;
+    arena_free(rxbuf_, RXBUF_BYTES);
+    rxbuf_ = nullptr;
+    arena_free(reorder_, reorder_bytes_);
+    reorder_ = nullptr;
+    reorder_bytes_ = 0;
 }
 
-uint64_t Rerequester::recover(const char session10[10],
-                              uint64_t start_seq,
-                              uint64_t count,
-                              const DecodeOptions& opt) {
-    if (fd_ < 0 || count == 0) return 0;
+// Token bucket shared by all endpoints; sleeps until a request may go out.
+void Rerequester::take_token() {
+    const RecoverySettings& rs = config().recovery;
+    if (rs.request_rate <= 0) return;
+
+    const double burst = std::max<uint32_t>(rs.request_burst, 1);
+    uint64_t now = mono_ns();
+    tokens_ = std::min(burst, tokens_ + (double)(now - refill_ns_) * rs.request_rate / 1e9);
+    refill_ns_ = now;
+
+    if (tokens_ < 1.0) {
+        const timespec ts = to_timespec((uint64_t)((1.0 - tokens_) / rs.request_rate * 1e9));
+        ::nanosleep(&ts, nullptr);
+        now = mono_ns();
+        tokens_ += (double)(now - refill_ns_) * rs.request_rate / 1e9;
+        refill_ns_ = now;
+    }
+    tokens_ -= 1.0;
+}
+
+// Wait for the first answer: SRTT + 4 RTTVAR (RFC 6298), or timeout_ms
+// while the endpoint has not answered yet.
+uint64_t Rerequester::rto_ns(const Endpoint& ep) const {
+    if (!ep.srtt_ns) return max_timeout_ns_;
+    return std::min(std::max(ep.srtt_ns + 4 * ep.rttvar_ns, min_timeout_ns_), max_timeout_ns_);
+}
+
+// Wait for the next packet of an answer already flowing.
+uint64_t Rerequester::idle_ns(const Endpoint& ep) const {
+    if (!ep.ipg_ns) return rto_ns(ep);
+    return std::min(std::max(8 * ep.ipg_ns, min_timeout_ns_), rto_ns(ep));
+}
+
+static void rtt_sample(uint64_t& srtt, uint64_t& rttvar, uint64_t ns) {
+    if (!srtt) {
+        srtt = ns;
+        rttvar = ns / 2;
+        return;
+    }
+    const uint64_t err = srtt > ns ? srtt - ns : ns - srtt;
+    rttvar = (3 * rttvar + err) / 4;
+    srtt = (7 * srtt + ns) / 8;
+}
+
+size_t Rerequester::endpoints_up() const {
+    const uint64_t now = mono_ns();
+    size_t n = 0;
+    for (const Endpoint& ep : eps_) {
+        if (ep.down_until_ns <= now) ++n;
+    }
+    return n;
+}
+
+void Rerequester::mark_down(size_t idx, uint64_t seq, uint64_t count) {
+    Endpoint& ep = eps_[idx];
+    ++ep.failures;
+    ep.down_until_ns = mono_ns() + (uint64_t)config().recovery.endpoint_retry_ms * 1000000ULL;
+    if (eps_.size() > 1) log_event(LOG_RECOVERY_FAILOVER, idx, seq, count);
+}
+
+bool Rerequester::send_request(int fd, size_t idx, const char session10[10], uint64_t seq, uint16_t count) {
+    Endpoint& ep = eps_[idx];
 
     sockaddr_in dst{};
     dst.sin_family = AF_INET;
-    dst.sin_addr.s_addr = ip_be_;
-    dst.sin_port = port_be_;
+    dst.sin_addr.s_addr = ep.ip_be;
+    dst.sin_port = ep.port_be;
 
-    // Output buffer: one write per recovered packet
-    alignas(64) static char outbuf[256 * 1024];
-    alignas(64) static uint8_t rxbuf[65536];
+    RereqPkt pkt{};
+    std::memset(pkt.session, ' ', sizeof(pkt.session));
+    std::memcpy(pkt.session, session10, 10);
+    pkt.seq_be   = htobe64(seq);
+    pkt.count_be = htobe16(count);
 
-    uint64_t recovered = 0;
-    uint64_t cur_seq = start_seq;
-    uint64_t remaining = count;
+    take_token();
+    if (::sendto(fd, &pkt, sizeof(pkt), 0, (sockaddr*)&dst, sizeof(dst)) < 0) {
+        log_event(LOG_RECOVERY_SEND_FAILED, (uint64_t)errno);
+        return false;
+    }
+    log_event(LOG_RECOVERY_REQUEST, seq, count);
+    return true;
+}
 
-    const uint16_t MAX_PER_REQ = config().recovery.max_recovery_message_count; 
+// Answers that arrived ahead of sequence, held until the ones before them
+// are in. Packets are appended to the region; it is reused once empty.
+struct RereqStash {
+    static constexpr size_t MAX = 64;
+    struct Entry {
+        uint64_t seq;
+        uint64_t off;
+        uint16_t len, cnt;
+    };
 
-    while (remaining > 0) {
-        uint16_t req = (remaining > MAX_PER_REQ) ? MAX_PER_REQ : (uint16_t)remaining;
+    uint8_t* buf = nullptr;
+    uint64_t cap = 0, used = 0;
+    Entry    ent[MAX];
+    size_t   n = 0;
 
-        RereqPkt pkt{};
-        std::memset(pkt.session, ' ', sizeof(pkt.session));
-        std::memcpy(pkt.session, session10, 10);
-        pkt.seq_be   = htobe64(cur_seq);
-        pkt.count_be = htobe16(req);
+    bool has(uint64_t seq) const {
+        for (size_t i = 0; i < n; ++i) {
+            if (ent[i].seq == seq) return true;
+        }
+        return false;
+    }
 
-        if (::sendto(fd_, &pkt, sizeof(pkt), 0, (sockaddr*)&dst, sizeof(dst)) < 0) {
-            std::cerr << "RECOVERY sendto failed errno=" << errno << "\n";
-            break;
+    // false if full: the packet comes again with the next resend
+    bool put(uint64_t seq, uint16_t cnt, const uint8_t* pkt, size_t len) {
+        if (n == MAX || used + len > cap) return false;
+        std::memcpy(buf + used, pkt, len);
+        ent[n++] = Entry{seq, used, (uint16_t)len, cnt};
+        used += len;
+        return true;
+    }
+
+    // Packet holding `seq`, removed from the stash (with any that end before
+    // it); valid until the next put().
+    uint8_t* take(uint64_t seq, size_t& len) {
+        for (size_t i = 0; i < n;) {
+            if (ent[i].seq + ent[i].cnt <= seq) {   // superseded by what was taken
+                ent[i] = ent[--n];
+                continue;
+            }
+            if (ent[i].seq > seq) {
+                ++i;
+                continue;
+            }
+            uint8_t* p = buf + ent[i].off;
+            len = ent[i].len;
+            ent[i] = ent[--n];
+            if (n == 0) used = 0;
+            return p;
         }
+        if (n == 0) used = 0;
+        return nullptr;
+    }
 
-        std::cerr << "RECOVERY request start=" << cur_seq << " count=" << req << "\n";
+    // First stashed sequence after `seq`, or `end`: the outstanding part.
+    uint64_t first_after(uint64_t seq, uint64_t end) const {
+        uint64_t first = end;
+        for (size_t i = 0; i < n; ++i) {
+            if (ent[i].seq > seq && ent[i].seq < first) first = ent[i].seq;
+        }
+        return first;
+    }
+};
 
-        uint64_t got = 0;
-        int timeouts = 0;
+// One requested range [seq, end) on one endpoint, read from socket `fd`.
+struct RereqRange {
+    size_t   ep;
+    int      fd;
+    uint64_t seq, end, next;       // next: first sequence not taken yet
+    bool     direct;               // decode as it arrives, else hold in buf
+    uint8_t* buf;                  // in-sequence packets, length-prefixed
+    uint64_t cap, len;
+    RereqStash stash;
+    uint64_t sent_ns, last_ns, deadline_ns;
+    uint32_t timeouts, backoff;
+    bool     done, full, answered, resent;
 
-        while (got < req) {
-            int n = (int)::recvfrom(fd_, rxbuf, sizeof(rxbuf), 0, nullptr, nullptr);
-            if (n <= 0) {
-                if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                    if (++timeouts >= 3) break; // QA: 3 timeouts then stop this request
-                    continue;
-                }
-                std::cerr << "RECOVERY recvfrom failed errno=" << errno << "\n";
-                break;
-            }
+    void init(size_t idx, int sock, uint64_t from, uint64_t to, uint8_t* region, uint64_t bytes, bool decode) {
+        ep = idx;
+        fd = sock;
+        seq = next = from;
+        end = to;
+        direct = decode;
+        // a held range keeps 3/4 of its region for in-sequence packets
+        const uint64_t held = decode ? 0 : bytes / 4 * 3;
+        buf = region;
+        cap = held;
+        len = 0;
+        stash = RereqStash();
+        stash.buf = region ? region + held : nullptr;
+        stash.cap = region ? bytes - held : 0;
+        sent_ns = last_ns = deadline_ns = 0;
+        timeouts = 0;
+        backoff = 1;
+        done = full = answered = resent = false;
+    }
+};
+
+// Trim a validated packet to its messages in [from, to), rewriting the
+// header in place in front of the first one kept. Returns the trimmed
+// packet and its length, or nullptr if no message is in range.
+static uint8_t* clip_packet(uint8_t* pkt, size_t& len, uint64_t from, uint64_t to) {
+    const uint64_t s = be64(pkt + 10);
+    const uint16_t c = be16(pkt + 18);
+    size_t off = sizeof(MoldHeaderRaw);
+    uint16_t i = 0;
+    for (; i < c && s + i < from; ++i) off += 2 + be16(pkt + off);
+    const size_t first = off;
+    const uint16_t skipped = i;
+    uint16_t kept = 0;
+    for (; i < c && s + i < to; ++i, ++kept) off += 2 + be16(pkt + off);
+    if (kept == 0) return nullptr;
+    if (kept == c) return pkt;
 
-            // decode recovered packet and print
-            size_t outn = decode_moldudp64_packet_to_buffer(rxbuf, (size_t)n, opt, outbuf, sizeof(outbuf));
-            if (outn) (void)!::write(1, outbuf, outn);
+    uint8_t* out = pkt + first - sizeof(MoldHeaderRaw);
+    std::memmove(out, pkt, 10);
+    const uint64_t seq_be = htobe64(s + skipped);
+    const uint16_t cnt_be = htobe16(kept);
+    std::memcpy(out + 10, &seq_be, 8);
+    std::memcpy(out + 18, &cnt_be, 2);
+    len = off - (first - sizeof(MoldHeaderRaw));
+    return out;
+}
+
+// A recovered packet in sequence: into the state cache and out.
+static void deliver(const uint8_t* pkt, size_t len, const DecodeOptions& opt) {
+    state_apply(pkt, len);
+    output_packet(pkt, len, opt);
+}
 
-            // count recovered messages (from Mold header)
-            if ((size_t)n >= sizeof(MoldHeaderRaw)) {
-                auto* h = reinterpret_cast<const MoldHeaderRaw*>(rxbuf);
-                uint16_t mc = be16(reinterpret_cast<const uint8_t*>(&h->message_count_be));
-                got += mc;
+// The next packet of `r` in sequence: decode or hold it.
+bool Rerequester::take(RereqRange& r, const uint8_t* pkt, size_t len, const DecodeOptions& opt) {
+    if (r.direct) {
+        deliver(pkt, len, opt);
+    } else if (r.len + 2 + len <= r.cap) {
+        const uint16_t l = (uint16_t)len;
+        std::memcpy(r.buf + r.len, &l, 2);
+        std::memcpy(r.buf + r.len + 2, pkt, len);
+        r.len += 2 + len;
+    } else {
+        r.full = r.done = true;   // buffer full: the rest is requested again later
+        return false;
+    }
+    r.next = be64(pkt + 10) + be16(pkt + 18);
+    return true;
+}
+
+// Decode what `r` holds (a held range whose predecessors are complete).
+static void emit_held(const RereqRange& r, const DecodeOptions& opt) {
+    for (uint64_t off = 0; !r.direct && off < r.len;) {
+        uint16_t len;
+        std::memcpy(&len, r.buf + off, 2);
+        deliver(r.buf + off + 2, len, opt);
+        off += 2 + (uint64_t)len;
+    }
+}
+
+void Rerequester::start(RereqRange& r, const char session10[10]) {
+    // late answers to an earlier request must not count for this one
+    while (::recv(r.fd, rxbuf_, RXBUF_BYTES, MSG_DONTWAIT) > 0) {}
+    if (!send_request(r.fd, r.ep, session10, r.seq, (uint16_t)(r.end - r.seq))) r.done = true;
+    r.sent_ns = mono_ns();
+    r.deadline_ns = r.sent_ns + rto_ns(eps_[r.ep]);
+}
+
+// Deadline passed without an answer: ask again for what is still
+// outstanding only, or give up after `retries`.
+void Rerequester::expire(RereqRange& r, const char session10[10]) {
+    if (++r.timeouts > config().recovery.retries) {
+        r.done = true;
+        return;
+    }
+    const uint64_t upto = r.stash.first_after(r.next, r.end);
+    metrics_add(mt_->rerequest_retransmits, 1);
+    r.backoff = std::min<uint32_t>(r.backoff * 2, 64);
+    if (!send_request(r.fd, r.ep, session10, r.next, (uint16_t)(upto - r.next))) {
+        r.done = true;
+        return;
+    }
+    r.sent_ns = mono_ns();
+    r.deadline_ns = r.sent_ns + std::min(rto_ns(eps_[r.ep]) * r.backoff, max_timeout_ns_);
+    r.answered = false;
+    r.resent = true;
+}
+
+// Read everything queued on r.fd: validate, then take in sequence or stash.
+void Rerequester::receive(RereqRange& r, const char session10[10], const DecodeOptions& opt) {
+    ThreadMetrics& mt = *mt_;
+    Endpoint& ep = eps_[r.ep];
+
+    sockaddr_in src{};
+    socklen_t slen = sizeof(src);
+    ssize_t n;
+    while (!r.done && (n = ::recvfrom(r.fd, rxbuf_, RXBUF_BYTES, MSG_DONTWAIT, (sockaddr*)&src, &slen)) > 0) {
+        slen = sizeof(src);
+        if (src.sin_addr.s_addr != ep.ip_be || src.sin_port != ep.port_be) {
+            metrics_add(mt.rerequest_rejected, 1);
+            continue;
+        }
+
+        if ((size_t)n < sizeof(MoldHeaderRaw) || std::memcmp(rxbuf_, session10, 10) != 0) {
+            metrics_add(mt.rerequest_rejected, 1);
+            continue;
+        }
+        const uint64_t s = be64(rxbuf_ + 10);
+        const uint16_t c = be16(rxbuf_ + 18);
+        if (c == 0 || c == 0xFFFF) continue;
+        if (s + c <= r.next || s >= r.end) continue;   // duplicate, or not this range
+        if (!validate_moldudp64_packet(rxbuf_, (size_t)n)) {
+            metrics_add(mt.rerequest_rejected, 1);
+            continue;
+        }
+
+        // only an answer to this range times the endpoint and holds off the timeout
+        const uint64_t now = mono_ns();
+        if (!r.answered) {
+            r.answered = true;
+            if (!r.resent) {   // Karn: an answer to a resent request is ambiguous
+                rtt_sample(ep.srtt_ns, ep.rttvar_ns, now - r.sent_ns);
+                metrics_observe(mt.rerequest_rtt_ns, now - r.sent_ns);
             }
+        } else {
+            const uint64_t gap = now - r.last_ns;
+            ep.ipg_ns = ep.ipg_ns ? (7 * ep.ipg_ns + gap) / 8 : gap;
+        }
+        r.last_ns = now;
+        r.deadline_ns = now + std::min(idle_ns(ep) * r.backoff, max_timeout_ns_);
+
+        // only the messages still wanted: none before r.next (already out),
+        // none from r.end (the next range's)
+        size_t len = (size_t)n;
+        const uint8_t* pkt = clip_packet(rxbuf_, len, r.next, r.end);
+        const uint64_t from = be64(pkt + 10);
+        if (from > r.next) {
+            if (!r.stash.has(from)) r.stash.put(from, be16(pkt + 18), pkt, len);
+            continue;
+        }
+        if (!take(r, pkt, len, opt)) break;
+
+        uint8_t* held;
+        size_t hlen;
+        while (!r.done && (held = r.stash.take(r.next, hlen)) != nullptr) {
+            held = clip_packet(held, hlen, r.next, r.end);
+            take(r, held, hlen, opt);
+        }
+
+        r.timeouts = 0;
+        r.backoff = 1;
+        if (r.next >= r.end) r.done = true;
+    }
+}
+
+// Wait for the earliest deadline among the active ranges, then receive or
+// expire each. False if poll failed.
+bool Rerequester::pump(RereqRange* const* active, size_t m, const char session10[10], const DecodeOptions& opt) {
+    pollfd pfd[MAX_LANES];
+    uint64_t deadline = UINT64_MAX;
+    for (size_t i = 0; i < m; ++i) {
+        pfd[i] = pollfd{active[i]->fd, POLLIN, 0};
+        deadline = std::min(deadline, active[i]->deadline_ns);
+    }
+
+    const uint64_t now = mono_ns();
+    const timespec ts = to_timespec(deadline > now ? deadline - now : 0);
+    if (::ppoll(pfd, m, &ts, nullptr) < 0) {
+        log_event(LOG_RECOVERY_RECV_FAILED, (uint64_t)errno);
+        return false;
+    }
+
+    for (size_t i = 0; i < m; ++i) {
+        RereqRange& r = *active[i];
+        if (pfd[i].revents & POLLIN) receive(r, session10, opt);
+        // packets that were all rejected do not hold the timeout off
+        if (!r.done && mono_ns() >= r.deadline_ns) expire(r, session10);
+    }
+    return true;
+}
+
+// Send every range's request, then read answers until each range is
+// complete or out of retries. Returns the messages recovered contiguously
+// from ranges[0].seq; held ranges after the first incomplete one are dropped.
+uint64_t Rerequester::fetch(RereqRange* ranges, size_t k, const char session10[10], const DecodeOptions& opt) {
+    for (size_t i = 0; i < k; ++i) start(ranges[i], session10);
+
+    RereqRange* active[MAX_LANES];
+    for (;;) {
+        size_t m = 0;
+        for (size_t i = 0; i < k; ++i) {
+            if (!ranges[i].done) active[m++] = &ranges[i];
+        }
+        if (m == 0 || !pump(active, m, session10, opt)) break;
+    }
+
+    // Hand on what is contiguous from the first range.
+    uint64_t got = 0;
+    for (size_t i = 0; i < k; ++i) {
+        const RereqRange& r = ranges[i];
+        emit_held(r, opt);
+        got += r.next - r.seq;
+        if (r.next < r.end) break;
+    }
+    output_batch_end();
+    return got;
+}
+
+// One request to one endpoint, decoded as it arrives.
+uint64_t Rerequester::request(size_t idx, const char session10[10], uint64_t seq, uint16_t req,
+                              const DecodeOptions& opt) {
+    RereqRange r;
+    r.init(idx, eps_[idx].fd, seq, seq + req, reorder_, reorder_bytes_, true);
+    return fetch(&r, 1, session10, opt);
+}
+
+// Endpoint in use first, then the others in order; resting endpoints only
+// when none is up.
+uint64_t Rerequester::recover_one(const char session10[10], uint64_t seq, uint16_t req,
+                                  const DecodeOptions& opt) {
+    const size_t n = eps_.size();
+    const uint64_t now = mono_ns();
+    bool tried = false;
+
+    for (size_t i = 0; i < n; ++i) {
+        const size_t idx = (cur_ + i) % n;
+        if (eps_[idx].down_until_ns > now) continue;
+        tried = true;
+
+        uint64_t got = request(idx, session10, seq, req, opt);
+        if (got) {
+            eps_[idx].failures = 0;
+            cur_ = idx;
+            return got;
+        }
+        mark_down(idx, seq, req);
+    }
+    if (!tried) {
+        uint64_t got = request(cur_, session10, seq, req, opt);
+        if (got) {
+            eps_[cur_].failures = 0;
+            eps_[cur_].down_until_ns = 0;
+            return got;
+        }
+        mark_down(cur_, seq, req);
+    }
+    return 0;
+}
+
+// One request per healthy endpoint, for consecutive ranges. The first range
+// is decoded as it arrives; the others are held until every range before
+// them is complete. Returns the messages recovered contiguously from `seq`.
+uint64_t Rerequester::recover_split(const char session10[10], uint64_t seq, uint64_t count,
+                                    const DecodeOptions& opt) {
+    const uint16_t MAX_PER_REQ = config().recovery.max_recovery_message_count;
+    const uint64_t now = mono_ns();
+
+    size_t idx[MAX_SPLIT];
+    size_t k = 0;
+    for (size_t i = 0; i < eps_.size() && k < MAX_SPLIT; ++i) {
+        const size_t e = (cur_ + i) % eps_.size();
+        if (eps_[e].down_until_ns > now) continue;
+        if ((uint64_t)k * MAX_PER_REQ >= count) break;
+        idx[k++] = e;
+    }
+    if (k < 2) return recover_one(session10, seq, (uint16_t)std::min<uint64_t>(count, MAX_PER_REQ), opt);
+
+    RereqRange ranges[MAX_SPLIT];
+    const uint64_t slot = reorder_bytes_ / k;
+    for (size_t i = 0; i < k; ++i) {
+        const uint64_t at = seq + (uint64_t)i * MAX_PER_REQ;
+        ranges[i].init(idx[i], eps_[idx[i]].fd, at, std::min(at + MAX_PER_REQ, seq + count),
+                       reorder_ + i * slot, slot, i == 0);
+    }
+
+    log_event(LOG_RECOVERY_SPLIT, seq, ranges[k - 1].end - seq, k);
+    const uint64_t got = fetch(ranges, k, session10, opt);
+
+    for (size_t i = 0; i < k; ++i) {
+        const RereqRange& r = ranges[i];
+        if (r.next == r.seq && !r.full) mark_down(r.ep, r.seq, r.end - r.seq);
+        else eps_[r.ep].failures = 0;
+    }
+    return got;
+}
+
+uint64_t Rerequester::recover(const char session10[10],
+                              uint64_t start_seq,
+                              uint64_t count,
+                              const DecodeOptions& opt) {
+    if (eps_.empty() || !rxbuf_ || count == 0) return 0;
+
+    const RecoverySettings& rs = config().recovery;
+    uint64_t recovered = 0;
+    uint64_t cur_seq = start_seq;
+    uint64_t remaining = count;
+
+    const uint16_t MAX_PER_REQ = rs.max_recovery_message_count;
+
+    while (remaining > 0) {
+        uint64_t got;
+        if (reorder_ && rs.parallel_min_messages && remaining >= rs.parallel_min_messages &&
+            remaining > MAX_PER_REQ && endpoints_up() >= 2) {
+            got = recover_split(session10, cur_seq, remaining, opt);
+        } else {
+            uint16_t req = (remaining > MAX_PER_REQ) ? MAX_PER_REQ : (uint16_t)remaining;
+            got = recover_one(session10, cur_seq, req, opt);
         }
 
         if (got == 0) {
-            std::cerr << "RECOVERY stalled start=" << cur_seq << " req=" << req << "\n";
+            log_event(LOG_RECOVERY_STALLED, cur_seq, std::min<uint64_t>(remaining, MAX_PER_REQ));
             break;
         }
 
@@ -132,6 +616,145 @@ uint64_t Rerequester::recover(const char session10[10],
         remaining = (remaining > got) ? (remaining - got) : 0;
     }
 
-    std::cerr << "RECOVERY done recovered=" << recovered << "\n";
+    log_event(LOG_RECOVERY_DONE, recovered);
     return recovered;
 }
+
+uint64_t Rerequester::download(const char session10[10],
+                               uint64_t start_seq,
+                               uint64_t count,
+                               const DecodeOptions& opt) {
+    const RecoverySettings& rs = config().recovery;
+    size_t lanes = std::min<size_t>(rs.download_lanes, MAX_LANES);
+    if (lanes < 2 || eps_.empty() || !rxbuf_ || count == 0 || rs.download_segment_bytes == 0) {
+        return recover(session10, start_seq, count, opt);
+    }
+
+    // lane sockets, separate from the endpoints' own
+    int fds[MAX_LANES];
+    size_t opened = 0;
+    for (; opened < lanes; ++opened) {
+        fds[opened] = ::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        if (fds[opened] < 0) break;
+        ::setsockopt(fds[opened], SOL_SOCKET, SO_RCVBUF, &rcvbuf_bytes_, sizeof(rcvbuf_bytes_));
+    }
+    lanes = opened;
+
+    // segments: ranges in sequence order, a ring of 2 x lanes
+    const size_t window = 2 * lanes;
+    const uint64_t seg_bytes = rs.download_segment_bytes;
+    uint8_t* region = lanes >= 2 ? static_cast<uint8_t*>(arena_alloc(window * seg_bytes)) : nullptr;
+    if (!region) {
+        for (size_t l = 0; l < opened; ++l) ::close(fds[l]);
+        return recover(session10, start_seq, count, opt);
+    }
+
+    RereqRange seg[2 * MAX_LANES];
+    int  lane_of[2 * MAX_LANES];          // lane reading the segment, -1 if none
+    bool busy[MAX_LANES] = {};
+    bool refetch = false;                 // front segment came back short; re-request the rest
+    size_t first = 0, used = 0;
+    for (size_t i = 0; i < window; ++i) lane_of[i] = -1;
+
+    const uint16_t MAX_PER_REQ = rs.max_recovery_message_count;
+    const uint64_t end = start_seq + count;
+    uint64_t assign = start_seq;          // first sequence not given to a segment yet
+    uint64_t head = start_seq;            // first sequence not output yet
+    uint32_t refetches = 0;
+    size_t   next_ep = cur_;
+
+    auto pick_endpoint = [&]() -> size_t {
+        const uint64_t now = mono_ns();
+        for (size_t i = 0; i < eps_.size(); ++i) {
+            const size_t idx = (next_ep + i) % eps_.size();
+            if (eps_[idx].down_until_ns > now) continue;
+            next_ep = idx + 1;
+            return idx;
+        }
+        return cur_;   // all resting: keep trying the one in use
+    };
+
+    const uint64_t t0 = mono_ns();
+    uint64_t last_log_ns = t0;
+
+    while (head < end) {
+        // free lanes take the front segment's rest first, then new ranges
+        for (size_t l = 0; l < lanes; ++l) {
+            if (busy[l]) continue;
+            size_t slot;
+            if (refetch) {
+                slot = first;
+                RereqRange& r = seg[slot];
+                r.init(pick_endpoint(), fds[l], r.next, r.end, region + slot * seg_bytes, seg_bytes, false);
+                refetch = false;
+            } else if (used < window && assign < end) {
+                slot = (first + used++) % window;
+                seg[slot].init(pick_endpoint(), fds[l], assign, std::min(assign + MAX_PER_REQ, end),
+                               region + slot * seg_bytes, seg_bytes, false);
+                assign = seg[slot].end;
+            } else {
+                break;
+            }
+            lane_of[slot] = (int)l;
+            busy[l] = true;
+            start(seg[slot], session10);
+        }
+
+        RereqRange* active[MAX_LANES];
+        size_t m = 0;
+        for (size_t i = 0; i < used; ++i) {
+            const size_t slot = (first + i) % window;
+            if (lane_of[slot] >= 0 && !seg[slot].done) active[m++] = &seg[slot];
+        }
+        if (m && !pump(active, m, session10, opt)) break;
+
+        // finished segments give their lane back
+        for (size_t i = 0; i < used; ++i) {
+            const size_t slot = (first + i) % window;
+            RereqRange& r = seg[slot];
+            if (lane_of[slot] < 0 || !r.done) continue;
+            busy[lane_of[slot]] = false;
+            lane_of[slot] = -1;
+            if (r.next == r.seq && !r.full) mark_down(r.ep, r.seq, r.end - r.seq);
+            else eps_[r.ep].failures = 0;
+        }
+
+        // output the completed prefix
+        bool stuck = false;
+        while (used && !refetch && lane_of[first] < 0 && seg[first].done) {
+            RereqRange& r = seg[first];
+            emit_held(r, opt);
+            if (r.next > head) refetches = 0;
+            head = r.next;
+            if (r.next < r.end) {
+                // lost or did not fit: the rest goes out again on the next free lane
+                if (++refetches > rs.retries) stuck = true;
+                else refetch = true;
+                break;
+            }
+            first = (first + 1) % window;
+            --used;
+        }
+        output_batch_end();
+        if (stuck) {
+            log_event(LOG_RECOVERY_STALLED, head, end - head);
+            break;
+        }
+
+        const uint64_t now = mono_ns();
+        if (now - last_log_ns >= 1000000000ULL) {
+            last_log_ns = now;
+            log_event(LOG_DOWNLOAD_PROGRESS, head - start_seq, count,
+                      (head - start_seq) * 1000000000ULL / (now - t0), lanes);
+        }
+    }
+
+    for (size_t l = 0; l < lanes; ++l) ::close(fds[l]);
+    arena_free(region, window * seg_bytes);
+
+    const uint64_t now = mono_ns();
+    log_event(LOG_DOWNLOAD_PROGRESS, head - start_seq, count,
+              (head - start_seq) * 1000000000ULL / std::max<uint64_t>(now - t0, 1), lanes);
+    log_event(LOG_RECOVERY_DONE, head - start_seq);
+    return head - start_seq;
+}
@@ -0,0 +1,41 @@
+#include "session.h"
+#include <cstring>
+
+SessionTracker::SessionTracker()
+    : nretired_(0), known_(false), ended_(false), prev_ended_(false), end_seq_(0), rollovers_(0) {
+    std::memset(cur_, ' ', sizeof(cur_));
+    std::memset(prev_, ' ', sizeof(prev_));
+    std::memset(retired_, ' ', sizeof(retired_));
+}
+
+SessionEvent SessionTracker::observe(const char session10[10]) {
+    if (known_ && std::memcmp(session10, cur_, 10) == 0) return SessionEvent::SAME;
+
+    if (!known_) {
+        std::memcpy(cur_, session10, 10);
+        known_ = true;
+        return SessionEvent::FIRST;
+    }
+
+    const int n = nretired_ < RETIRED ? nretired_ : RETIRED;
+    for (int i = 0; i < n; ++i) {
+        if (std::memcmp(session10, retired_[i], 10) == 0) return SessionEvent::STALE;
+    }
+
+    std::memcpy(prev_, cur_, 10);
+    std::memcpy(retired_[nretired_ % RETIRED], cur_, 10);
+    ++nretired_;
+    std::memcpy(cur_, session10, 10);
+    prev_ended_ = ended_;
+    ended_ = false;
+    end_seq_ = 0;
+    ++rollovers_;
+    return SessionEvent::ROLLOVER;
+}
+
+bool SessionTracker::end(uint64_t next_seq) {
+    if (ended_) return false;
+    ended_ = true;
+    end_seq_ = next_seq;
+    return true;
+}
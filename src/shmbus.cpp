@@ -0,0 +1,200 @@
+#include "shmbus.h"
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static std::string shm_path(const std::string& name) {
+    return (name.empty() || name[0] != '/') ? "/" + name : name;
+}
+
+static uint64_t round_pow2(uint64_t v, uint64_t min) {
+    uint64_t p = min;
+    while (p < v) p <<= 1;
+    return p;
+}
+
+// ---------- writer ----------
+
+ShmBusWriter::ShmBusWriter()
+    : hdr_(nullptr), slots_(nullptr), map_len_(0), mask_(0), payload_cap_(0) {}
+ShmBusWriter::~ShmBusWriter() { close(); }
+
+bool ShmBusWriter::open(const std::string& name, uint64_t slot_count, uint32_t slot_size) {
+    close();
+
+    slot_count = round_pow2(slot_count, 1024);
+    slot_size  = (uint32_t)round_pow2(slot_size, 64);
+    if (slot_size <= sizeof(ShmBusSlot)) slot_size = (uint32_t)round_pow2(sizeof(ShmBusSlot) + 1, 64);
+
+    const size_t hdr_len = (sizeof(ShmBusHeader) + 63) & ~size_t(63);
+    map_len_ = hdr_len + (size_t)slot_count * slot_size;
+
+    const std::string path = shm_path(name);
+    int fd = ::shm_open(path.c_str(), O_CREAT | O_RDWR, 0644);
+    if (fd < 0) {
+        perror("shm_open");
+        return false;
+    }
+    if (::ftruncate(fd, (off_t)map_len_) != 0) {
+        perror("ftruncate");
+        ::close(fd);
+        return false;
+    }
+
+    void* p = ::mmap(nullptr, map_len_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) {
+        perror("mmap");
+        return false;
+    }
+
+    hdr_   = static_cast<ShmBusHeader*>(p);
+    slots_ = static_cast<uint8_t*>(p) + hdr_len;
+    mask_  = slot_count - 1;
+    payload_cap_ = slot_size - (uint32_t)sizeof(ShmBusSlot);
+
+    // Invalidate old readers first, then publish the new geometry.
+    hdr_->magic = 0;
+    std::atomic_thread_fence(std::memory_order_release);
+    for (uint64_t i = 0; i < slot_count; ++i) {
+        auto* s = reinterpret_cast<ShmBusSlot*>(slots_ + i * slot_size);
+        s->stamp.store(0, std::memory_order_relaxed);
+    }
+    hdr_->version    = SHM_BUS_VERSION;
+    hdr_->slot_size  = slot_size;
+    hdr_->slot_count = slot_count;
+    std::memset(hdr_->session, ' ', sizeof(hdr_->session));
+    hdr_->write_index.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    hdr_->magic = SHM_BUS_MAGIC;
+    return true;
+}
+
+void ShmBusWriter::close() {
+    if (hdr_) ::munmap(hdr_, map_len_);
+    hdr_ = nullptr;
+    slots_ = nullptr;
+    map_len_ = 0;
+}
+
+void ShmBusWriter::set_session(const char session10[10]) {
+    if (hdr_ && std::memcmp(hdr_->session, session10, 10) != 0) {
+        std::memcpy(hdr_->session, session10, 10);
+    }
+}
+
+void ShmBusWriter::publish(uint64_t mold_seq, uint64_t recv_ns, const uint8_t* msg, uint16_t len) {
+    const uint64_t idx = hdr_->write_index.load(std::memory_order_relaxed);
+    auto* s = reinterpret_cast<ShmBusSlot*>(slots_ + (idx & mask_) * hdr_->slot_size);
+
+    s->stamp.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    const uint16_t n = (len > payload_cap_) ? (uint16_t)payload_cap_ : len;
+    s->mold_seq = mold_seq;
+    s->recv_ns  = recv_ns;
+    s->len      = len;
+    s->flags    = (n < len) ? SHM_BUS_TRUNCATED : 0;
+    std::memcpy(reinterpret_cast<uint8_t*>(s) + sizeof(ShmBusSlot), msg, n);
+
+    s->stamp.store(idx + 1, std::memory_order_release);
+    hdr_->write_index.store(idx + 1, std::memory_order_release);
+}
+
+// ---------- reader ----------
+
+ShmBusReader::ShmBusReader()
+    : hdr_(nullptr), slots_(nullptr), map_len_(0), mask_(0), slot_size_(0), pos_(0) {}
+ShmBusReader::~ShmBusReader() { close(); }
+
+bool ShmBusReader::open(const std::string& name) {
+    close();
+
+    const std::string path = shm_path(name);
+    int fd = ::shm_open(path.c_str(), O_RDONLY, 0);
+    if (fd < 0) return false;
+
+    struct stat st{};
+    if (::fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ShmBusHeader)) {
+        ::close(fd);
+        return false;
+    }
+    map_len_ = (size_t)st.st_size;
+
+    void* p = ::mmap(nullptr, map_len_, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) return false;
+
+    hdr_ = static_cast<const ShmBusHeader*>(p);
+    const size_t hdr_len = (sizeof(ShmBusHeader) + 63) & ~size_t(63);
+
+    if (hdr_->magic != SHM_BUS_MAGIC || hdr_->version != SHM_BUS_VERSION ||
+        hdr_len + hdr_->slot_count * hdr_->slot_size > map_len_) {
+        close();
+        return false;
+    }
+
+    slots_     = static_cast<const uint8_t*>(p) + hdr_len;
+    mask_      = hdr_->slot_count - 1;
+    slot_size_ = hdr_->slot_size;
+    pos_       = hdr_->write_index.load(std::memory_order_acquire);
+    return true;
+}
+
+void ShmBusReader::close() {
+    if (hdr_) ::munmap(const_cast<ShmBusHeader*>(hdr_), map_len_);
+    hdr_ = nullptr;
+    slots_ = nullptr;
+    map_len_ = 0;
+}
+
+int ShmBusReader::read(ShmBusMessage& m, uint8_t* payload, size_t cap, uint64_t& lost) {
+    lost = 0;
+    if (!hdr_) return 0;
+
+    const uint64_t wi = hdr_->write_index.load(std::memory_order_acquire);
+    if (pos_ >= wi) return 0;
+
+    // Lapped by more than the ring: skip to the oldest slot still intact.
+    if (wi - pos_ > mask_) {
+        const uint64_t resync = wi - mask_;
+        lost = resync - pos_;
+        pos_ = resync;
+        return -1;
+    }
+
+    const auto* s = reinterpret_cast<const ShmBusSlot*>(slots_ + (pos_ & mask_) * slot_size_);
+    const uint64_t stamp = s->stamp.load(std::memory_order_acquire);
+    if (stamp != pos_ + 1) {
+        // slot is being rewritten for a later index
+        const uint64_t resync = hdr_->write_index.load(std::memory_order_acquire) - mask_;
+        lost = (resync > pos_) ? (resync - pos_) : 1;
+        pos_ += lost;
+        return -1;
+    }
+
+    m.mold_seq = s->mold_seq;
+    m.recv_ns  = s->recv_ns;
+    m.len      = s->len;
+    m.flags    = s->flags;
+
+    size_t n = m.len;
+    if (n > slot_size_ - sizeof(ShmBusSlot)) n = slot_size_ - sizeof(ShmBusSlot);
+    if (n > cap) n = cap;
+    std::memcpy(payload, reinterpret_cast<const uint8_t*>(s) + sizeof(ShmBusSlot), n);
+    m.copied = (uint16_t)n;
+
+    // validate the copy against a concurrent overwrite
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (s->stamp.load(std::memory_order_relaxed) != stamp) {
+        lost = 1;
+        ++pos_;
+        return -1;
+    }
+
+    ++pos_;
+    return 1;
+}
@@ -0,0 +1,646 @@
+#include "sink.h"
+#include "arena.h"
+#include "decoder.h"
+#include <cerrno>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+// write(2) until done (pipes / files may take partial writes)
+static bool write_all(int fd, const char* data, size_t n) {
+    while (n > 0) {
+        ssize_t w = ::write(fd, data, n);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += w;
+        n -= (size_t)w;
+    }
+    return true;
+}
+
+// writev(2) until done, advancing across partially written iovecs
+static bool writev_all(int fd, const struct iovec* iov_in, int iovcnt) {
+    constexpr int MAX_IOV = 64;
+    struct iovec iov[MAX_IOV];
+
+    while (iovcnt > 0) {
+        int cnt = (iovcnt > MAX_IOV) ? MAX_IOV : iovcnt;
+        std::memcpy(iov, iov_in, sizeof(struct iovec) * (size_t)cnt);
+        iov_in += cnt;
+        iovcnt -= cnt;
+
+        struct iovec* cur = iov;
+        while (cnt > 0) {
+            ssize_t w = ::writev(fd, cur, cnt);
+            if (w < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            while (cnt > 0 && (size_t)w >= cur->iov_len) {
+                w -= (ssize_t)cur->iov_len;
+                ++cur;
+                --cnt;
+            }
+            if (cnt > 0) {
+                cur->iov_base = static_cast<char*>(cur->iov_base) + w;
+                cur->iov_len -= (size_t)w;
+            }
+        }
+    }
+    return true;
+}
+
+bool OutputSink::writev(const struct iovec* iov, int iovcnt) {
+    bool ok = true;
+    for (int i = 0; i < iovcnt; ++i) {
+        ok = write(static_cast<const char*>(iov[i].iov_base), iov[i].iov_len) && ok;
+    }
+    return ok;
+}
+
+// ---------- FdSink ----------
+
+FdSink::FdSink(int fd, bool owned) : fd_(fd), owned_(owned) {}
+FdSink::~FdSink() {
+    if (owned_ && fd_ >= 0) ::close(fd_);
+}
+
+bool FdSink::write(const char* data, size_t n) {
+    return write_all(fd_, data, n);
+}
+
+bool FdSink::writev(const struct iovec* iov, int iovcnt) {
+    return writev_all(fd_, iov, iovcnt);
+}
+
+// ---------- BufferedFileSink ----------
+
+BufferedFileSink::BufferedFileSink() : fd_(-1), buf_(nullptr), cap_(0), len_(0) {}
+BufferedFileSink::~BufferedFileSink() {
+    flush();
+    if (fd_ >= 0) ::close(fd_);
+    arena_free(buf_, cap_);
+}
+
+bool BufferedFileSink::open(const std::string& path, size_t buf_bytes) {
+    fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        perror(path.c_str());
+        return false;
+    }
+    cap_ = buf_bytes ? buf_bytes : (4u << 20);
+    buf_ = static_cast<char*>(arena_alloc(cap_));
+    len_ = 0;
+    return buf_ != nullptr;
+}
+
+bool BufferedFileSink::write(const char* data, size_t n) {
+    if (len_ + n > cap_) {
+        flush();
+        // larger than the whole buffer: write through
+        if (n > cap_) return write_all(fd_, data, n);
+    }
+    std::memcpy(buf_ + len_, data, n);
+    len_ += n;
+    return true;
+}
+
+bool BufferedFileSink::writev(const struct iovec* iov, int iovcnt) {
+    size_t total = 0;
+    for (int i = 0; i < iovcnt; ++i) total += iov[i].iov_len;
+
+    // small enough to keep buffering, otherwise drain ours and write through
+    if (len_ + total <= cap_) return OutputSink::writev(iov, iovcnt);
+    flush();
+    return writev_all(fd_, iov, iovcnt);
+}
+
+void BufferedFileSink::flush() {
+    if (fd_ < 0 || len_ == 0) return;
+    if (!write_all(fd_, buf_, len_)) {
+        std::cerr << "OUTPUT file write failed errno=" << errno << "\n";
+    }
+    len_ = 0;
+}
+
+// ---------- UringFileSink ----------
+
+UringFileSink::UringFileSink()
+    : uring_ok_(false), fd_(-1), file_off_(0), bufs_{}, lens_{}, offs_{}, busy_{},
+      cap_(0), cur_(0), inflight_(0) {}
+
+UringFileSink::~UringFileSink() {
+    flush();
+    while (inflight_ > 0) reap(true);
+    ring_.close();
+    if (fd_ >= 0) ::close(fd_);
+    for (int i = 0; i < NBUF; ++i) arena_free(bufs_[i], cap_);
+}
+
+bool UringFileSink::open(const std::string& path, size_t buf_bytes) {
+    fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        perror(path.c_str());
+        return false;
+    }
+    const off_t end = ::lseek(fd_, 0, SEEK_END);
+    file_off_ = (end > 0) ? (uint64_t)end : 0;
+
+    cap_ = buf_bytes ? buf_bytes : (4u << 20);
+    for (int i = 0; i < NBUF; ++i) {
+        bufs_[i] = static_cast<char*>(arena_alloc(cap_));
+        if (!bufs_[i]) return false;
+    }
+
+    uring_ok_ = ring_.init(NBUF * 2);
+    if (!uring_ok_) {
+        std::cerr << "WARN: io_uring unavailable for " << path << ", using blocking writes\n";
+    }
+    return true;
+}
+
+void UringFileSink::reap(bool wait) {
+    if (wait && !ring_.peek_cqe()) ring_.submit(1);
+
+    while (io_uring_cqe* cqe = ring_.peek_cqe()) {
+        const int idx = (int)cqe->user_data;
+        const int res = cqe->res;
+        ring_.cqe_seen();
+
+        if (idx < 0 || idx >= NBUF || !busy_[idx]) continue;
+
+        // short/failed async write: finish it synchronously at the same offset
+        size_t done = (res > 0) ? (size_t)res : 0;
+        if (res < 0) std::cerr << "OUTPUT io_uring write failed errno=" << -res << "\n";
+        while (done < lens_[idx]) {
+            ssize_t r = ::pwrite(fd_, bufs_[idx] + done, lens_[idx] - done, (off_t)(offs_[idx] + done));
+            if (r < 0) {
+                if (errno == EINTR) continue;
+                std::cerr << "OUTPUT file write failed errno=" << errno << "\n";
+                break;
+            }
+            done += (size_t)r;
+        }
+        busy_[idx] = false;
+        lens_[idx] = 0;
+        --inflight_;
+    }
+}
+
+void UringFileSink::wait_buffer(int idx) {
+    while (busy_[idx]) reap(true);
+}
+
+void UringFileSink::submit_current() {
+    const int idx = cur_;
+    if (lens_[idx] == 0) return;
+
+    io_uring_sqe* sqe = uring_ok_ ? ring_.get_sqe() : nullptr;
+    if (!sqe && uring_ok_ && inflight_ > 0) {
+        reap(true);
+        sqe = ring_.get_sqe();
+    }
+
+    if (!sqe) {
+        // synchronous fallback
+        size_t w = 0;
+        while (w < lens_[idx]) {
+            ssize_t r = ::pwrite(fd_, bufs_[idx] + w, lens_[idx] - w, (off_t)(file_off_ + w));
+            if (r < 0) {
+                if (errno == EINTR) continue;
+                std::cerr << "OUTPUT file write failed errno=" << errno << "\n";
+                break;
+            }
+            w += (size_t)r;
+        }
+        file_off_ += lens_[idx];
+        lens_[idx] = 0;
+        return;
+    }
+
+    sqe->opcode    = IORING_OP_WRITE;
+    sqe->fd        = fd_;
+    sqe->addr      = (uint64_t)(uintptr_t)bufs_[idx];
+    sqe->len       = (uint32_t)lens_[idx];
+    sqe->off       = file_off_;
+    sqe->user_data = (uint64_t)idx;
+    ring_.submit();
+
+    offs_[idx] = file_off_;
+    file_off_ += lens_[idx];
+    busy_[idx] = true;
+    ++inflight_;
+
+    cur_ = (cur_ + 1) % NBUF;
+    wait_buffer(cur_);
+    reap(false);
+}
+
+bool UringFileSink::write(const char* data, size_t n) {
+    while (n > 0) {
+        size_t room = cap_ - lens_[cur_];
+        if (room == 0) {
+            submit_current();
+            continue;
+        }
+        size_t take = (n < room) ? n : room;
+        std::memcpy(bufs_[cur_] + lens_[cur_], data, take);
+        lens_[cur_] += take;
+        data += take;
+        n -= take;
+    }
+    return true;
+}
+
+void UringFileSink::flush() {
+    submit_current();
+    if (uring_ok_) reap(false);
+}
+
+// ---------- ShmRingSink / ShmRingReader ----------
+
+static size_t round_pow2(size_t v) {
+    size_t p = 4096;
+    while (p < v) p <<= 1;
+    return p;
+}
+
+ShmRingSink::ShmRingSink() : hdr_(nullptr), data_(nullptr), map_len_(0) {}
+ShmRingSink::~ShmRingSink() {
+    if (hdr_) ::munmap(hdr_, map_len_);
+}
+
+bool ShmRingSink::open(const std::string& name, size_t capacity) {
+    const std::string shm_name = (name.empty() || name[0] != '/') ? "/" + name : name;
+    const size_t cap = round_pow2(capacity);
+    map_len_ = sizeof(ShmRingHeader) + cap;
+
+    int fd = ::shm_open(shm_name.c_str(), O_CREAT | O_RDWR, 0644);
+    if (fd < 0) {
+        perror("shm_open");
+        return false;
+    }
+    // never shrink a ring readers may still have mapped
+    struct stat st{};
+    if (::fstat(fd, &st) != 0 || ((size_t)st.st_size < map_len_ && ::ftruncate(fd, (off_t)map_len_) != 0)) {
+        perror("ftruncate");
+        ::close(fd);
+        return false;
+    }
+
+    void* p = ::mmap(nullptr, map_len_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) {
+        perror("mmap");
+        return false;
+    }
+
+    hdr_ = static_cast<ShmRingHeader*>(p);
+    data_ = static_cast<char*>(p) + sizeof(ShmRingHeader);
+
+    // (re)initialize under a new epoch: attached readers start over from 0,
+    // readers attaching later from write_pos
+    const bool reopen = hdr_->magic.load(std::memory_order_acquire) == SHM_RING_MAGIC;
+    const uint64_t epoch = reopen ? hdr_->epoch.load(std::memory_order_relaxed) + 1 : 1;
+    hdr_->magic.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    hdr_->capacity = cap;
+    hdr_->reserve_pos.store(0, std::memory_order_relaxed);
+    hdr_->last_write.store(0, std::memory_order_relaxed);
+    hdr_->write_pos.store(0, std::memory_order_relaxed);
+    hdr_->epoch.store(epoch, std::memory_order_relaxed);
+    hdr_->magic.store(SHM_RING_MAGIC, std::memory_order_release);
+    return true;
+}
+
+bool ShmRingSink::write(const char* data, size_t n) {
+    const uint64_t cap = hdr_->capacity;
+    uint64_t pos = hdr_->write_pos.load(std::memory_order_relaxed);
+    const uint64_t end = pos + n;
+
+    // only the newest `cap` bytes can be kept; they start mid-line
+    uint64_t start = pos;
+    if (n > cap) {
+        pos += n - cap;
+        data += n - cap;
+        n = cap;
+        start = end;
+    }
+
+    // claim the bytes before overwriting them
+    hdr_->reserve_pos.store(end, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    const size_t off = (size_t)(pos & (cap - 1));
+    const size_t first = (n < cap - off) ? n : (size_t)(cap - off);
+    std::memcpy(data_ + off, data, first);
+    if (n > first) std::memcpy(data_, data + first, n - first);
+
+    hdr_->last_write.store(start, std::memory_order_relaxed);
+    hdr_->write_pos.store(end, std::memory_order_release);
+    return true;
+}
+
+ShmRingReader::ShmRingReader() : hdr_(nullptr), data_(nullptr), map_len_(0), read_pos_(0), epoch_(0) {}
+ShmRingReader::~ShmRingReader() { close(); }
+
+bool ShmRingReader::open(const std::string& name) {
+    close();
+    const std::string shm_name = (name.empty() || name[0] != '/') ? "/" + name : name;
+
+    int fd = ::shm_open(shm_name.c_str(), O_RDONLY, 0);
+    if (fd < 0) return false;
+
+    struct stat st{};
+    if (::fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ShmRingHeader)) {
+        ::close(fd);
+        return false;
+    }
+    map_len_ = (size_t)st.st_size;
+
+    void* p = ::mmap(nullptr, map_len_, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) return false;
+
+    hdr_ = static_cast<const ShmRingHeader*>(p);
+    data_ = static_cast<const char*>(p) + sizeof(ShmRingHeader);
+    if (hdr_->magic.load(std::memory_order_acquire) != SHM_RING_MAGIC ||
+        sizeof(ShmRingHeader) + hdr_->capacity > map_len_) {
+        close();
+        return false;
+    }
+
+    name_ = name;
+    epoch_ = hdr_->epoch.load(std::memory_order_relaxed);
+    read_pos_ = hdr_->write_pos.load(std::memory_order_acquire);
+    return true;
+}
+
+size_t ShmRingReader::read(char* out, size_t cap, bool& overrun) {
+    overrun = false;
+    if (!hdr_) return 0;
+    if (hdr_->magic.load(std::memory_order_acquire) != SHM_RING_MAGIC) return 0;   // writer reinitializing
+
+    const uint64_t epoch = hdr_->epoch.load(std::memory_order_acquire);
+    if (epoch != epoch_) {
+        // the writer reopened the ring: follow it from the start
+        overrun = true;
+        if (sizeof(ShmRingHeader) + hdr_->capacity > map_len_) {
+            const std::string name = name_;
+            if (!open(name)) return 0;
+            read_pos_ = 0;
+            return 0;
+        }
+        epoch_ = epoch;
+        read_pos_ = 0;
+    }
+
+    const uint64_t rcap = hdr_->capacity;
+    uint64_t wp = hdr_->write_pos.load(std::memory_order_acquire);
+
+    if (wp - read_pos_ > rcap) {
+        // lapped: resume at the newest write, which starts a line or record
+        overrun = true;
+        const uint64_t lw = hdr_->last_write.load(std::memory_order_relaxed);
+        read_pos_ = (lw <= wp && wp - lw <= rcap) ? lw : wp;
+    }
+
+    size_t n = (size_t)(wp - read_pos_);
+    if (n > cap) n = cap;
+    if (n == 0) return 0;
+
+    const size_t off = (size_t)(read_pos_ & (rcap - 1));
+    const size_t first = (n < rcap - off) ? n : (size_t)(rcap - off);
+    std::memcpy(out, data_ + off, first);
+    if (n > first) std::memcpy(out + first, data_, n - first);
+
+    // a write claimed these bytes while we copied, or the ring was reopened
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const uint64_t rp = hdr_->reserve_pos.load(std::memory_order_relaxed);
+    if (hdr_->epoch.load(std::memory_order_relaxed) != epoch_) return 0;
+    if (rp - read_pos_ > rcap) {
+        overrun = true;
+        const uint64_t lw = hdr_->last_write.load(std::memory_order_relaxed);
+        const uint64_t wp2 = hdr_->write_pos.load(std::memory_order_relaxed);
+        read_pos_ = (lw <= wp2 && wp2 - lw <= rcap) ? lw : wp2;
+        return 0;
+    }
+
+    read_pos_ += n;
+    return n;
+}
+
+void ShmRingReader::close() {
+    if (hdr_) ::munmap(const_cast<ShmRingHeader*>(hdr_), map_len_);
+    hdr_ = nullptr;
+    data_ = nullptr;
+    map_len_ = 0;
+}
+
+// ---------- UdpSink ----------
+
+UdpSink::UdpSink() : fd_(-1), max_payload_(1400), records_(false) {}
+UdpSink::~UdpSink() {
+    if (fd_ >= 0) ::close(fd_);
+}
+
+bool UdpSink::open(const std::string& ip, uint16_t port,
+                   const std::string& interface_ip, int ttl, size_t max_payload) {
+    fd_ = ::socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd_ < 0) {
+        perror("socket");
+        return false;
+    }
+    max_payload_ = max_payload ? max_payload : 1400;
+
+    sockaddr_in dst{};
+    dst.sin_family = AF_INET;
+    dst.sin_port = htons(port);
+    dst.sin_addr.s_addr = ::inet_addr(ip.c_str());
+    if (dst.sin_addr.s_addr == INADDR_NONE || port == 0) {
+        std::cerr << "OUTPUT invalid udp destination " << ip << ":" << port << "\n";
+        return false;
+    }
+
+    if (IN_MULTICAST(ntohl(dst.sin_addr.s_addr))) {
+        unsigned char t = (unsigned char)(ttl > 0 ? ttl : 1);
+        ::setsockopt(fd_, IPPROTO_IP, IP_MULTICAST_TTL, &t, sizeof(t));
+        if (!interface_ip.empty()) {
+            in_addr ifa{};
+            ifa.s_addr = ::inet_addr(interface_ip.c_str());
+            ::setsockopt(fd_, IPPROTO_IP, IP_MULTICAST_IF, &ifa, sizeof(ifa));
+        }
+    }
+
+    if (::connect(fd_, (sockaddr*)&dst, sizeof(dst)) < 0) {
+        perror("connect");
+        return false;
+    }
+    return true;
+}
+
+// Bytes of `data` for the next datagram: whole lines, or whole records.
+size_t UdpSink::next_datagram(const char* data, size_t n) const {
+    if (!records_) {
+        if (n <= max_payload_) return n;
+        const void* nl = ::memrchr(data, '\n', max_payload_);
+        return nl ? (size_t)(static_cast<const char*>(nl) - data) + 1 : max_payload_;
+    }
+
+    size_t take = 0;
+    while (take + sizeof(MoldRecordHeader) <= n) {
+        uint32_t size;
+        std::memcpy(&size, data + take + offsetof(MoldRecordHeader, size), sizeof(size));
+        if (size < sizeof(MoldRecordHeader) || size > n - take) return n;   // not records: send as is
+        if (take && take + size > max_payload_) break;
+        take += size;
+        if (take >= max_payload_) break;
+    }
+    return take ? take : n;
+}
+
+bool UdpSink::write(const char* data, size_t n) {
+    // Split on line or record boundaries and hand all datagrams to one sendmmsg().
+    constexpr int MAX_DGRAMS = 64;
+    struct iovec iov[MAX_DGRAMS];
+    struct mmsghdr msgs[MAX_DGRAMS];
+
+    while (n > 0) {
+        int k = 0;
+        while (n > 0 && k < MAX_DGRAMS) {
+            const size_t take = next_datagram(data, n);
+            iov[k].iov_base = const_cast<char*>(data);
+            iov[k].iov_len = take;
+            std::memset(&msgs[k], 0, sizeof(msgs[k]));
+            msgs[k].msg_hdr.msg_iov = &iov[k];
+            msgs[k].msg_hdr.msg_iovlen = 1;
+            data += take;
+            n -= take;
+            ++k;
+        }
+
+        int sent = 0;
+        while (sent < k) {
+            int r = ::sendmmsg(fd_, msgs + sent, (unsigned)(k - sent), 0);
+            if (r < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            sent += r;
+        }
+    }
+    return true;
+}
+
+// ---------- factory ----------
+
+static bool starts_with(const std::string& s, const char* p) {
+    return s.compare(0, std::strlen(p), p) == 0;
+}
+
+// Whole string is a decimal number in [lo, hi].
+static bool parse_num(const std::string& s, unsigned long long lo, unsigned long long hi,
+                      unsigned long long& out) {
+    if (s.empty() || s[0] < '0' || s[0] > '9') return false;
+    errno = 0;
+    char* end = nullptr;
+    out = std::strtoull(s.c_str(), &end, 10);
+    return errno == 0 && *end == '\0' && out >= lo && out <= hi;
+}
+
+std::unique_ptr<OutputSink> make_sink(const std::string& spec,
+                                      size_t file_buffer_bytes,
+                                      const std::string& interface_ip) {
+    if (spec == "none") return std::make_unique<NullSink>();
+    if (spec.empty() || spec == "stdout" || spec == "-") return std::make_unique<FdSink>(1, false);
+    if (spec == "stderr") return std::make_unique<FdSink>(2, false);
+    if (starts_with(spec, "fd:")) {
+        unsigned long long fd = 0;
+        if (!parse_num(spec.substr(3), 0, INT_MAX, fd) || ::fcntl((int)fd, F_GETFD) < 0) {
+            std::cerr << "OUTPUT invalid fd sink '" << spec << "'\n";
+            return nullptr;
+        }
+        return std::make_unique<FdSink>((int)fd, false);
+    }
+
+    if (starts_with(spec, "pipe:")) {
+        const std::string path = spec.substr(5);
+        if (::mkfifo(path.c_str(), 0644) != 0 && errno != EEXIST) {
+            perror(path.c_str());
+            return nullptr;
+        }
+        // blocks until a reader opens the other end
+        int fd = ::open(path.c_str(), O_WRONLY | O_CLOEXEC);
+        if (fd < 0) {
+            perror(path.c_str());
+            return nullptr;
+        }
+        return std::make_unique<FdSink>(fd, true);
+    }
+
+    if (starts_with(spec, "shm:")) {
+        std::string name = spec.substr(4);
+        size_t bytes = 64u << 20;
+        auto colon = name.find(':');
+        if (colon != std::string::npos) {
+            unsigned long long b = 0;
+            if (!parse_num(name.substr(colon + 1), 1, SIZE_MAX, b)) {
+                std::cerr << "OUTPUT invalid shm sink size '" << spec << "'\n";
+                return nullptr;
+            }
+            bytes = (size_t)b;
+            name = name.substr(0, colon);
+        }
+        auto s = std::make_unique<ShmRingSink>();
+        if (!s->open(name, bytes)) return nullptr;
+        return s;
+    }
+
+    if (starts_with(spec, "udp:")) {
+        // udp:<ip>:<port>[:<ttl>]
+        const std::string rest = spec.substr(4);
+        auto c1 = rest.find(':');
+        if (c1 == std::string::npos) {
+            std::cerr << "OUTPUT invalid udp sink '" << spec << "'\n";
+            return nullptr;
+        }
+        auto c2 = rest.find(':', c1 + 1);
+        const std::string ip = rest.substr(0, c1);
+        unsigned long long port = 0, ttl = 1;
+        if (!parse_num(rest.substr(c1 + 1, c2 - c1 - 1), 1, 65535, port) ||
+            (c2 != std::string::npos && !parse_num(rest.substr(c2 + 1), 0, 255, ttl))) {
+            std::cerr << "OUTPUT invalid udp sink '" << spec << "'\n";
+            return nullptr;
+        }
+
+        auto s = std::make_unique<UdpSink>();
+        if (!s->open(ip, (uint16_t)port, interface_ip, (int)ttl, 1400)) return nullptr;
+        return s;
+    }
+
+    if (starts_with(spec, "uring:")) {
+        auto s = std::make_unique<UringFileSink>();
+        if (!s->open(spec.substr(6), file_buffer_bytes)) return nullptr;
+        return s;
+    }
+
+    const std::string path = starts_with(spec, "file:") ? spec.substr(5) : spec;
+    auto s = std::make_unique<BufferedFileSink>();
+    if (!s->open(path, file_buffer_bytes)) return nullptr;
+    return s;
+}
@@ -3,14 +3,29 @@
 #endif
 
 #include "socket.h"
+#include "config.h"
+#include "arena.h"
 #include <cstring>
 #include <iostream>
 #include <unistd.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
 #include <sys/socket.h>
+#include <sys/mman.h>
+#include <ifaddrs.h>
+
+// Largest UDP payload; a jumbo datagram's spill area is this big
+static constexpr size_t RX_MAX_DGRAM = 65536;
+
+// Room for one SO_RXQ_OVFL cmsg per datagram, in uint64_t words
+static constexpr size_t RX_CTRL_WORDS = (CMSG_SPACE(sizeof(uint32_t)) + 7) / 8;
+
+UdpMcastReceiver::UdpMcastReceiver()
+    : fd_(-1), timeout_ms_(0), trunc_count_(0),
+      slot_size_(2048), batch_(64),
+      slab_(nullptr), slab_len_(0), jumbo_(nullptr), jumbo_len_(0),
+      jumbo_count_(0), ovfl_last_(0), rx_drops_(0) {}
 
-UdpMcastReceiver::UdpMcastReceiver() : fd_(-1) {}
 UdpMcastReceiver::~UdpMcastReceiver() { close(); }
 
 void UdpMcastReceiver::close() {
@@ -18,6 +33,26 @@ void UdpMcastReceiver::close() {
         ::close(fd_);
         fd_ = -1;
     }
+    if (jumbo_count_ || trunc_count_) {
+        std::cerr << "INFO: rx: " << jumbo_count_ << " datagrams larger than slot_size " << slot_size_
+                  << ", " << trunc_count_ << " truncated\n";
+        jumbo_count_ = trunc_count_ = 0;
+    }
+    if (slab_)  arena_free(slab_, slab_len_);
+    if (jumbo_) ::munmap(jumbo_, jumbo_len_);
+    slab_ = jumbo_ = nullptr;
+    iov_.clear();
+    msgs_.clear();
+    ctrl_.clear();
+}
+
+void UdpMcastReceiver::set_batch_geometry(uint32_t slot_size, uint32_t batch) {
+    if (batch == 0) batch = 1;
+    if (batch > (uint32_t)MAX_RX_BATCH) batch = MAX_RX_BATCH;
+    if (slot_size < 64) slot_size = 64;
+    if (slot_size > RX_MAX_DGRAM) slot_size = RX_MAX_DGRAM;
+    slot_size_ = (slot_size + 63) & ~63u;   // keep slots cache-line aligned
+    batch_ = batch;
 }
 
 bool UdpMcastReceiver::set_rcvbuf(int bytes) {
@@ -25,6 +60,15 @@ bool UdpMcastReceiver::set_rcvbuf(int bytes) {
     return ::setsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &bytes, sizeof(bytes)) == 0;
 }
 
+bool UdpMcastReceiver::set_timeout_ms(int ms) {
+    if (fd_ < 0) return false;
+    timeval tv{};
+    tv.tv_sec  = ms / 1000;
+    tv.tv_usec = (ms % 1000) * 1000;
+    timeout_ms_ = ms;
+    return ::setsockopt(fd_, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) == 0;
+}
+
 bool UdpMcastReceiver::open(const std::string& mcast_ip,
                             uint16_t mcast_port,
                             const std::string& interface_ip,
@@ -40,6 +84,14 @@ bool UdpMcastReceiver::open(const std::string& mcast_ip,
     int reuse = 1;
     ::setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
 
+    // Have the kernel attach its queue-overflow drop count to each datagram
+    int ovfl = 1;
+    if (::setsockopt(fd_, SOL_SOCKET, SO_RXQ_OVFL, &ovfl, sizeof(ovfl)) < 0) {
+        std::cerr << "WARN: SO_RXQ_OVFL unavailable, local drops will not be reported\n";
+    }
+    ovfl_last_ = 0;
+    rx_drops_ = 0;
+
     sockaddr_in addr{};
     addr.sin_family = AF_INET;
     addr.sin_port   = htons(mcast_port);
@@ -91,5 +143,120 @@ int UdpMcastReceiver::recv_batch(struct mmsghdr* msgvec, int vlen) {
 
     // MSG_WAITFORONE: block until at least one packet arrives,
     // then return as soon as we have >=1 (and grab more if already queued).
-    return ::recvmmsg(fd_, msgvec, vlen, MSG_WAITFORONE, nullptr);
+    int n = ::recvmmsg(fd_, msgvec, vlen, MSG_WAITFORONE, nullptr);
+
+    // The counter only rides along once something was dropped; the last
+    // datagram of the batch carries the newest value.
+    for (int i = n - 1; i >= 0; --i) {
+        if (msgvec[i].msg_hdr.msg_controllen) {
+            note_drops(msgvec[i].msg_hdr);
+            break;
+        }
+    }
+    return n;
+}
+
+void UdpMcastReceiver::note_drops(const struct msghdr& mh) {
+    for (cmsghdr* c = CMSG_FIRSTHDR(&mh); c; c = CMSG_NXTHDR(const_cast<msghdr*>(&mh), c)) {
+        if (c->cmsg_level != SOL_SOCKET || c->cmsg_type != SO_RXQ_OVFL) continue;
+        uint32_t v;
+        std::memcpy(&v, CMSG_DATA(c), sizeof(v));
+        rx_drops_ += (uint32_t)(v - ovfl_last_);   // kernel counter is a wrapping u32
+        ovfl_last_ = v;
+    }
+}
+
+uint64_t UdpMcastReceiver::local_drops() {
+    return rx_drops_;
+}
+
+bool UdpMcastReceiver::alloc_slab() {
+    // Slots: one contiguous block from the hugepage arena.
+    slab_len_ = (size_t)slot_size_ * batch_;
+    slab_ = static_cast<uint8_t*>(arena_alloc(slab_len_));
+    if (!slab_) return false;
+
+    // Spill area: address space only, pages appear when a jumbo arrives.
+    jumbo_len_ = RX_MAX_DGRAM * batch_;
+    void* p = ::mmap(nullptr, jumbo_len_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED) return false;
+    jumbo_ = static_cast<uint8_t*>(p);
+
+    iov_.resize((size_t)batch_ * 2);
+    msgs_.resize(batch_);
+    ctrl_.assign((size_t)batch_ * RX_CTRL_WORDS, 0);
+    for (uint32_t i = 0; i < batch_; ++i) {
+        std::memset(&msgs_[i], 0, sizeof(msgs_[i]));
+        iov_[2 * i].iov_base     = slab_ + (size_t)i * slot_size_;
+        iov_[2 * i].iov_len      = slot_size_;
+        iov_[2 * i + 1].iov_base = jumbo_ + (size_t)i * RX_MAX_DGRAM + slot_size_;
+        iov_[2 * i + 1].iov_len  = RX_MAX_DGRAM - slot_size_;
+        msgs_[i].msg_hdr.msg_iov = &iov_[2 * i];
+        msgs_[i].msg_hdr.msg_iovlen = (slot_size_ < RX_MAX_DGRAM) ? 2 : 1;
+        msgs_[i].msg_hdr.msg_control = &ctrl_[(size_t)i * RX_CTRL_WORDS];
+    }
+    return true;
+}
+
+int UdpMcastReceiver::recv_packets(RxPacket* out, int max) {
+    if (fd_ < 0) return -1;
+    if (msgs_.empty() && !alloc_slab()) {
+        perror("rx slab");
+        return -1;
+    }
+
+    if (max > (int)batch_) max = (int)batch_;
+    for (int i = 0; i < max; ++i) msgs_[i].msg_hdr.msg_controllen = RX_CTRL_WORDS * 8;   // the kernel shrinks it
+    int n = recv_batch(msgs_.data(), max);
+    for (int i = 0; i < n; ++i) {
+        uint8_t* slot = static_cast<uint8_t*>(iov_[2 * i].iov_base);
+        uint32_t len = msgs_[i].msg_len;
+
+        if (len <= slot_size_) {
+            out[i].data = slot;
+        } else {
+            // jumbo: head is in the slot, tail already sits right after it in the spill area
+            uint8_t* big = jumbo_ + (size_t)i * RX_MAX_DGRAM;
+            std::memcpy(big, slot, slot_size_);
+            out[i].data = big;
+            ++jumbo_count_;
+        }
+        if (msgs_[i].msg_hdr.msg_flags & MSG_TRUNC) ++trunc_count_;
+        out[i].len = len;
+    }
+    return n;
+}
+
+std::string interface_name_for_ip(const std::string& ip) {
+    std::string name;
+    ifaddrs* ifs = nullptr;
+    if (::getifaddrs(&ifs) != 0) return name;
+
+    const in_addr_t want = ::inet_addr(ip.c_str());
+    for (ifaddrs* i = ifs; i; i = i->ifa_next) {
+        if (!i->ifa_addr || i->ifa_addr->sa_family != AF_INET) continue;
+        if (reinterpret_cast<sockaddr_in*>(i->ifa_addr)->sin_addr.s_addr == want) {
+            name = i->ifa_name;
+            break;
+        }
+    }
+    ::freeifaddrs(ifs);
+    return name;
+}
+
+std::unique_ptr<UdpMcastReceiver> make_receiver(const ReceiveConfig& rc) {
+    const std::string& backend = rc.backend;
+    std::unique_ptr<UdpMcastReceiver> rx;
+    if (backend == "io_uring")         rx = std::make_unique<UringMcastReceiver>();
+    else if (backend == "af_xdp")      rx = std::make_unique<XdpMcastReceiver>(rc);
+    else if (backend == "packet_ring") rx = std::make_unique<PacketRingReceiver>(rc);
+    else {
+        if (!backend.empty() && backend != "recvmmsg") {
+            std::cerr << "WARN: unknown receive backend '" << backend << "', using recvmmsg\n";
+        }
+        rx = std::make_unique<UdpMcastReceiver>();
+    }
+    // also the geometry of every backend's recvmmsg fallback
+    rx->set_batch_geometry(rc.slot_size, rc.batch);
+    return rx;
 }
@@ -0,0 +1,412 @@
+#include "state.h"
+#include "config.h"
+#include "cpu.h"
+#include "output.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+// Message type + key field bytes (up to 15), zero padded.
+struct StateKey {
+    uint64_t lo, hi;
+    bool operator==(const StateKey& o) const { return lo == o.lo && hi == o.hi; }
+};
+struct StateKeyHash {
+    size_t operator()(const StateKey& k) const { return (size_t)(k.lo * 0x9E3779B97F4A7C15ULL ^ k.hi); }
+};
+
+struct StateEntry {
+    uint64_t    seq;
+    std::string msg;
+};
+
+struct KeyField {
+    uint32_t offset = 0;
+    uint32_t size = 0;   // 0: type has no key field, one entry per type
+};
+
+static bool g_enabled = false;
+static SnapshotConfig g_cfg;
+static KeyField g_key[256];
+
+static std::unordered_map<StateKey, uint32_t, StateKeyHash> g_index;
+static std::vector<StateEntry> g_entries;
+static char     g_session[10];
+static bool     g_have_session = false;
+static uint64_t g_first_seq = 0;    // first sequence the cache covers (1 = whole session)
+static uint64_t g_next_seq = 0;     // next sequence in order (0 = nothing applied yet)
+static uint64_t g_since_ckpt = 0;   // messages applied since the last snapshot
+static uint64_t g_ckpt_ns = 0;
+
+// Changes since the last snapshot, as { u32 entry, u64 seq, u16 len, len
+// bytes } records. Only kept while the cache is one a snapshot may be
+// taken of; the writer replays them into its own copy of the cache.
+static std::vector<uint8_t> g_log;
+static bool g_log_reset = false;   // the writer's copy must be dropped first
+
+// What the receive thread hands the writer at a checkpoint.
+struct Checkpoint {
+    std::vector<uint8_t> log;
+    bool     reset = false;
+    char     session[10] = {};
+    uint64_t first_seq = 0;
+    uint64_t next_seq = 0;
+};
+
+// background writer; g_mirror is only touched by it
+static std::thread g_writer;
+static std::mutex g_mu;
+static std::condition_variable g_cv;
+static Checkpoint g_pending;             // checkpoint waiting to be written
+static bool g_have_pending = false;
+static bool g_busy = false;              // g_pending is set or being written
+static bool g_quit = false;
+static std::vector<StateEntry> g_mirror;
+
+static uint64_t mono_ns() {
+    struct timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static inline uint16_t be16(const uint8_t* p) { return (uint16_t)((p[0] << 8) | p[1]); }
+static inline uint64_t be64(const uint8_t* p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; ++i) v = (v << 8) | p[i];
+    return v;
+}
+
+static uint64_t fnv1a(const uint8_t* p, size_t n) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < n; ++i) {
+        h ^= p[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static void put(const uint8_t* msg, uint16_t len, uint64_t seq) {
+    const KeyField& kf = g_key[msg[0]];
+    uint8_t kb[16] = {};
+    kb[0] = msg[0];
+    if (kf.size && kf.offset + kf.size <= len) {
+        std::memcpy(kb + 1, msg + kf.offset, std::min<uint32_t>(kf.size, 15));
+    }
+    StateKey k;
+    std::memcpy(&k.lo, kb, 8);
+    std::memcpy(&k.hi, kb + 8, 8);
+
+    uint32_t idx;
+    auto it = g_index.find(k);
+    if (it == g_index.end()) {
+        idx = (uint32_t)g_entries.size();
+        g_index.emplace(k, idx);
+        g_entries.push_back(StateEntry{seq, std::string(reinterpret_cast<const char*>(msg), len)});
+    } else {
+        idx = it->second;
+        StateEntry& e = g_entries[idx];
+        e.seq = seq;
+        e.msg.assign(reinterpret_cast<const char*>(msg), len);   // reuses capacity
+    }
+
+    if (g_have_session && g_first_seq != 1) return;   // never snapshotted
+    const size_t at = g_log.size();
+    g_log.resize(at + 14 + len);
+    std::memcpy(&g_log[at], &idx, 4);
+    std::memcpy(&g_log[at + 4], &seq, 8);
+    std::memcpy(&g_log[at + 12], &len, 2);
+    std::memcpy(&g_log[at + 14], msg, len);
+}
+
+bool state_open(const SnapshotConfig& cfg) {
+    g_enabled = false;
+    if (cfg.path.empty()) return true;
+    g_cfg = cfg;
+
+    for (auto& k : g_key) k = KeyField{};
+    for (const auto& kv : config().msg_specs) {
+        for (const FieldSpec& f : kv.second.fields) {
+            if (f.name == cfg.key_field) {
+                g_key[(unsigned char)kv.first].offset = f.offset;
+                g_key[(unsigned char)kv.first].size = f.size;
+            }
+        }
+    }
+    state_reset();
+    g_ckpt_ns = mono_ns();
+    g_enabled = true;
+    return true;
+}
+
+void state_reset() {
+    g_index.clear();
+    g_entries.clear();
+    g_have_session = false;
+    g_first_seq = 0;
+    g_next_seq = 0;
+    g_since_ckpt = 0;
+    g_log.clear();
+    g_log_reset = true;
+}
+
+size_t state_size() {
+    return g_entries.size();
+}
+
+void state_apply(const uint8_t* pkt, size_t len) {
+    if (!g_enabled || len < 20) return;
+
+    const uint64_t seq = be64(pkt + 10);
+    const uint16_t cnt = be16(pkt + 18);
+    if (cnt == 0 || cnt == 0xFFFF) return;
+
+    // A gap nobody filled: what the cache holds no longer is the state at
+    // any sequence. Start over from here; it is not snapshotted again this
+    // session (see checkpoint()).
+    if (g_next_seq && seq > g_next_seq) {
+        std::cerr << "WARN: state cache: " << (seq - g_next_seq) << " messages from seq=" << g_next_seq
+                  << " never arrived; no snapshots until the next session\n";
+        state_reset();
+    }
+
+    if (!g_have_session) {
+        std::memcpy(g_session, pkt, 10);
+        g_have_session = true;
+        g_first_seq = seq;
+        g_next_seq = seq;
+    }
+
+    size_t off = 20;
+    uint16_t i = 0;
+    for (; i < cnt && off + 2 <= len; ++i) {
+        const uint16_t ml = be16(pkt + off);
+        off += 2;
+        if (off + ml > len) break;
+        if (ml && seq + i >= g_next_seq) put(pkt + off, ml, seq + i);   // skip what was applied already
+        off += ml;
+    }
+    if (seq + i > g_next_seq) {
+        g_since_ckpt += seq + i - g_next_seq;
+        g_next_seq = seq + i;
+    }
+}
+
+// Cache in sequence order (replay and snapshot order).
+static std::vector<const StateEntry*> ordered(const std::vector<StateEntry>& entries) {
+    std::vector<const StateEntry*> v;
+    v.reserve(entries.size());
+    for (const StateEntry& e : entries) v.push_back(&e);
+    std::sort(v.begin(), v.end(), [](const StateEntry* a, const StateEntry* b) { return a->seq < b->seq; });
+    return v;
+}
+
+// Bring the writer's copy of the cache up to the checkpoint.
+static void replay_log(const Checkpoint& c) {
+    if (c.reset) g_mirror.clear();
+    for (size_t off = 0; off < c.log.size();) {
+        uint32_t idx;
+        uint64_t seq;
+        uint16_t len;
+        std::memcpy(&idx, &c.log[off], 4);
+        std::memcpy(&seq, &c.log[off + 4], 8);
+        std::memcpy(&len, &c.log[off + 12], 2);
+        if (idx >= g_mirror.size()) g_mirror.resize(idx + 1);
+        g_mirror[idx].seq = seq;
+        g_mirror[idx].msg.assign(reinterpret_cast<const char*>(&c.log[off + 14]), len);
+        off += 14 + (size_t)len;
+    }
+}
+
+static std::vector<uint8_t> serialise(const Checkpoint& c) {
+    std::vector<uint8_t> buf(sizeof(SnapshotHeader));
+    for (const StateEntry* e : ordered(g_mirror)) {
+        const uint16_t len = (uint16_t)e->msg.size();
+        const size_t at = buf.size();
+        buf.resize(at + 10 + len);
+        std::memcpy(&buf[at], &e->seq, 8);
+        std::memcpy(&buf[at + 8], &len, 2);
+        std::memcpy(&buf[at + 10], e->msg.data(), len);
+    }
+
+    SnapshotHeader h{};
+    h.magic = SNAPSHOT_MAGIC;
+    h.version = SNAPSHOT_VERSION;
+    std::memcpy(h.session, c.session, 10);
+    h.first_seq = c.first_seq;
+    h.next_seq = c.next_seq;
+    h.entries = g_mirror.size();
+    h.body_bytes = buf.size() - sizeof(h);
+    h.checksum = fnv1a(buf.data() + sizeof(h), h.body_bytes);
+    std::memcpy(buf.data(), &h, sizeof(h));
+    return buf;
+}
+
+static bool write_file(const std::string& path, const std::vector<uint8_t>& buf) {
+    const std::string tmp = path + ".tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+
+    size_t off = 0;
+    while (off < buf.size()) {
+        ssize_t w = ::write(fd, buf.data() + off, buf.size() - off);
+        if (w <= 0) break;
+        off += (size_t)w;
+    }
+    const bool ok = off == buf.size() && ::fsync(fd) == 0;
+    ::close(fd);
+    if (!ok || ::rename(tmp.c_str(), path.c_str()) != 0) {
+        ::unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+static void writer_loop() {
+    std::unique_lock<std::mutex> lk(g_mu);
+    for (;;) {
+        g_cv.wait(lk, [] { return g_quit || g_have_pending; });
+        if (!g_have_pending) return;
+
+        Checkpoint c;
+        std::swap(c, g_pending);
+        g_have_pending = false;
+        lk.unlock();
+        replay_log(c);
+        if (!write_file(g_cfg.path, serialise(c))) {
+            std::cerr << "WARN: snapshot write to " << g_cfg.path << " failed errno=" << errno << "\n";
+        }
+        lk.lock();
+        g_busy = false;
+        g_cv.notify_all();
+    }
+}
+
+// Only a cache built from sequence 1 (directly, or on a snapshot that
+// was) is the full state at next_seq; a live join or an unfilled gap is not.
+// The receive thread only hands over the changes since the last snapshot;
+// sorting and serialising happen on the writer's copy.
+static void checkpoint() {
+    if (!g_have_session || g_first_seq != 1) return;
+    {
+        std::lock_guard<std::mutex> lk(g_mu);
+        if (g_busy) return;   // previous snapshot still being written; try next batch
+        g_busy = true;
+        g_pending.log.swap(g_log);
+        g_pending.reset = g_log_reset;
+        std::memcpy(g_pending.session, g_session, 10);
+        g_pending.first_seq = g_first_seq;
+        g_pending.next_seq = g_next_seq;
+        g_have_pending = true;
+    }
+    g_log_reset = false;
+    if (!g_writer.joinable()) g_writer = cpu_start_aux_thread(writer_loop);
+    g_cv.notify_all();
+
+    g_since_ckpt = 0;
+    g_ckpt_ns = mono_ns();
+}
+
+void state_maybe_checkpoint() {
+    if (!g_enabled || g_since_ckpt == 0) return;
+    if ((g_cfg.interval_msgs && g_since_ckpt >= g_cfg.interval_msgs) ||
+        (g_cfg.interval_sec && mono_ns() - g_ckpt_ns >= (uint64_t)g_cfg.interval_sec * 1000000000ULL)) {
+        checkpoint();
+    }
+}
+
+bool state_load(const std::string& path, char session10[10], uint64_t& next_seq) {
+    FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f) return false;
+    std::vector<uint8_t> buf;
+    uint8_t tmp[65536];
+    size_t n;
+    while ((n = std::fread(tmp, 1, sizeof(tmp), f)) > 0) buf.insert(buf.end(), tmp, tmp + n);
+    std::fclose(f);
+
+    SnapshotHeader h;
+    if (buf.size() < sizeof(h)) return false;
+    std::memcpy(&h, buf.data(), sizeof(h));
+    if (h.magic != SNAPSHOT_MAGIC || h.version != SNAPSHOT_VERSION ||
+        h.body_bytes != buf.size() - sizeof(h) ||
+        h.checksum != fnv1a(buf.data() + sizeof(h), h.body_bytes) ||
+        h.first_seq != 1 || h.next_seq < 1) {
+        return false;
+    }
+
+    state_reset();
+    size_t off = sizeof(h);
+    for (uint64_t i = 0; i < h.entries; ++i) {
+        if (off + 10 > buf.size()) return false;
+        uint64_t seq;
+        uint16_t len;
+        std::memcpy(&seq, &buf[off], 8);
+        std::memcpy(&len, &buf[off + 8], 2);
+        off += 10;
+        if (len == 0 || off + len > buf.size() || seq >= h.next_seq) {
+            state_reset();
+            return false;
+        }
+        put(&buf[off], len, seq);
+        off += len;
+    }
+
+    std::memcpy(g_session, h.session, 10);
+    g_have_session = true;
+    g_first_seq = h.first_seq;
+    g_next_seq = h.next_seq;
+    std::memcpy(session10, h.session, 10);
+    next_seq = h.next_seq;
+    return true;
+}
+
+size_t state_replay(const DecodeOptions& opt) {
+    static uint8_t pkt[20 + 2 + 65535];
+    std::memcpy(pkt, g_session, 10);
+
+    size_t n = 0;
+    for (const StateEntry* e : ordered(g_entries)) {
+        const uint16_t len = (uint16_t)e->msg.size();
+        for (int b = 0; b < 8; ++b) pkt[10 + b] = (uint8_t)(e->seq >> (56 - 8 * b));
+        pkt[18] = 0;
+        pkt[19] = 1;
+        pkt[20] = (uint8_t)(len >> 8);
+        pkt[21] = (uint8_t)len;
+        std::memcpy(pkt + 22, e->msg.data(), len);
+        output_packet(pkt, 22 + (size_t)len, opt);
+        ++n;
+    }
+    output_flush();
+    return n;
+}
+
+void state_close() {
+    if (g_enabled && g_since_ckpt) {
+        {
+            std::unique_lock<std::mutex> lk(g_mu);
+            g_cv.wait(lk, [] { return !g_busy; });
+        }
+        checkpoint();
+    }
+    if (g_writer.joinable()) {
+        {
+            std::lock_guard<std::mutex> lk(g_mu);
+            g_quit = true;
+        }
+        g_cv.notify_one();
+        g_writer.join();
+    }
+    g_quit = false;
+    g_enabled = false;
+    g_mirror.clear();
+}
@@ -0,0 +1,217 @@
+#include "uring.h"
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+static int sys_io_uring_setup(unsigned entries, io_uring_params* p) {
+    return (int)::syscall(__NR_io_uring_setup, entries, p);
+}
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+                              unsigned flags, const void* arg, size_t argsz) {
+    return (int)::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz);
+}
+static int sys_io_uring_register(int fd, unsigned op, const void* arg, unsigned nr) {
+    return (int)::syscall(__NR_io_uring_register, fd, op, arg, nr);
+}
+
+static inline unsigned load_acquire(const unsigned* p) {
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+static inline void store_release(unsigned* p, unsigned v) {
+    __atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+
+IoUring::IoUring()
+    : fd_(-1),
+      sq_head_(nullptr), sq_tail_(nullptr), sq_array_(nullptr), sq_mask_(0), sq_entries_(0),
+      sqe_tail_(0), sqes_(nullptr),
+      cq_head_(nullptr), cq_tail_(nullptr), cq_mask_(0), cqes_(nullptr),
+      sq_ring_(nullptr), sq_ring_len_(0), cq_ring_(nullptr), cq_ring_len_(0), sqes_len_(0),
+      br_(nullptr), br_len_(0), br_base_(nullptr), br_mask_(0), br_buf_size_(0),
+      br_tail_(0), br_bgid_(0) {}
+
+IoUring::~IoUring() { close(); }
+
+bool IoUring::init(unsigned entries) {
+    close();
+
+    io_uring_params p{};
+    fd_ = sys_io_uring_setup(entries, &p);
+    if (fd_ < 0) return false;
+
+    sq_ring_len_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cq_ring_len_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    const bool single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single && cq_ring_len_ > sq_ring_len_) sq_ring_len_ = cq_ring_len_;
+
+    sq_ring_ = ::mmap(nullptr, sq_ring_len_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      fd_, IORING_OFF_SQ_RING);
+    if (sq_ring_ == MAP_FAILED) { sq_ring_ = nullptr; close(); return false; }
+
+    if (single) {
+        cq_ring_ = sq_ring_;
+    } else {
+        cq_ring_ = ::mmap(nullptr, cq_ring_len_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          fd_, IORING_OFF_CQ_RING);
+        if (cq_ring_ == MAP_FAILED) { cq_ring_ = nullptr; close(); return false; }
+    }
+
+    sqes_len_ = p.sq_entries * sizeof(io_uring_sqe);
+    void* sq = ::mmap(nullptr, sqes_len_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      fd_, IORING_OFF_SQES);
+    if (sq == MAP_FAILED) { close(); return false; }
+    sqes_ = static_cast<io_uring_sqe*>(sq);
+
+    auto* sqb = static_cast<uint8_t*>(sq_ring_);
+    sq_head_    = reinterpret_cast<unsigned*>(sqb + p.sq_off.head);
+    sq_tail_    = reinterpret_cast<unsigned*>(sqb + p.sq_off.tail);
+    sq_mask_    = *reinterpret_cast<unsigned*>(sqb + p.sq_off.ring_mask);
+    sq_entries_ = *reinterpret_cast<unsigned*>(sqb + p.sq_off.ring_entries);
+    sq_array_   = reinterpret_cast<unsigned*>(sqb + p.sq_off.array);
+    sqe_tail_   = *sq_tail_;
+
+    auto* cqb = static_cast<uint8_t*>(cq_ring_);
+    cq_head_ = reinterpret_cast<unsigned*>(cqb + p.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(cqb + p.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<unsigned*>(cqb + p.cq_off.ring_mask);
+    cqes_    = reinterpret_cast<io_uring_cqe*>(cqb + p.cq_off.cqes);
+    return true;
+}
+
+void IoUring::close() {
+    if (br_) {
+        if (fd_ >= 0) {
+            io_uring_buf_reg reg{};
+            reg.bgid = br_bgid_;
+            sys_io_uring_register(fd_, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+        }
+        ::munmap(br_, br_len_);
+        br_ = nullptr;
+    }
+    if (sqes_) ::munmap(sqes_, sqes_len_);
+    if (cq_ring_ && cq_ring_ != sq_ring_) ::munmap(cq_ring_, cq_ring_len_);
+    if (sq_ring_) ::munmap(sq_ring_, sq_ring_len_);
+    sqes_ = nullptr;
+    cq_ring_ = nullptr;
+    sq_ring_ = nullptr;
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = -1;
+}
+
+io_uring_sqe* IoUring::get_sqe() {
+    const unsigned head = load_acquire(sq_head_);
+    if (sqe_tail_ - head >= sq_entries_) return nullptr;
+
+    const unsigned idx = sqe_tail_ & sq_mask_;
+    io_uring_sqe* sqe = &sqes_[idx];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sq_array_[idx] = idx;
+    ++sqe_tail_;
+    return sqe;
+}
+
+int IoUring::submit(unsigned wait_nr, int timeout_ms) {
+    const unsigned to_submit = sqe_tail_ - *sq_tail_;
+    store_release(sq_tail_, sqe_tail_);
+
+    unsigned flags = wait_nr ? IORING_ENTER_GETEVENTS : 0;
+    if (to_submit == 0 && wait_nr == 0) return 0;
+
+    int r;
+    if (wait_nr && timeout_ms >= 0) {
+        __kernel_timespec ts{};
+        ts.tv_sec  = timeout_ms / 1000;
+        ts.tv_nsec = (long long)(timeout_ms % 1000) * 1000000LL;
+        io_uring_getevents_arg arg{};
+        arg.ts = (uint64_t)(uintptr_t)&ts;
+        r = sys_io_uring_enter(fd_, to_submit, wait_nr, flags | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+    } else {
+        r = sys_io_uring_enter(fd_, to_submit, wait_nr, flags, nullptr, 0);
+    }
+    return (r < 0) ? -errno : r;
+}
+
+io_uring_cqe* IoUring::peek_cqe() {
+    const unsigned head = *cq_head_;
+    if (head == load_acquire(cq_tail_)) return nullptr;
+    return &cqes_[head & cq_mask_];
+}
+
+void IoUring::cqe_seen() {
+    store_release(cq_head_, *cq_head_ + 1);
+}
+
+// Kernel-allocated buffer ring (5.19+ headers may predate these)
+#ifndef IOU_PBUF_RING_MMAP
+#define IOU_PBUF_RING_MMAP 1
+#endif
+#ifndef IORING_OFF_PBUF_RING
+#define IORING_OFF_PBUF_RING  0x80000000ULL
+#define IORING_OFF_PBUF_SHIFT 16
+#endif
+
+bool IoUring::setup_buf_ring(uint16_t bgid, uint8_t* base, unsigned count, unsigned buf_size) {
+    if (fd_ < 0 || count == 0 || (count & (count - 1)) != 0 || count > 32768) return false;
+
+    br_len_ = count * sizeof(io_uring_buf);
+
+    // Prefer a kernel-allocated ring mapped into our address space; fall
+    // back to registering our own memory on kernels without it.
+    io_uring_buf_reg reg{};
+    reg.ring_entries = count;
+    reg.bgid         = bgid;
+    reg.pad          = IOU_PBUF_RING_MMAP;   // "flags" in newer headers
+
+    void* p = MAP_FAILED;
+    if (sys_io_uring_register(fd_, IORING_REGISTER_PBUF_RING, &reg, 1) == 0) {
+        const uint64_t off = IORING_OFF_PBUF_RING | ((uint64_t)bgid << IORING_OFF_PBUF_SHIFT);
+        p = ::mmap(nullptr, br_len_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, (off_t)off);
+        if (p == MAP_FAILED) {
+            io_uring_buf_reg unreg{};
+            unreg.bgid = bgid;
+            sys_io_uring_register(fd_, IORING_UNREGISTER_PBUF_RING, &unreg, 1);
+        }
+    }
+
+    if (p == MAP_FAILED) {
+        p = ::mmap(nullptr, br_len_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) return false;
+        std::memset(p, 0, br_len_);
+
+        reg.pad       = 0;
+        reg.ring_addr = (uint64_t)(uintptr_t)p;
+        if (sys_io_uring_register(fd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+            ::munmap(p, br_len_);
+            return false;
+        }
+    }
+    br_ = static_cast<io_uring_buf_ring*>(p);
+
+    br_base_     = base;
+    br_mask_     = count - 1;
+    br_buf_size_ = buf_size;
+    br_bgid_     = bgid;
+    br_tail_     = 0;
+
+    for (unsigned i = 0; i < count; ++i) buf_ring_add((uint16_t)i);
+    buf_ring_publish();
+    return true;
+}
+
+// The ring is an array of io_uring_buf whose first entry's `resv` doubles as
+// the tail. Index it directly: in C++ the header's flex-array wrapper puts
+// io_uring_buf_ring::bufs at the wrong offset.
+void IoUring::buf_ring_add(uint16_t bid) {
+    io_uring_buf* b = reinterpret_cast<io_uring_buf*>(br_) + (br_tail_ & br_mask_);
+    b->addr = (uint64_t)(uintptr_t)(br_base_ + (size_t)bid * br_buf_size_);
+    b->len  = br_buf_size_;
+    b->bid  = bid;
+    ++br_tail_;
+}
+
+void IoUring::buf_ring_publish() {
+    __atomic_store_n(&reinterpret_cast<io_uring_buf*>(br_)->resv, br_tail_, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,153 @@
+#include "socket.h"
+#include "arena.h"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+// Provided buffer ring geometry: each buffer holds an io_uring_recvmsg_out
+// header followed by one datagram.
+static constexpr unsigned URING_ENTRIES  = 256;
+static constexpr unsigned URING_BUFS     = 512;
+static constexpr unsigned URING_BUF_SIZE = 16384;
+static constexpr uint16_t URING_BGID     = 1;
+
+UringMcastReceiver::UringMcastReceiver()
+    : uring_ok_(false), armed_(false), msg_{}, slab_(nullptr), slab_len_(0) {}
+
+UringMcastReceiver::~UringMcastReceiver() { close(); }
+
+void UringMcastReceiver::close() {
+    ring_.close();
+    if (slab_) arena_free(slab_, slab_len_);
+    slab_ = nullptr;
+    uring_ok_ = false;
+    armed_ = false;
+    used_.clear();
+    UdpMcastReceiver::close();
+}
+
+bool UringMcastReceiver::open(const std::string& mcast_ip,
+                              uint16_t mcast_port,
+                              const std::string& interface_ip,
+                              const std::string& source_ip) {
+    if (!UdpMcastReceiver::open(mcast_ip, mcast_port, interface_ip, source_ip)) return false;
+
+    slab_len_ = (size_t)URING_BUFS * URING_BUF_SIZE;
+    slab_ = static_cast<uint8_t*>(arena_alloc(slab_len_, 4096));
+    if (!slab_) {
+        std::cerr << "WARN: io_uring buffer slab failed, using recvmmsg\n";
+        return true;
+    }
+
+    if (!ring_.init(URING_ENTRIES) ||
+        !ring_.setup_buf_ring(URING_BGID, slab_, URING_BUFS, URING_BUF_SIZE)) {
+        std::cerr << "WARN: io_uring unavailable (errno=" << errno << "), using recvmmsg\n";
+        ring_.close();
+        return true;
+    }
+
+    std::memset(&msg_, 0, sizeof(msg_));
+    msg_.msg_controllen = CMSG_SPACE(sizeof(uint32_t));   // SO_RXQ_OVFL, see note_drops()
+    used_.reserve(URING_BUFS);
+    uring_ok_ = arm();
+    if (!uring_ok_) {
+        std::cerr << "WARN: io_uring multishot recvmsg failed, using recvmmsg\n";
+        ring_.close();
+    } else {
+        std::cerr << "INFO: io_uring receive backend active\n";
+    }
+    return true;
+}
+
+bool UringMcastReceiver::arm() {
+    io_uring_sqe* sqe = ring_.get_sqe();
+    if (!sqe) return false;
+
+    sqe->opcode    = IORING_OP_RECVMSG;
+    sqe->fd        = fd_;
+    sqe->addr      = (uint64_t)(uintptr_t)&msg_;
+    sqe->ioprio    = IORING_RECV_MULTISHOT;
+    sqe->flags     = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BGID;
+
+    armed_ = ring_.submit() >= 0;
+    return armed_;
+}
+
+int UringMcastReceiver::recv_packets(RxPacket* out, int max) {
+    if (!uring_ok_) return UdpMcastReceiver::recv_packets(out, max);
+
+    if (!armed_ && !arm()) return -1;
+
+    io_uring_cqe* cqe = ring_.peek_cqe();
+    if (!cqe) {
+        int r = ring_.submit(1, timeout_ms_ > 0 ? timeout_ms_ : -1);
+        if (r < 0 && r != -ETIME && r != -EINTR) {
+            std::cerr << "WARN: io_uring wait failed errno=" << -r << "\n";
+        }
+        cqe = ring_.peek_cqe();
+        if (!cqe) return -1;
+    }
+
+    int n = 0;
+    while (cqe && n < max) {
+        const int res = cqe->res;
+        const uint32_t flags = cqe->flags;
+
+        if (!(flags & IORING_CQE_F_MORE)) armed_ = false;   // multishot ended, re-arm on release()
+
+        if (flags & IORING_CQE_F_BUFFER) {
+            const uint16_t bid = (uint16_t)(flags >> IORING_CQE_BUFFER_SHIFT);
+            used_.push_back(bid);
+
+            if (res > 0) {
+                const uint8_t* b = slab_ + (size_t)bid * URING_BUF_SIZE;
+                const auto* ro = reinterpret_cast<const io_uring_recvmsg_out*>(b);
+                const size_t off = sizeof(io_uring_recvmsg_out) + msg_.msg_namelen + msg_.msg_controllen;
+                const size_t len = ro->payloadlen;
+
+                // Larger than the buffer: dropped (and counted) rather than
+                // handed to the decoder cut short; the gap is recovered.
+                if ((size_t)res < off || (ro->flags & MSG_TRUNC) || off + len > (size_t)res) {
+                    ++trunc_count_;
+                } else {
+                    if (ro->controllen) {
+                        msghdr mh{};
+                        mh.msg_control    = const_cast<uint8_t*>(b) + sizeof(io_uring_recvmsg_out) + msg_.msg_namelen;
+                        mh.msg_controllen = ro->controllen;
+                        note_drops(mh);
+                    }
+
+                    out[n].data = b + off;
+                    out[n].len  = (uint32_t)len;
+                    ++n;
+                }
+            }
+        } else if (res < 0 && res != -ENOBUFS) {
+            std::cerr << "WARN: io_uring recvmsg errno=" << -res << "\n";
+        }
+
+        ring_.cqe_seen();
+        cqe = ring_.peek_cqe();
+    }
+
+    // Nothing for the caller, who will not call release(): buffers of
+    // dropped datagrams go back to the ring now, and an ended multishot is
+    // re-armed.
+    if (n == 0) {
+        release();
+        return -1;
+    }
+    return n;
+}
+
+void UringMcastReceiver::release() {
+    if (!uring_ok_) return;
+
+    if (!used_.empty()) {
+        for (uint16_t bid : used_) ring_.buf_ring_add(bid);
+        ring_.buf_ring_publish();
+        used_.clear();
+    }
+    if (!armed_) arm();
+}
@@ -0,0 +1,381 @@
+#include "socket.h"
+#include "config.h"
+#include "netparse.h"
+#include "arena.h"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/bpf.h>
+#include <linux/if_link.h>
+#include <linux/if_xdp.h>
+
+#ifndef AF_XDP
+#define AF_XDP 44
+#endif
+#ifndef SOL_XDP
+#define SOL_XDP 283
+#endif
+
+// UMEM geometry: one frame per datagram
+static constexpr uint32_t XDP_NUM_FRAMES  = 4096;
+static constexpr uint32_t XDP_FRAME_SIZE  = 2048;
+static constexpr uint32_t XDP_RX_ENTRIES  = 2048;
+static constexpr uint32_t XDP_FILL_ENTRIES = 4096;
+static constexpr uint32_t XDP_COMP_ENTRIES = 64;    // required by the kernel, unused (no TX)
+
+static inline uint32_t load_acquire(const uint32_t* p) { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+static inline void store_release(uint32_t* p, uint32_t v) { __atomic_store_n(p, v, __ATOMIC_RELEASE); }
+
+static long sys_bpf(int cmd, union bpf_attr* attr) {
+    return ::syscall(__NR_bpf, cmd, attr, sizeof(*attr));
+}
+
+// ---------- BPF instruction helpers ----------
+
+static bpf_insn insn(uint8_t code, uint8_t dst, uint8_t src, int16_t off, int32_t imm) {
+    bpf_insn i{};
+    i.code = code;
+    i.dst_reg = dst;
+    i.src_reg = src;
+    i.off = off;
+    i.imm = imm;
+    return i;
+}
+static bpf_insn mov64_reg(uint8_t dst, uint8_t src)   { return insn(BPF_ALU64 | BPF_MOV | BPF_X, dst, src, 0, 0); }
+static bpf_insn mov64_imm(uint8_t dst, int32_t imm)   { return insn(BPF_ALU64 | BPF_MOV | BPF_K, dst, 0, 0, imm); }
+static bpf_insn add64_imm(uint8_t dst, int32_t imm)   { return insn(BPF_ALU64 | BPF_ADD | BPF_K, dst, 0, 0, imm); }
+static bpf_insn and64_imm(uint8_t dst, int32_t imm)   { return insn(BPF_ALU64 | BPF_AND | BPF_K, dst, 0, 0, imm); }
+static bpf_insn ldx(uint8_t size, uint8_t dst, uint8_t src, int16_t off) { return insn(BPF_LDX | size | BPF_MEM, dst, src, off, 0); }
+static bpf_insn jgt_reg(uint8_t dst, uint8_t src, int16_t off) { return insn(BPF_JMP | BPF_JGT | BPF_X, dst, src, off, 0); }
+static bpf_insn jne_imm(uint8_t dst, int32_t imm, int16_t off) { return insn(BPF_JMP | BPF_JNE | BPF_K, dst, 0, off, imm); }
+static bpf_insn jne32_imm(uint8_t dst, int32_t imm, int16_t off) { return insn(BPF_JMP32 | BPF_JNE | BPF_K, dst, 0, off, imm); }
+static bpf_insn ja(int16_t off) { return insn(BPF_JMP | BPF_JA, 0, 0, off, 0); }
+static bpf_insn call(int32_t fn) { return insn(BPF_JMP | BPF_CALL, 0, 0, 0, fn); }
+static bpf_insn exit_insn()      { return insn(BPF_JMP | BPF_EXIT, 0, 0, 0, 0); }
+
+// ---------- XdpMcastReceiver ----------
+
+XdpMcastReceiver::XdpMcastReceiver(const ReceiveConfig& rc)
+    : PacketRingReceiver(rc),
+      queue_id_(rc.xdp_queue), native_(rc.xdp_mode == "drv"),
+      xsk_fd_(-1), map_fd_(-1), prog_fd_(-1), link_fd_(-1),
+      umem_(nullptr), umem_len_(0), kernel_path_(0), rx_calls_(0), xdp_ok_(false) {}
+
+XdpMcastReceiver::~XdpMcastReceiver() { close(); }
+
+void XdpMcastReceiver::close_xsk() {
+    if (xdp_ok_) {
+        const uint64_t d = local_drops();
+        if (d) std::cerr << "WARN: af_xdp: " << d << " frames dropped (RX ring full, no free UMEM frame or socket buffer full)\n";
+        if (kernel_path_) std::cerr << "WARN: af_xdp: " << kernel_path_ << " datagrams missed the XSK and came through the kernel\n";
+    }
+    if (link_fd_ >= 0) ::close(link_fd_);   // detaches the program
+    if (prog_fd_ >= 0) ::close(prog_fd_);
+    if (map_fd_ >= 0)  ::close(map_fd_);
+    for (Ring* r : {&rx_, &fill_, &comp_}) {
+        if (r->map) ::munmap(r->map, r->map_len);
+        *r = Ring{};
+    }
+    if (xsk_fd_ >= 0) ::close(xsk_fd_);
+    if (umem_) arena_free(umem_, umem_len_);
+    link_fd_ = prog_fd_ = map_fd_ = xsk_fd_ = -1;
+    umem_ = nullptr;
+    used_.clear();
+    kernel_path_ = 0;
+    rx_calls_ = 0;
+    xdp_ok_ = false;
+}
+
+void XdpMcastReceiver::close() {
+    close_xsk();
+    PacketRingReceiver::close();
+}
+
+bool XdpMcastReceiver::open(const std::string& mcast_ip,
+                            uint16_t mcast_port,
+                            const std::string& interface_ip,
+                            const std::string& source_ip) {
+    // The UDP socket keeps the group membership (IGMP + NIC filter), takes
+    // the feed frames the XDP program passes on, and is the last-resort
+    // path if neither AF_XDP nor the packet ring comes up.
+    if (!open_joined(mcast_ip, mcast_port, interface_ip, source_ip)) return false;
+    if (ifindex_ == 0) {
+        std::cerr << "WARN: af_xdp: using recvmmsg\n";
+        return true;
+    }
+
+    if (setup_xsk() && load_program()) {
+        xdp_ok_ = true;
+        used_.reserve(XDP_RX_ENTRIES);
+        std::cerr << "INFO: af_xdp receive backend active on " << ifname_
+                  << " queue " << queue_id_ << (native_ ? " (drv)" : " (skb)") << "\n";
+        return true;
+    }
+
+    std::cerr << "WARN: af_xdp setup failed on " << ifname_ << " (errno=" << errno << "), trying packet_ring\n";
+    close_xsk();
+    if (!setup_ring()) {
+        std::cerr << "WARN: packet_ring setup failed (errno=" << errno << "), using recvmmsg\n";
+        close_ring();
+    }
+    return true;
+}
+
+bool XdpMcastReceiver::map_ring(Ring& r, int which, uint64_t pgoff, uint32_t entries, size_t desc_size) {
+    xdp_mmap_offsets off{};
+    socklen_t optlen = sizeof(off);
+    if (::getsockopt(xsk_fd_, SOL_XDP, XDP_MMAP_OFFSETS, &off, &optlen) != 0) return false;
+
+    const xdp_ring_offset& ro = (which == 0) ? off.rx : (which == 1) ? off.fr : off.cr;
+    r.map_len = ro.desc + (size_t)entries * desc_size;
+    void* p = ::mmap(nullptr, r.map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, xsk_fd_, (off_t)pgoff);
+    if (p == MAP_FAILED) return false;
+
+    auto* b = static_cast<uint8_t*>(p);
+    r.map      = p;
+    r.producer = reinterpret_cast<uint32_t*>(b + ro.producer);
+    r.consumer = reinterpret_cast<uint32_t*>(b + ro.consumer);
+    r.flags    = reinterpret_cast<uint32_t*>(b + ro.flags);
+    r.desc     = b + ro.desc;
+    r.mask     = entries - 1;
+    return true;
+}
+
+bool XdpMcastReceiver::setup_xsk() {
+    xsk_fd_ = ::socket(AF_XDP, SOCK_RAW | SOCK_CLOEXEC, 0);
+    if (xsk_fd_ < 0) return false;
+
+    umem_len_ = (size_t)XDP_NUM_FRAMES * XDP_FRAME_SIZE;
+    umem_ = static_cast<uint8_t*>(arena_alloc(umem_len_, 4096));
+    if (!umem_) return false;
+
+    xdp_umem_reg reg{};
+    reg.addr = (uint64_t)(uintptr_t)umem_;
+    reg.len = umem_len_;
+    reg.chunk_size = XDP_FRAME_SIZE;
+    reg.headroom = 0;
+    if (::setsockopt(xsk_fd_, SOL_XDP, XDP_UMEM_REG, &reg, sizeof(reg)) != 0) return false;
+
+    uint32_t n = XDP_FILL_ENTRIES;
+    if (::setsockopt(xsk_fd_, SOL_XDP, XDP_UMEM_FILL_RING, &n, sizeof(n)) != 0) return false;
+    n = XDP_COMP_ENTRIES;
+    if (::setsockopt(xsk_fd_, SOL_XDP, XDP_UMEM_COMPLETION_RING, &n, sizeof(n)) != 0) return false;
+    n = XDP_RX_ENTRIES;
+    if (::setsockopt(xsk_fd_, SOL_XDP, XDP_RX_RING, &n, sizeof(n)) != 0) return false;
+
+    if (!map_ring(rx_, 0, XDP_PGOFF_RX_RING, XDP_RX_ENTRIES, sizeof(xdp_desc)) ||
+        !map_ring(fill_, 1, XDP_UMEM_PGOFF_FILL_RING, XDP_FILL_ENTRIES, sizeof(uint64_t)) ||
+        !map_ring(comp_, 2, XDP_UMEM_PGOFF_COMPLETION_RING, XDP_COMP_ENTRIES, sizeof(uint64_t))) {
+        return false;
+    }
+
+    // every frame starts out owned by the kernel
+    uint64_t addrs[256];
+    for (uint32_t f = 0; f < XDP_NUM_FRAMES; f += 256) {
+        for (uint32_t i = 0; i < 256; ++i) addrs[i] = (uint64_t)(f + i) * XDP_FRAME_SIZE;
+        refill(addrs, 256);
+    }
+
+    sockaddr_xdp sxdp{};
+    sxdp.sxdp_family = AF_XDP;
+    sxdp.sxdp_ifindex = (uint32_t)ifindex_;
+    sxdp.sxdp_queue_id = queue_id_;
+    sxdp.sxdp_flags = XDP_USE_NEED_WAKEUP | (native_ ? XDP_ZEROCOPY : XDP_COPY);
+    if (::bind(xsk_fd_, (sockaddr*)&sxdp, sizeof(sxdp)) != 0) {
+        if (!native_) return false;
+        // driver without zero-copy support: native mode, copy
+        sxdp.sxdp_flags = XDP_USE_NEED_WAKEUP | XDP_COPY;
+        if (::bind(xsk_fd_, (sockaddr*)&sxdp, sizeof(sxdp)) != 0) return false;
+    }
+    return true;
+}
+
+bool XdpMcastReceiver::load_program() {
+    union bpf_attr attr{};
+
+    attr.map_type    = BPF_MAP_TYPE_XSKMAP;
+    attr.key_size    = 4;
+    attr.value_size  = 4;
+    attr.max_entries = 64;
+    map_fd_ = (int)sys_bpf(BPF_MAP_CREATE, &attr);
+    if (map_fd_ < 0) return false;
+
+    uint32_t key = queue_id_;
+    uint32_t val = (uint32_t)xsk_fd_;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.map_fd = (uint32_t)map_fd_;
+    attr.key    = (uint64_t)(uintptr_t)&key;
+    attr.value  = (uint64_t)(uintptr_t)&val;
+    if (sys_bpf(BPF_MAP_UPDATE_ELEM, &attr) != 0) return false;
+
+    // Loads of packet bytes are little-endian on the host, so compare
+    // against the network-order values as stored in memory.
+    const int32_t eth_ip  = 0x0008;          // 08 00
+    const int32_t udp_dport = (int32_t)port_be_;
+    const int32_t daddr     = (int32_t)group_be_;
+    const int32_t saddr     = (int32_t)source_be_;
+    constexpr int PASS = 27;
+
+    // r6 = ctx; r2 = data; r3 = data_end
+    bpf_insn prog[] = {
+        /* 0*/ mov64_reg(BPF_REG_6, BPF_REG_1),
+        /* 1*/ ldx(BPF_W, BPF_REG_2, BPF_REG_6, 0),
+        /* 2*/ ldx(BPF_W, BPF_REG_3, BPF_REG_6, 4),
+        /* 3*/ mov64_reg(BPF_REG_4, BPF_REG_2),
+        /* 4*/ add64_imm(BPF_REG_4, 42),                       // eth(14) + ip(20) + udp(8)
+        /* 5*/ jgt_reg(BPF_REG_4, BPF_REG_3, PASS - 6),
+        /* 6*/ ldx(BPF_H, BPF_REG_5, BPF_REG_2, 12),
+        /* 7*/ jne_imm(BPF_REG_5, eth_ip, PASS - 8),
+        /* 8*/ ldx(BPF_B, BPF_REG_5, BPF_REG_2, 14),
+        /* 9*/ jne_imm(BPF_REG_5, 0x45, PASS - 10),            // IPv4, no options
+        /*10*/ ldx(BPF_B, BPF_REG_5, BPF_REG_2, 23),
+        /*11*/ jne_imm(BPF_REG_5, 17, PASS - 12),              // UDP
+        /*12*/ ldx(BPF_H, BPF_REG_5, BPF_REG_2, 20),
+        /*13*/ and64_imm(BPF_REG_5, 0xFF3F),                   // MF | fragment offset
+        /*14*/ jne_imm(BPF_REG_5, 0, PASS - 15),
+        /*15*/ ldx(BPF_W, BPF_REG_5, BPF_REG_2, 30),
+        /*16*/ jne32_imm(BPF_REG_5, daddr, PASS - 17),
+        /*17*/ ldx(BPF_W, BPF_REG_5, BPF_REG_2, 26),
+        /*18*/ source_be_ ? jne32_imm(BPF_REG_5, saddr, PASS - 19)   // SSM: other senders go to
+                          : ja(0),                                // the kernel, which drops them
+        /*19*/ ldx(BPF_H, BPF_REG_5, BPF_REG_2, 36),
+        /*20*/ jne_imm(BPF_REG_5, udp_dport, PASS - 21),
+        /*21*/ ldx(BPF_W, BPF_REG_2, BPF_REG_6, 16),            // rx_queue_index
+        /*22*/ insn(BPF_LD | BPF_DW | BPF_IMM, BPF_REG_1, BPF_PSEUDO_MAP_FD, 0, map_fd_),
+        /*23*/ insn(0, 0, 0, 0, 0),
+        /*24*/ mov64_imm(BPF_REG_3, XDP_PASS),                  // fallback if queue has no socket
+        /*25*/ call(BPF_FUNC_redirect_map),
+        /*26*/ exit_insn(),
+        /*27*/ mov64_imm(BPF_REG_0, XDP_PASS),
+        /*28*/ exit_insn(),
+    };
+
+    static char license[] = "GPL";
+    char log[4096];
+    log[0] = '\0';
+
+    std::memset(&attr, 0, sizeof(attr));
+    attr.prog_type = BPF_PROG_TYPE_XDP;
+    attr.insns     = (uint64_t)(uintptr_t)prog;
+    attr.insn_cnt  = sizeof(prog) / sizeof(prog[0]);
+    attr.license   = (uint64_t)(uintptr_t)license;
+    attr.log_buf   = (uint64_t)(uintptr_t)log;
+    attr.log_size  = sizeof(log);
+    attr.log_level = 1;
+    prog_fd_ = (int)sys_bpf(BPF_PROG_LOAD, &attr);
+    if (prog_fd_ < 0) {
+        if (log[0]) std::cerr << "af_xdp: verifier: " << log << "\n";
+        return false;
+    }
+
+    std::memset(&attr, 0, sizeof(attr));
+    attr.link_create.prog_fd        = (uint32_t)prog_fd_;
+    attr.link_create.target_ifindex = (uint32_t)ifindex_;
+    attr.link_create.attach_type    = BPF_XDP;
+    attr.link_create.flags          = native_ ? XDP_FLAGS_DRV_MODE : XDP_FLAGS_SKB_MODE;
+    link_fd_ = (int)sys_bpf(BPF_LINK_CREATE, &attr);
+    return link_fd_ >= 0;
+}
+
+void XdpMcastReceiver::refill(const uint64_t* addrs, size_t n) {
+    uint32_t prod = *fill_.producer;
+    auto* ring = static_cast<uint64_t*>(fill_.desc);
+    for (size_t i = 0; i < n; ++i) ring[(prod + i) & fill_.mask] = addrs[i];
+    store_release(fill_.producer, prod + (uint32_t)n);
+}
+
+int XdpMcastReceiver::recv_packets(RxPacket* out, int max) {
+    if (!xdp_ok_) return PacketRingReceiver::recv_packets(out, max);
+
+    // Feed frames the program passes on (another RX queue, VLAN tag, IP
+    // options, fragment) reach the joined UDP socket; it is checked whenever
+    // the XSK is empty and every 64 calls while it is busy.
+    uint32_t cons = *rx_.consumer;
+    uint32_t avail = load_acquire(rx_.producer) - cons;
+    if (avail == 0) {
+        pollfd pfd[2] = {{xsk_fd_, POLLIN, 0}, {fd_, POLLIN, 0}};
+        ::poll(pfd, 2, timeout_ms_ > 0 ? timeout_ms_ : -1);
+        if (pfd[1].revents & POLLIN) return recv_kernel_path(out, max);
+        avail = load_acquire(rx_.producer) - cons;
+        if (avail == 0) return -1;
+    } else if ((++rx_calls_ & 63) == 0) {
+        pollfd pfd{fd_, POLLIN, 0};
+        if (::poll(&pfd, 1, 0) > 0) return recv_kernel_path(out, max);
+    }
+    if (avail > (uint32_t)max) avail = (uint32_t)max;
+
+    uint64_t dropped[64];
+    size_t ndropped = 0;
+    int n = 0;
+
+    const auto* descs = static_cast<const xdp_desc*>(rx_.desc);
+    for (uint32_t i = 0; i < avail; ++i) {
+        const xdp_desc& d = descs[(cons + i) & rx_.mask];
+        const uint8_t* frame = umem_ + d.addr;
+
+        const uint8_t* payload = nullptr;
+        uint32_t plen = 0;
+        if (parse_udp_frame(frame, d.len, group_be_, port_be_, &payload, &plen)) {
+            used_.push_back(d.addr);
+            out[n].data = payload;
+            out[n].len  = plen;
+            ++n;
+        } else {
+            dropped[ndropped++] = d.addr;
+            if (ndropped == 64) {
+                refill(dropped, ndropped);
+                ndropped = 0;
+            }
+        }
+    }
+    store_release(rx_.consumer, cons + avail);
+    if (ndropped) refill(dropped, ndropped);
+
+    return n;
+}
+
+// Datagrams from the UDP socket: the XSK does not see every feed frame.
+int XdpMcastReceiver::recv_kernel_path(RxPacket* out, int max) {
+    const int n = UdpMcastReceiver::recv_packets(out, max);
+    if (n <= 0) return n;
+    if (kernel_path_ == 0) {
+        std::cerr << "WARN: af_xdp: feed datagrams are missing the XSK on queue " << queue_id_
+                  << " (other RX queue, VLAN tag, IP options or fragments); taking them from the kernel\n";
+    }
+    kernel_path_ += (uint64_t)n;
+    return n;
+}
+
+void XdpMcastReceiver::release() {
+    if (!xdp_ok_) {
+        PacketRingReceiver::release();
+        return;
+    }
+    if (used_.empty()) return;
+
+    for (auto& a : used_) a -= a % XDP_FRAME_SIZE;   // back to chunk start
+    refill(used_.data(), used_.size());
+    used_.clear();
+
+    if (load_acquire(fill_.flags) & XDP_RING_NEED_WAKEUP) {
+        ::recvfrom(xsk_fd_, nullptr, 0, MSG_DONTWAIT, nullptr, nullptr);
+    }
+}
+
+uint64_t XdpMcastReceiver::local_drops() {
+    if (!xdp_ok_) return PacketRingReceiver::local_drops();
+
+    // Frames the socket could not take: RX ring full, or no UMEM frame to put
+    // them in (counted in rx_dropped). Counters are cumulative per socket.
+    // Plus overflows of the UDP socket, which takes what misses the XSK.
+    xdp_statistics st{};
+    socklen_t len = sizeof(st);
+    if (::getsockopt(xsk_fd_, SOL_XDP, XDP_STATISTICS, &st, &len) != 0) return UdpMcastReceiver::local_drops();
+    return st.rx_dropped + st.rx_ring_full + UdpMcastReceiver::local_drops();
+}
@@ -0,0 +1,54 @@
+#include "arena.h"
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+static void check(bool ok, const std::string& what) {
+    if (!ok) throw std::runtime_error(what);
+}
+
+int main() {
+    try {
+        // before init everything comes from fallback mappings
+        void* f = arena_alloc(10000);
+        check(f != nullptr && arena_stats().fallback >= 10000, "fallback before init");
+        arena_free(f, 10000);
+        check(arena_stats().fallback == 0, "fallback unmapped");
+
+        check(arena_init(1, true, false), "arena init");
+        ArenaStats st = arena_stats();
+        check(st.capacity == (2u << 20) && st.used == 0, "capacity rounded to 2 MB");
+
+        auto* a = static_cast<uint8_t*>(arena_alloc(100));
+        auto* b = static_cast<uint8_t*>(arena_alloc(5000, 4096));
+        check(a && b, "alloc");
+        check(((uintptr_t)a & 63) == 0 && ((uintptr_t)b & 4095) == 0, "alignment");
+        check(b >= a + 100, "no overlap");
+        check(b[0] == 0 && b[4999] == 0, "zeroed");
+
+        // the most recent allocation can be handed back and reused
+        std::memset(b, 0xAB, 5000);
+        arena_free(b, 5000);
+        auto* c = static_cast<uint8_t*>(arena_alloc(5000, 4096));
+        check(c == b && c[0] == 0, "last allocation reclaimed and zeroed");
+
+        // older allocations stay put
+        const size_t used = arena_stats().used;
+        arena_free(a, 100);
+        check(arena_stats().used == used, "non-last free is a no-op");
+
+        // too big for what is left: fallback mapping
+        void* big = arena_alloc(4u << 20);
+        check(big != nullptr && arena_stats().fallback >= (4u << 20), "overflow to fallback");
+        arena_free(big, 4u << 20);
+
+        std::cout << "OK arena\n";
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "FATAL: " << e.what() << "\n";
+        return 1;
+    }
+}
@@ -1,41 +1,15 @@
 #include "config.h"
 #include "decoder.h"
+#include "builder.h"
 
 #include <vector>
+#include <string>
+#include <algorithm>
 #include <cstdint>
 #include <cstring>
 #include <iostream>
 #include <stdexcept>
 
-// ---------- helpers: big-endian writers ----------
-static void push_be16(std::vector<uint8_t>& b, uint16_t v) {
-    b.push_back(uint8_t((v >> 8) & 0xFF));
-    b.push_back(uint8_t(v & 0xFF));
-}
-static void push_be32(std::vector<uint8_t>& b, uint32_t v) {
-    b.push_back(uint8_t((v >> 24) & 0xFF));
-    b.push_back(uint8_t((v >> 16) & 0xFF));
-    b.push_back(uint8_t((v >> 8) & 0xFF));
-    b.push_back(uint8_t(v & 0xFF));
-}
-static void push_be64(std::vector<uint8_t>& b, uint64_t v) {
-    b.push_back(uint8_t((v >> 56) & 0xFF));
-    b.push_back(uint8_t((v >> 48) & 0xFF));
-    b.push_back(uint8_t((v >> 40) & 0xFF));
-    b.push_back(uint8_t((v >> 32) & 0xFF));
-    b.push_back(uint8_t((v >> 24) & 0xFF));
-    b.push_back(uint8_t((v >> 16) & 0xFF));
-    b.push_back(uint8_t((v >> 8) & 0xFF));
-    b.push_back(uint8_t(v & 0xFF));
-}
-static void push_str_fixed(std::vector<uint8_t>& b, const char* s, size_t n) {
-    size_t sl = std::strlen(s);
-    for (size_t i = 0; i < n; ++i) {
-        char c = (i < sl) ? s[i] : ' ';
-        b.push_back(uint8_t(c));
-    }
-}
-
 // ---------- strict spec length check ----------
 static void require_len_matches_spec(char type, const std::vector<uint8_t>& msg) {
     const auto& specs = config().msg_specs;
@@ -170,35 +144,6 @@ static std::vector<uint8_t> build_msg_G() {
     return m;
 }
 
-// ---------- wrap N messages into one MoldUDP64 packet ----------
-static std::vector<uint8_t> build_mold_packet(
-    const char session10[10],
-    uint64_t start_seq,
-    const std::vector<std::vector<uint8_t>>& msgs)
-{
-    std::vector<uint8_t> p;
-    size_t total = 10 + 8 + 2;
-    for (const auto& m : msgs) total += 2 + m.size();
-    p.reserve(total);
-
-    // session[10]
-    for (int i = 0; i < 10; ++i) p.push_back(uint8_t(session10[i]));
-
-    // sequence_number
-    push_be64(p, start_seq);
-
-    // message_count
-    push_be16(p, (uint16_t)msgs.size());
-
-    // blocks
-    for (const auto& m : msgs) {
-        push_be16(p, (uint16_t)m.size());
-        p.insert(p.end(), m.begin(), m.end());
-    }
-
-    return p;
-}
-
 int main() {
     try {
         load_config("config/config.ini");
@@ -221,7 +166,105 @@ int main() {
         DecodeOptions opt;
         opt.verbose = false;
 
-        decode_moldudp64_packet(pkt.data(), pkt.size(), opt);
+        static char out[64 * 1024];
+        size_t n = decode_moldudp64_packet_to_buffer(pkt.data(), pkt.size(), opt, out, sizeof(out));
+        std::cout.write(out, (std::streamsize)n);
+
+        // ---------- type filter: only P ----------
+        DecodeOptions only_p = opt;
+        if (!parse_type_list("P", only_p.type_mask)) throw std::runtime_error("parse_type_list failed");
+        n = decode_moldudp64_packet_to_buffer(pkt.data(), pkt.size(), only_p, out, sizeof(out));
+        std::string filtered(out, n);
+        if (std::count(filtered.begin(), filtered.end(), '\n') != 1 || filtered.find(", 'P'") == std::string::npos) {
+            throw std::runtime_error("type filter: expected exactly one P line, got: " + filtered);
+        }
+
+        // ---------- routing: H,J -> route 1, rest -> route 0 ----------
+        DecodeOptions routed = opt;
+        routed.type_route[(uint8_t)'H'] = 1;
+        routed.type_route[(uint8_t)'J'] = 1;
+
+        static char r0[64 * 1024], r1[64 * 1024];
+        DecodeRoute routes[2] = {{r0, sizeof(r0), 0}, {r1, sizeof(r1), 0}};
+        decode_moldudp64_packet_to_routes(pkt.data(), pkt.size(), routed, routes, 2);
+
+        std::string s0(r0, routes[0].len), s1(r1, routes[1].len);
+        if (std::count(s0.begin(), s0.end(), '\n') != 4 || std::count(s1.begin(), s1.end(), '\n') != 2) {
+            throw std::runtime_error("routing: expected 4/2 lines, got:\n" + s0 + "--\n" + s1);
+        }
+
+        // the output bound covers what was written, per route, in both text forms
+        for (bool verbose : {false, true}) {
+            routed.verbose = verbose;
+            routes[0].len = routes[1].len = 0;
+            decode_moldudp64_packet_to_routes(pkt.data(), pkt.size(), routed, routes, 2);
+            size_t need[2];
+            moldudp64_output_bound(pkt.data(), pkt.size(), routed, false, need, 2);
+            if (need[0] < routes[0].len || need[1] < routes[1].len || need[0] > 4096) {
+                throw std::runtime_error("output bound below decoded size");
+            }
+        }
+        routed.verbose = false;
+
+        // a full route only loses its own messages (P, G after H, J still reach route 0)
+        routes[0].len = 0;
+        routes[1].len = routes[1].cap;
+        decode_moldudp64_packet_to_routes(pkt.data(), pkt.size(), routed, routes, 2);
+        s0.assign(r0, routes[0].len);
+        if (std::count(s0.begin(), s0.end(), '\n') != 4 || routes[1].len != routes[1].cap) {
+            throw std::runtime_error("routing: full route 1 cut route 0 short:\n" + s0);
+        }
+
+        std::cout << "OK type filter + routing\n";
+
+        // ---------- synthetic messages for every loaded spec ----------
+        std::vector<std::vector<uint8_t>> synth;
+        for (const auto& kv : config().msg_specs) {
+            auto m = build_message(kv.second, synth.size());
+            require_len_matches_spec(kv.first, m);
+            if (m[0] != (uint8_t)kv.first) throw std::runtime_error("build_message: wrong type byte");
+            synth.push_back(std::move(m));
+        }
+        auto spkt = build_mold_packet(sess, 100, synth);
+        n = decode_moldudp64_packet_to_buffer(spkt.data(), spkt.size(), opt, out, sizeof(out));
+        std::string all(out, n);
+        if ((size_t)std::count(all.begin(), all.end(), '\n') != synth.size()) {
+            throw std::runtime_error("synthetic packet: expected one line per spec, got:\n" + all);
+        }
+
+        // incremental builder: same bytes as build_mold_packet, respects the size cap
+        MoldPacketBuilder pb(spkt.size());
+        pb.begin(sess, 100);
+        for (const auto& m : synth) {
+            if (!pb.add(m.data(), (uint16_t)m.size())) throw std::runtime_error("builder: message rejected");
+        }
+        if (pb.size() != spkt.size() || std::memcmp(pb.data(), spkt.data(), spkt.size()) != 0) {
+            throw std::runtime_error("builder: packet differs from build_mold_packet");
+        }
+        if (pb.add(synth[0].data(), (uint16_t)synth[0].size()) || pb.count() != synth.size()) {
+            throw std::runtime_error("builder: size cap not enforced");
+        }
+
+        std::cout << "OK synthetic messages for " << synth.size() << " types\n";
+
+        // ---------- structural validation (rerequest answers) ----------
+        if (!validate_moldudp64_packet(pkt.data(), pkt.size())) {
+            throw std::runtime_error("validate: well-formed packet rejected");
+        }
+        std::vector<uint8_t> bad = pkt;
+        bad.push_back(0);                                   // trailing byte
+        if (validate_moldudp64_packet(bad.data(), bad.size())) throw std::runtime_error("validate: trailing byte");
+        bad = pkt;
+        bad[19] = (uint8_t)(bad[19] + 1);                   // count says one more message
+        if (validate_moldudp64_packet(bad.data(), bad.size())) throw std::runtime_error("validate: count");
+        auto short_s = build_msg_S();
+        short_s.pop_back();                                 // S one byte shorter than its spec
+        auto spkt_short = build_mold_packet(sess, 1, {short_s});
+        if (validate_moldudp64_packet(spkt_short.data(), spkt_short.size())) {
+            throw std::runtime_error("validate: message shorter than spec");
+        }
+
+        std::cout << "OK packet validation\n";
         return 0;
     } catch (const std::exception& e) {
         std::cerr << "FATAL: " << e.what() << "\n";
@@ -0,0 +1,123 @@
+#include "config.h"
+#include "feedgen.h"
+
+#include <cstring>
+#include <endian.h>
+#include <iostream>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+static void check(bool ok, const std::string& what) {
+    if (!ok) throw std::runtime_error(what);
+}
+
+static int udp_socket(uint16_t port) {
+    int fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in a{};
+    a.sin_family = AF_INET;
+    a.sin_port = htons(port);
+    a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    check(fd >= 0 && ::bind(fd, (sockaddr*)&a, sizeof(a)) == 0, "bind " + std::to_string(port));
+    timeval tv{0, 200000};
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    return fd;
+}
+
+static uint64_t be64_at(const uint8_t* p) { uint64_t v; std::memcpy(&v, p, 8); return be64toh(v); }
+static uint16_t be16_at(const uint8_t* p) { uint16_t v; std::memcpy(&v, p, 2); return be16toh(v); }
+
+// collect message sequence numbers from every Mold packet on fd
+static void drain(int fd, std::set<uint64_t>& seqs, uint64_t& dups, bool& eos) {
+    uint8_t buf[2048];
+    for (;;) {
+        ssize_t n = ::recv(fd, buf, sizeof(buf), 0);
+        if (n < 20) return;
+        const uint64_t seq = be64_at(buf + 10);
+        const uint16_t cnt = be16_at(buf + 18);
+        if (cnt == 0xFFFF) { eos = true; continue; }
+        for (uint16_t i = 0; i < cnt; ++i) {
+            if (!seqs.insert(seq + i).second) ++dups;
+        }
+    }
+}
+
+int main() {
+    try {
+        load_config("config/config.ini");
+
+        const uint16_t feed_port = (uint16_t)(20000 + ::getpid() % 10000);
+        const uint16_t rr_port = (uint16_t)(feed_port + 1);
+        int feed = udp_socket(feed_port);
+
+        FeedGenConfig fc;
+        fc.dest_ip = "127.0.0.1";
+        fc.dest_port = feed_port;
+        fc.interface_ip = "127.0.0.1";
+        fc.rate = 0;               // flat out
+        fc.max_per_packet = 20;     // ~100 packets: all fit in the receive buffer
+        fc.drop = 0.2;
+        fc.dup = 0.1;
+        fc.reorder = 0.1;
+        fc.rereq_port = rr_port;
+        fc.heartbeat_ms = 0;
+
+        FeedGenerator gen;
+        check(gen.open(fc), "generator open");
+        check(gen.run(2000, 0) == 2000 && gen.next_seq() == 2001, "2000 messages generated");
+        gen.end_of_session();
+
+        std::set<uint64_t> seqs;
+        uint64_t dups = 0;
+        bool eos = false;
+        drain(feed, seqs, dups, eos);
+
+        const FeedGenStats& st = gen.stats();
+        check(eos, "end of session seen");
+        check(st.dropped > 0 && st.duplicated > 0 && st.reordered > 0, "impairments applied");
+        check(seqs.size() < 2000 && dups > 0, "loss and duplicates visible to the receiver");
+
+        // ask for everything, as a receiver would for its gaps
+        int rr = udp_socket(0);
+        sockaddr_in to{};
+        to.sin_family = AF_INET;
+        to.sin_port = htons(rr_port);
+        to.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        uint8_t req[20];
+        std::memcpy(req, "SESSION001", 10);
+        const uint64_t s_be = htobe64(1);
+        const uint16_t c_be = htobe16(2000);
+        std::memcpy(req + 10, &s_be, 8);
+        std::memcpy(req + 18, &c_be, 2);
+        check(::sendto(rr, req, sizeof(req), 0, (sockaddr*)&to, sizeof(to)) == (ssize_t)sizeof(req), "rerequest send");
+
+        gen.serve(0.2);
+        std::set<uint64_t> recovered;
+        uint64_t rdups = 0;
+        bool reos = false;
+        drain(rr, recovered, rdups, reos);
+        check(recovered.size() == 2000 && *recovered.begin() == 1 && *recovered.rbegin() == 2000 && rdups == 0,
+              "rerequest served every message once");
+
+        // a flat-out run answers rerequests while it is still sending
+        const uint16_t c10_be = htobe16(10);
+        std::memcpy(req + 18, &c10_be, 2);
+        check(::sendto(rr, req, sizeof(req), 0, (sockaddr*)&to, sizeof(to)) == (ssize_t)sizeof(req), "rerequest send");
+        check(gen.run(20000, 0) == 20000, "flat-out run");
+        recovered.clear();
+        drain(rr, recovered, rdups, reos);
+        check(recovered.size() == 10 && *recovered.begin() == 1, "rerequest answered during a flat-out run");
+
+        ::close(feed);
+        ::close(rr);
+        std::cout << "OK feedgen (" << seqs.size() << "/2000 live, " << st.dropped << " drops)\n";
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "FATAL: " << e.what() << "\n";
+        return 1;
+    }
+}
@@ -0,0 +1,67 @@
+#include "feedmon.h"
+#include "metrics.h"
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+static void check(bool ok, const std::string& what) {
+    if (!ok) throw std::runtime_error(what);
+}
+
+static ThreadMetrics mt;   // zeroed
+
+int main() {
+    try {
+        const char* sess = "SESSION001";
+        const uint64_t MS = 1000000ULL;
+        FeedMonitor m(mt, 100 * MS, 0);
+
+        // data and heartbeats in step
+        check(m.classify(10, 10, 3, false) == FeedVerdict::DELIVER, "data in order");
+        check(m.classify(13, 13, 0, false) == FeedVerdict::DELIVER, "heartbeat in step");
+        check(m.classify(13, 12, 0, false) == FeedVerdict::DELIVER, "late heartbeat is no duplicate");
+        check(m.classify(13, 10, 3, false) == FeedVerdict::DUPLICATE, "duplicate data");
+
+        // a data gap, then the last packets of a burst lost: only the
+        // heartbeat after them tells
+        check(m.classify(13, 20, 2, false) == FeedVerdict::GAP, "data gap");
+        check(m.gap(sess, 13, 20, 2, 0) == 0, "upstream gap");
+        check(m.classify(22, 25, 0, false) == FeedVerdict::GAP, "heartbeat reveals a tail gap");
+        m.gap(sess, 22, 25, 0, 0);
+        check(mt.gaps == 2 && mt.tail_gaps == 1 && mt.gap_messages == 10, "tail gap counted");
+
+        // end of session ahead of us is a tail gap too; its repeats are ignored
+        check(m.classify(25, 27, 0xFFFF, false) == FeedVerdict::GAP, "end of session reveals a tail gap");
+        check(m.gap(sess, 25, 27, 0xFFFF, 4) == 4, "local gap");
+        check(m.classify(27, 27, 0xFFFF, true) == FeedVerdict::REPEAT_END, "repeated end of session");
+        check(m.classify(27, 30, 0xFFFF, true) == FeedVerdict::REPEAT_END, "repeated end is never a gap");
+        check(mt.gaps == 3 && mt.tail_gaps == 2 && mt.gaps_local == 1 && mt.local_drops == 4, "end of session counts once");
+
+        // drops already attributed do not make the next gap local
+        check(m.gap(sess, 27, 28, 1, 4) == 0, "no new drops");
+        m.reset_drops(9);
+        check(m.gap(sess, 28, 29, 1, 9) == 0, "drops before a reset");
+
+        std::cout << "OK feed gaps\n";
+
+        // silent for 100 ms: one stall, then resumed by the next packet
+        check(!m.idle(50 * MS, sess, 29), "not yet stalled");
+        check(m.idle(100 * MS, sess, 29) && m.stalled(), "stall");
+        check(!m.idle(500 * MS, sess, 29), "one stall event per stall");
+        check(mt.stalls == 1, "stall counted");
+        check(m.active(600 * MS, sess) && !m.stalled(), "resumed");
+        check(!m.active(610 * MS, sess), "resumed once");
+        check(!m.idle(700 * MS, sess, 29), "stall clock restarts at the last packet");
+        check(m.idle(710 * MS, sess, 29) && mt.stalls == 2, "second stall");
+
+        FeedMonitor off(mt, 0, 0);
+        check(!off.idle(~0ULL, sess, 1), "stall detection off");
+
+        std::cout << "OK feed stalls\n";
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "FATAL: " << e.what() << "\n";
+        return 1;
+    }
+}
@@ -0,0 +1,80 @@
+#include "logger.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+
+static void check(bool ok, const std::string& what) {
+    if (!ok) throw std::runtime_error(what);
+}
+
+static std::string slurp(const char* path) {
+    std::string out;
+    FILE* f = std::fopen(path, "rb");
+    if (!f) return out;
+    char buf[65536];
+    size_t n;
+    while ((n = std::fread(buf, 1, sizeof(buf), f)) > 0) out.append(buf, n);
+    std::fclose(f);
+    return out;
+}
+
+static size_t count_lines(const std::string& s) {
+    size_t n = 0;
+    for (char c : s) n += (c == '\n');
+    return n;
+}
+
+int main() {
+    const std::string path = "/tmp/test_logger_" + std::to_string(::getpid()) + ".log";
+    try {
+        int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        check(fd >= 0, "open log file");
+
+        log_start(fd);
+        log_session(LOG_GAP_UPSTREAM, "SESSION001", 10, 14, 5);
+        log_session(LOG_GAP_LOCAL, "SESSION001", 20, 20, 1, 3);
+        log_event(LOG_RECOVERY_REQUEST, 10, 5);
+        log_event(LOG_RECOVERY_DONE, 5);
+
+        // a second producer; its records must all arrive
+        std::thread t([] {
+            for (int i = 0; i < 1000; ++i) log_event(LOG_RECOVERY_DONE, (uint64_t)i);
+        });
+        t.join();
+        log_stop();
+
+        std::string s = slurp(path.c_str());
+        const std::string first = "GAP session=SESSION001 range=10-14 count=5 cause=upstream\n";
+        check(s.compare(0, first.size(), first) == 0, "first record formatted, in order");
+        check(s.find("GAP session=SESSION001 range=20-20 count=1 cause=local kernel_drops=3\n") != std::string::npos,
+              "local gap");
+        check(s.find("RECOVERY request start=10 count=5\n") != std::string::npos, "no-session record");
+        check(s.find("RECOVERY done recovered=999\n") != std::string::npos, "other thread");
+        check(count_lines(s) == 1004 && log_dropped() == 0, "nothing lost while the writer keeps up");
+
+        // a burst larger than the ring is dropped and counted, never blocks
+        ::ftruncate(fd, 0);
+        ::lseek(fd, 0, SEEK_SET);
+        log_start(fd);
+        const uint64_t burst = 200000;
+        for (uint64_t i = 0; i < burst; ++i) log_event(LOG_RECOVERY_DONE, i);
+        const uint64_t dropped = log_dropped();
+        log_stop();
+        check(count_lines(slurp(path.c_str())) + dropped == burst, "written + dropped == burst");
+
+        ::close(fd);
+        ::unlink(path.c_str());
+        std::cout << "OK logger\n";
+        return 0;
+    } catch (const std::exception& e) {
+        ::unlink(path.c_str());
+        std::cerr << "FATAL: " << e.what() << "\n";
+        return 1;
+    }
+}
@@ -0,0 +1,111 @@
+#include "metrics.h"
+#include "config.h"
+#include "builder.h"
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+static void check(bool ok, const std::string& what) {
+    if (!ok) throw std::runtime_error(what);
+}
+
+static bool has(const std::string& s, const std::string& line) {
+    return s.find(line) != std::string::npos;
+}
+
+// Connect to the exporter's unix socket and read the dump until EOF.
+static std::string scrape_unix(const std::string& path) {
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.c_str(), path.size());
+    if (::connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+        ::close(fd);
+        return "";
+    }
+    std::string out;
+    char buf[4096];
+    ssize_t n;
+    while ((n = ::read(fd, buf, sizeof(buf))) > 0) out.append(buf, (size_t)n);
+    ::close(fd);
+    return out;
+}
+
+int main() {
+    try {
+        ThreadMetrics& m = metrics_thread("rx");
+        check(&metrics_thread("ignored") == &m, "one block per thread");
+
+        metrics_add(m.packets, 3);
+        metrics_add(m.packets, 2);
+        metrics_add(m.gaps, 4);
+        metrics_add(m.gaps_local, 1);
+        metrics_observe(m.batch_ns, 100);       // first bucket
+        metrics_observe(m.batch_ns, 1000);      // <= 1024 ns
+        metrics_observe(m.batch_ns, 1ull << 40);   // +Inf
+
+        // per-type counts come straight from the packet
+        std::vector<std::vector<uint8_t>> msgs = {{'A', 1}, {'A', 2, 3}, {'"'}};
+        std::vector<uint8_t> pkt = build_mold_packet("SESSION001", 1, msgs);
+        metrics_count_types(m, pkt.data(), pkt.size(), (uint16_t)msgs.size());
+
+        // a second thread gets its own labelled block
+        std::thread([] { metrics_add(metrics_thread("aux").packets, 7); }).join();
+
+        // threads registering at the same time get distinct blocks
+        std::atomic<bool> go{false};
+        ThreadMetrics* got[4] = {};
+        std::vector<std::thread> ts;
+        for (int i = 0; i < 4; ++i) {
+            ts.emplace_back([&go, &got, i] {
+                while (!go.load()) {}
+                got[i] = &metrics_thread(("t" + std::to_string(i)).c_str());
+            });
+        }
+        go = true;
+        for (auto& t : ts) t.join();
+        for (int i = 0; i < 4; ++i) {
+            for (int j = i + 1; j < 4; ++j) check(got[i] != got[j], "concurrent registration shares a block");
+        }
+
+        std::string s = metrics_render();
+        check(has(s, "# TYPE moldudp64_packets_total counter\n"), "counter type line");
+        check(has(s, "moldudp64_packets_total{thread=\"rx\"} 5\n"), "rx packets");
+        check(has(s, "moldudp64_packets_total{thread=\"aux\"} 7\n"), "aux packets");
+        check(has(s, "moldudp64_gaps_total{thread=\"rx\",cause=\"local\"} 1\n"), "local gaps");
+        check(has(s, "moldudp64_gaps_total{thread=\"rx\",cause=\"upstream\"} 3\n"), "upstream gaps");
+        check(has(s, "moldudp64_type_messages_total{thread=\"rx\",type=\"A\"} 2\n"), "type A");
+        check(has(s, "moldudp64_type_messages_total{thread=\"rx\",type=\"0x22\"} 1\n"), "quote type escaped");
+        check(has(s, "moldudp64_batch_seconds_bucket{thread=\"rx\",le=\"2.56e-07\"} 1\n"), "first bucket");
+        check(has(s, "moldudp64_batch_seconds_bucket{thread=\"rx\",le=\"1.024e-06\"} 2\n"), "cumulative bucket");
+        check(has(s, "moldudp64_batch_seconds_bucket{thread=\"rx\",le=\"+Inf\"} 3\n"), "inf bucket");
+        check(has(s, "moldudp64_batch_seconds_count{thread=\"rx\"} 3\n"), "hist count");
+
+        // exporter over a unix socket
+        MetricsConfig mc;
+        const std::string path = "/tmp/test_metrics_" + std::to_string(::getpid()) + ".sock";
+        mc.listen = "unix:" + path;
+        check(metrics_start(mc), "exporter start");
+        std::string dump = scrape_unix(path);
+        check(has(dump, "moldudp64_packets_total{thread=\"rx\"} 5\n"), "scraped dump");
+        metrics_stop();
+        check(::access(path.c_str(), F_OK) != 0, "socket removed on stop");
+
+        mc.listen = "bogus";
+        check(!metrics_start(mc), "bad listen spec rejected");
+
+        std::cout << "OK metrics\n";
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "FATAL: " << e.what() << "\n";
+        return 1;
+    }
+}
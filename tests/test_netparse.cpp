@@ -0,0 +1,85 @@
+#include "netparse.h"
+
+#include <arpa/inet.h>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+static void check(bool ok, const std::string& what) {
+    if (!ok) throw std::runtime_error(what);
+}
+
+// Ethernet (+ optional VLAN) / IPv4 / UDP frame carrying `payload`
+static std::vector<uint8_t> make_frame(const char* dst_ip, uint16_t dport, const std::string& payload,
+                                       int vlan_tags = 0, int ip_opt_words = 0, uint16_t frag = 0) {
+    std::vector<uint8_t> f(12, 0xAA);
+    for (int i = 0; i < vlan_tags; ++i) {
+        f.push_back(0x81); f.push_back(0x00); f.push_back(0x00); f.push_back(0x64);
+    }
+    f.push_back(0x08); f.push_back(0x00);
+
+    const size_t ihl = 20 + 4 * (size_t)ip_opt_words;
+    const size_t udp_len = 8 + payload.size();
+    const size_t total = ihl + udp_len;
+
+    uint8_t ip[60] = {};
+    ip[0] = (uint8_t)(0x40 | (ihl / 4));
+    ip[2] = (uint8_t)(total >> 8); ip[3] = (uint8_t)total;
+    ip[6] = (uint8_t)(frag >> 8);  ip[7] = (uint8_t)frag;
+    ip[8] = 1;
+    ip[9] = 17;
+    in_addr_t d = ::inet_addr(dst_ip);
+    std::memcpy(ip + 16, &d, 4);
+    f.insert(f.end(), ip, ip + ihl);
+
+    uint8_t udp[8] = {0x30, 0x39, (uint8_t)(dport >> 8), (uint8_t)dport,
+                      (uint8_t)(udp_len >> 8), (uint8_t)udp_len, 0, 0};
+    f.insert(f.end(), udp, udp + 8);
+    f.insert(f.end(), payload.begin(), payload.end());
+    return f;
+}
+
+int main() {
+    try {
+        const uint32_t group = ::inet_addr("239.1.1.1");
+        const uint16_t port = htons(15000);
+        const uint8_t* p = nullptr;
+        uint32_t n = 0;
+
+        auto f = make_frame("239.1.1.1", 15000, "hello");
+        check(parse_udp_frame(f.data(), f.size(), group, port, &p, &n), "plain frame");
+        check(n == 5 && std::memcmp(p, "hello", 5) == 0, "plain payload");
+
+        // trailing Ethernet padding is ignored (lengths come from IP/UDP)
+        f.resize(f.size() + 20, 0);
+        check(parse_udp_frame(f.data(), f.size(), group, port, &p, &n) && n == 5, "padded frame");
+
+        f = make_frame("239.1.1.1", 15000, "vlan", 2);
+        check(parse_udp_frame(f.data(), f.size(), group, port, &p, &n) && n == 4, "QinQ frame");
+
+        f = make_frame("239.1.1.1", 15000, "opts", 0, 2);
+        check(parse_udp_frame(f.data(), f.size(), group, port, &p, &n) && std::memcmp(p, "opts", 4) == 0,
+              "IP options");
+
+        f = make_frame("239.1.1.2", 15000, "x");
+        check(!parse_udp_frame(f.data(), f.size(), group, port, &p, &n), "other group");
+        check(parse_udp_frame(f.data(), f.size(), 0, port, &p, &n), "any group");
+
+        f = make_frame("239.1.1.1", 15001, "x");
+        check(!parse_udp_frame(f.data(), f.size(), group, port, &p, &n), "other port");
+
+        f = make_frame("239.1.1.1", 15000, "x", 0, 0, 0x2000);
+        check(!parse_udp_frame(f.data(), f.size(), group, port, &p, &n), "fragment");
+
+        f = make_frame("239.1.1.1", 15000, "truncated");
+        check(!parse_udp_frame(f.data(), f.size() - 3, group, port, &p, &n), "truncated frame");
+
+        std::cout << "OK netparse\n";
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "FATAL: " << e.what() << "\n";
+        return 1;
+    }
+}
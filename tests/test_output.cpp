@@ -0,0 +1,159 @@
+#include "config.h"
+#include "decoder.h"
+#include "output.h"
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <sys/stat.h>
+
+static void check(bool ok, const std::string& what) {
+    if (!ok) throw std::runtime_error(what);
+}
+
+static void push_be(std::vector<uint8_t>& b, uint64_t v, int bytes) {
+    for (int i = bytes - 1; i >= 0; --i) b.push_back(uint8_t(v >> (8 * i)));
+}
+
+// one packet with a single 'G' message (type + uint64)
+static std::vector<uint8_t> packet_G(uint64_t seq) {
+    std::vector<uint8_t> p(10, '1');
+    push_be(p, seq, 8);
+    push_be(p, 1, 2);
+    push_be(p, 9, 2);
+    p.push_back('G');
+    push_be(p, seq * 10, 8);
+    return p;
+}
+
+static off_t file_size(const std::string& path) {
+    struct stat st{};
+    return (::stat(path.c_str(), &st) == 0) ? st.st_size : -1;
+}
+
+int main() {
+    try {
+        load_config("config/config.ini");
+
+        const std::string path = "/tmp/moldudp64_test_output_" + std::to_string(::getpid()) + ".txt";
+
+        OutputConfig oc;
+        oc.sink = "file:" + path;
+        oc.file_buffer_bytes = 4096;     // small, so writes go straight through on flush
+        oc.flush_policy = "batch";
+
+        DecodeOptions opt;
+        check(output_open(oc, opt), "output_open");
+
+        // batch policy: nothing reaches the file until the batch ends
+        for (uint64_t s = 1; s <= 100; ++s) {
+            auto p = packet_G(s);
+            output_packet(p.data(), p.size(), opt);
+        }
+        check(file_size(path) == 0, "batch policy: no write before batch end");
+
+        output_batch_end();
+        const off_t after_batch = file_size(path);
+        check(after_batch > 0, "batch policy: written at batch end");
+
+        // packet policy: every packet is written immediately
+        output_close();
+        oc.flush_policy = "packet";
+        check(output_open(oc, opt), "output_open packet");
+        auto p = packet_G(101);
+        output_packet(p.data(), p.size(), opt);
+        check(file_size(path) > after_batch, "packet policy: written immediately");
+
+        output_close();
+
+        // 101 lines, in order
+        FILE* f = std::fopen(path.c_str(), "r");
+        check(f != nullptr, "reopen");
+        char line[256];
+        uint64_t expect = 1;
+        while (std::fgets(line, sizeof(line), f)) {
+            unsigned long long seq = 0;
+            check(std::sscanf(line, ">> {'1111111111', %llu", &seq) == 1 && seq == expect, "line order");
+            ++expect;
+        }
+        std::fclose(f);
+        ::unlink(path.c_str());
+        check(expect == 102, "line count");
+
+        std::cout << "OK batched output\n";
+
+        // binary_le: fixed header + payload, integer fields little-endian
+        oc.format = "binary_le";
+        check(output_open(oc, opt), "output_open binary_le");
+        for (uint64_t s = 1; s <= 3; ++s) {
+            auto g = packet_G(s);
+            output_packet(g.data(), g.size(), opt);
+        }
+        output_write(">> text\n", 8);   // no text in the binary formats
+        output_close();
+
+        f = std::fopen(path.c_str(), "rb");
+        check(f != nullptr, "reopen binary");
+        std::vector<uint8_t> data(4096);
+        data.resize(std::fread(data.data(), 1, data.size(), f));
+        std::fclose(f);
+        ::unlink(path.c_str());
+
+        check(data.size() == 3 * 40, "binary size");   // 24 + 9, padded to 40
+        for (uint64_t s = 1; s <= 3; ++s) {
+            MoldRecordHeader h;
+            const uint8_t* rec = data.data() + (s - 1) * 40;
+            std::memcpy(&h, rec, sizeof(h));
+            check(h.seq == s && h.size == 40 && h.len == 9 && h.type == 'G', "record header");
+            check(h.flags == MOLD_RECORD_NORMALIZED && h.recv_ns != 0, "record flags");
+            uint64_t v = 0;
+            std::memcpy(&v, rec + sizeof(h) + 1, 8);
+            check(v == s * 10, "normalized field");
+        }
+
+        std::cout << "OK binary records\n";
+
+        // a jumbo datagram of small messages: more text than one output chunk
+        oc.format = "text";
+        check(output_open(oc, opt), "output_open text");
+        std::vector<uint8_t> jumbo(10, '1');
+        const uint16_t many = (65535 - 20) / 11;
+        push_be(jumbo, 1000, 8);
+        push_be(jumbo, many, 2);
+        for (uint16_t i = 0; i < many; ++i) {
+            push_be(jumbo, 9, 2);
+            jumbo.push_back('G');
+            push_be(jumbo, i, 8);
+        }
+        size_t need = 0;
+        moldudp64_output_bound(jumbo.data(), jumbo.size(), opt, false, &need, 1);
+        check(need > 512 * 1024, "jumbo bound exceeds a chunk");
+
+        auto before = packet_G(999);
+        output_packet(before.data(), before.size(), opt);
+        output_packet(jumbo.data(), jumbo.size(), opt);
+        output_close();
+
+        f = std::fopen(path.c_str(), "r");
+        check(f != nullptr, "reopen jumbo");
+        expect = 999;
+        while (std::fgets(line, sizeof(line), f)) {
+            unsigned long long seq = 0;
+            check(std::sscanf(line, ">> {'1111111111', %llu", &seq) == 1 && seq == expect, "jumbo line order");
+            ++expect;
+        }
+        std::fclose(f);
+        ::unlink(path.c_str());
+        check(expect == 1000 + many, "every message of the jumbo packet output");
+
+        std::cout << "OK oversized packet output\n";
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "FATAL: " << e.what() << "\n";
+        return 1;
+    }
+}
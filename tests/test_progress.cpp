@@ -0,0 +1,61 @@
+#include "progress.h"
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+static void check(bool ok, const std::string& what) {
+    if (!ok) throw std::runtime_error(what);
+}
+
+int main() {
+    try {
+        const std::string path = "/tmp/moldudp64_test_progress_" + std::to_string(::getpid());
+        ::unlink(path.c_str());
+
+        char session[10];
+        uint64_t expected = 0;
+        std::vector<ProgressGap> gaps;
+
+        // fresh file: nothing to resume from
+        check(progress_open(path), "open new");
+        check(!progress_last(session, expected, gaps), "empty file");
+
+        progress_update("SESSION001", 500);
+        progress_add_gap(700, 20);                 // recovery gave up on 700-719
+        progress_update("SESSION001", 1200);
+        progress_close();
+
+        check(progress_open(path), "reopen");
+        check(progress_last(session, expected, gaps), "record found");
+        check(std::memcmp(session, "SESSION001", 10) == 0, "session");
+        check(expected == 1200, "resume after the last delivered message");
+        check(gaps.size() == 1 && gaps[0].seq == 700 && gaps[0].count == 20, "unrecovered range kept");
+
+        // retried: cleared, and only what failed again is recorded
+        progress_clear_gaps();
+        progress_add_gap(710, 10);
+        for (uint64_t i = 0; i < PROGRESS_MAX_GAPS; ++i) progress_add_gap(2000 + 10 * i, 1);
+        progress_close();
+        check(progress_open(path) && progress_last(session, expected, gaps), "reopen 2");
+        check(gaps.size() == (size_t)PROGRESS_MAX_GAPS && gaps[0].seq == 2000, "full list drops the oldest");
+
+        // a new session starts without the old one's ranges
+        progress_update("SESSION002", 5);
+        progress_close();
+        check(progress_open(path) && progress_last(session, expected, gaps), "reopen 3");
+        check(std::memcmp(session, "SESSION002", 10) == 0 && expected == 5 && gaps.empty(), "new session");
+        progress_close();
+
+        ::unlink(path.c_str());
+        std::cout << "OK progress file\n";
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "FATAL: " << e.what() << "\n";
+        return 1;
+    }
+}
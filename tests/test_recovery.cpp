@@ -0,0 +1,659 @@
+#include "config.h"
+#include "decoder.h"
+#include "feedgen.h"
+#include "metrics.h"
+#include "output.h"
+#include "recovery.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <endian.h>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+static void check(bool ok, const std::string& what) {
+    if (!ok) throw std::runtime_error(what);
+}
+
+static uint64_t mono_ns() {
+    struct timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t be64_at(const uint8_t* p) { uint64_t v; std::memcpy(&v, p, 8); return be64toh(v); }
+static uint16_t be16_at(const uint8_t* p) { uint16_t v; std::memcpy(&v, p, 2); return be16toh(v); }
+
+static sockaddr_in loopback(uint16_t port) {
+    sockaddr_in a{};
+    a.sin_family = AF_INET;
+    a.sin_port = htons(port);
+    a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    return a;
+}
+
+// UDP socket on 127.0.0.1 (port 0 = any); returns the port bound.
+static int udp_socket(uint16_t& port) {
+    int fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    sockaddr_in a = loopback(port);
+    check(fd >= 0 && ::bind(fd, (sockaddr*)&a, sizeof(a)) == 0, "bind");
+    socklen_t l = sizeof(a);
+    ::getsockname(fd, (sockaddr*)&a, &l);
+    port = ntohs(a.sin_port);
+    return fd;
+}
+
+// Rerequest relay in front of the generator's responder: logs requests and
+// answers and can lose answer packets on purpose, or answer with bogus ones.
+class Relay {
+public:
+    struct Req {
+        uint64_t seq;
+        uint16_t count;
+        uint64_t ns;
+    };
+
+    explicit Relay(uint16_t upstream) : upstream_(loopback(upstream)) {
+        fd_ = udp_socket(port_);
+        uint16_t any = 0;
+        alt_fd_ = udp_socket(any);
+        th_ = std::thread([this] { loop(); });
+    }
+    ~Relay() {
+        stop_ = true;
+        th_.join();
+        ::close(fd_);
+        ::close(alt_fd_);
+        for (auto& kv : up_) ::close(kv.second);
+    }
+
+    uint16_t port() const { return port_; }
+
+    // Drop answer packets number `i` (0-based, counted over all answers relayed).
+    void drop_answer(size_t i) {
+        std::lock_guard<std::mutex> lk(mu_);
+        drop_.push_back(i);
+    }
+
+    // Drop every answer, or those that come while fewer than `n` requests were seen.
+    void drop_all(bool on) {
+        std::lock_guard<std::mutex> lk(mu_);
+        drop_all_ = on;
+    }
+    void drop_until_requests(size_t n) {
+        std::lock_guard<std::mutex> lk(mu_);
+        drop_until_ = n;
+    }
+
+    // Drop the answer packet holding sequence `seq`, the next `times` times it comes.
+    void drop_seq(uint64_t seq, uint32_t times) {
+        std::lock_guard<std::mutex> lk(mu_);
+        drop_seq_ = seq;
+        drop_seq_times_ = times;
+    }
+
+    // Ask the generator for `w` messages more on either side of each request.
+    void widen(uint16_t w) {
+        std::lock_guard<std::mutex> lk(mu_);
+        widen_ = w;
+    }
+
+    // Hold requests until `n` have come, then pass them all on.
+    void gate(size_t n) {
+        std::lock_guard<std::mutex> lk(mu_);
+        gate_ = n;
+    }
+    bool gate_opened() {
+        std::lock_guard<std::mutex> lk(mu_);
+        return gate_opened_;
+    }
+
+    // Instead of answers, keep sending the last answer packet from another
+    // port, for another session, truncated, and moved out of the range
+    // asked, for a second after each request.
+    void bogus(bool on) {
+        std::lock_guard<std::mutex> lk(mu_);
+        bogus_ = on;
+    }
+
+    std::vector<Req> requests() {
+        std::lock_guard<std::mutex> lk(mu_);
+        return reqs_;
+    }
+    // Header of every answer packet from the generator, dropped or not.
+    std::vector<Req> answers() {
+        std::lock_guard<std::mutex> lk(mu_);
+        return answers_;
+    }
+
+    void reset() {
+        std::lock_guard<std::mutex> lk(mu_);
+        reqs_.clear();
+        answers_.clear();
+        drop_.clear();
+        drop_all_ = false;
+        drop_until_ = 0;
+        bogus_ = false;
+        last_.clear();
+        drop_seq_times_ = 0;
+        widen_ = 0;
+        gate_ = 0;
+        gate_opened_ = false;
+    }
+
+private:
+    // one socket towards the generator per client, so answers find their way back
+    int upstream_fd(const sockaddr_in& client) {
+        const uint16_t cport = client.sin_port;
+        auto it = up_.find(cport);
+        if (it != up_.end()) return it->second;
+        uint16_t any = 0;
+        const int fd = udp_socket(any);
+        up_[cport] = fd;
+        return fd;
+    }
+
+    void loop() {
+        uint8_t buf[65536];
+        while (!stop_) {
+            std::vector<pollfd> pfd{{fd_, POLLIN, 0}};
+            std::vector<uint16_t> who{0};
+            for (auto& kv : up_) {
+                pfd.push_back({kv.second, POLLIN, 0});
+                who.push_back(kv.first);
+            }
+            if (::poll(pfd.data(), pfd.size(), 1) <= 0) {
+                spray();
+                continue;
+            }
+
+            for (size_t i = 0; i < pfd.size(); ++i) {
+                if (!(pfd[i].revents & POLLIN)) continue;
+                sockaddr_in from{};
+                socklen_t fl = sizeof(from);
+                const ssize_t n = ::recvfrom(pfd[i].fd, buf, sizeof(buf), 0, (sockaddr*)&from, &fl);
+                if (n < 20) continue;
+
+                if (i == 0) {   // request from a client
+                    clients_[from.sin_port] = from;
+                    {
+                        std::lock_guard<std::mutex> lk(mu_);
+                        reqs_.push_back(Req{be64_at(buf + 10), be16_at(buf + 18), mono_ns()});
+                        const uint64_t seq = be64_at(buf + 10);
+                        if (widen_ && seq > widen_) {
+                            const uint64_t seq_be = htobe64(seq - widen_);
+                            const uint16_t cnt_be = htobe16((uint16_t)(be16_at(buf + 18) + 2 * widen_));
+                            std::memcpy(buf + 10, &seq_be, 8);
+                            std::memcpy(buf + 18, &cnt_be, 2);
+                        }
+                        held_.push_back(Held{from, std::vector<uint8_t>(buf, buf + n)});
+                        last_to_ = from;
+                        if (gate_ && reqs_.size() < gate_) continue;
+                        gate_opened_ |= gate_ != 0;
+                        gate_ = 0;
+                    }
+                    for (const Held& h : held_) {
+                        ::sendto(upstream_fd(h.from), h.pkt.data(), h.pkt.size(), 0, (sockaddr*)&upstream_,
+                                 sizeof(upstream_));
+                    }
+                    held_.clear();
+                    continue;
+                }
+
+                // answer from the generator
+                bool drop = false;
+                {
+                    std::lock_guard<std::mutex> lk(mu_);
+                    for (size_t d : drop_) drop |= (d == answers_.size());
+                    drop |= drop_all_ || reqs_.size() < drop_until_;
+                    const uint64_t seq = be64_at(buf + 10);
+                    if (drop_seq_times_ && seq <= drop_seq_ && drop_seq_ < seq + be16_at(buf + 18)) {
+                        --drop_seq_times_;
+                        drop = true;
+                    }
+                    answers_.push_back(Req{be64_at(buf + 10), be16_at(buf + 18), mono_ns()});
+                    if (bogus_) {
+                        last_.assign(buf, buf + n);
+                        drop = true;
+                    }
+                }
+                if (drop) continue;
+                const sockaddr_in& to = clients_[who[i]];
+                ::sendto(fd_, buf, (size_t)n, 0, (const sockaddr*)&to, sizeof(to));
+            }
+        }
+    }
+
+    void spray() {
+        std::vector<uint8_t> p;
+        sockaddr_in to{};
+        {
+            std::lock_guard<std::mutex> lk(mu_);
+            if (!bogus_ || last_.empty() || mono_ns() - reqs_.back().ns > 1000000000ULL) return;
+            p = last_;
+            to = last_to_;
+        }
+        const socklen_t tl = sizeof(to);
+        ::sendto(alt_fd_, p.data(), p.size(), 0, (sockaddr*)&to, tl);        // not the endpoint asked
+
+        std::vector<uint8_t> q = p;
+        q[9] = '2';                                                           // SESSION002
+        ::sendto(fd_, q.data(), q.size(), 0, (sockaddr*)&to, tl);
+        ::sendto(fd_, p.data(), p.size() - 1, 0, (sockaddr*)&to, tl);          // malformed
+
+        q = p;
+        const uint64_t far = htobe64(be64_at(p.data() + 10) + 100000);       // beyond the range
+        std::memcpy(q.data() + 10, &far, 8);
+        ::sendto(fd_, q.data(), q.size(), 0, (sockaddr*)&to, tl);
+    }
+
+    struct Held {
+        sockaddr_in from;
+        std::vector<uint8_t> pkt;
+    };
+
+    sockaddr_in upstream_;
+    int fd_ = -1;
+    int alt_fd_ = -1;
+    uint16_t port_ = 0;
+    std::map<uint16_t, int> up_;
+    std::map<uint16_t, sockaddr_in> clients_;
+    std::vector<Held> held_;   // requests behind the gate
+    std::atomic<bool> stop_{false};
+    std::thread th_;
+
+    std::mutex mu_;
+    std::vector<Req> reqs_;
+    std::vector<Req> answers_;
+    std::vector<size_t> drop_;
+    bool drop_all_ = false;
+    size_t drop_until_ = 0;
+    bool bogus_ = false;
+    std::vector<uint8_t> last_;
+    sockaddr_in last_to_{};
+    uint64_t drop_seq_ = 0;
+    uint32_t drop_seq_times_ = 0;
+    uint16_t widen_ = 0;
+    size_t gate_ = 0;
+    bool gate_opened_ = false;
+};
+
+// Generator answering rerequests on its own thread until destroyed.
+struct Responder {
+    FeedGenerator& gen;
+    std::atomic<bool> stop{false};
+    std::thread th;
+
+    explicit Responder(FeedGenerator& g) : gen(g), th([this] { gen.serve(0, &stop); }) {}
+    ~Responder() {
+        stop = true;
+        th.join();
+    }
+};
+
+// Sequence numbers of the ">>" lines in `path`, in file order.
+static std::vector<uint64_t> output_seqs(const std::string& path) {
+    std::vector<uint64_t> v;
+    FILE* f = std::fopen(path.c_str(), "r");
+    if (!f) return v;
+    char line[1024];
+    while (std::fgets(line, sizeof(line), f)) {
+        unsigned long long seq = 0;
+        if (std::sscanf(line, ">> {'SESSION001', %llu", &seq) == 1) v.push_back(seq);
+    }
+    std::fclose(f);
+    return v;
+}
+
+static bool in_order(const std::vector<uint64_t>& v, uint64_t first, uint64_t count) {
+    if (v.size() != count) return false;
+    for (uint64_t i = 0; i < count; ++i) {
+        if (v[i] != first + i) return false;
+    }
+    return true;
+}
+
+// Recovery output goes to a file per case.
+struct Capture {
+    std::string path;
+    DecodeOptions opt;
+
+    explicit Capture(const std::string& name) {
+        path = "/tmp/moldudp64_test_recovery_" + std::to_string(::getpid()) + "_" + name + ".txt";
+        OutputConfig oc;
+        oc.sink = "file:" + path;
+        check(output_open(oc, opt), "output_open " + name);
+    }
+    std::vector<uint64_t> seqs() {
+        output_close();
+        std::vector<uint64_t> v = output_seqs(path);
+        ::unlink(path.c_str());
+        return v;
+    }
+};
+
+int main() {
+    try {
+        // Timeouts short enough for a test, a rate limit, splits from 1000 and
+        // 4 download lanes.
+        char cwd[4096];
+        check(::getcwd(cwd, sizeof(cwd)) != nullptr, "getcwd");
+        const std::string ini = "/tmp/moldudp64_test_recovery_" + std::to_string(::getpid()) + ".ini";
+
+        // a zero message count would never make progress
+        for (const char* bad : {"0", "65536"}) {
+            {
+                std::ofstream f(ini);
+                f << "[FEED_CHANNELS]\n"
+                  << "protocol_spec: " << cwd << "/config/specs/XrossingMD.json\n"
+                  << "[RECOVERY_SETTINGS]\n"
+                  << "max_recovery_message_count: " << bad << "\n";
+            }
+            bool threw = false;
+            try {
+                load_config(ini.c_str());
+            } catch (const std::runtime_error&) {
+                threw = true;
+            }
+            check(threw, std::string("max_recovery_message_count accepted: ") + bad);
+        }
+
+        {
+            std::ofstream f(ini);
+            f << "[FEED_CHANNELS]\n"
+              << "protocol_spec: " << cwd << "/config/specs/XrossingMD.json\n"
+              << "[RECOVERY_SETTINGS]\n"
+              << "max_recovery_message_count: 500\n"
+              << "request_rate: 200\n"
+              << "request_burst: 4\n"
+              << "parallel_min_messages: 1000\n"
+              << "reorder_bytes: 4194304\n"
+              << "endpoint_retry_ms: 5000\n"
+              << "timeout_ms: 40\n"
+              << "min_timeout_us: 10000\n"
+              << "retries: 4\n"
+              << "download_lanes: 4\n"
+              << "download_segment_bytes: 65536\n";
+        }
+        load_config(ini.c_str());
+        ::unlink(ini.c_str());
+
+        // Generator with 20000 messages of history, answering rerequests.
+        uint16_t feed_port = 0, rr_port = 0;
+        const int feed = udp_socket(feed_port);   // live feed, never read
+        { const int probe = udp_socket(rr_port); ::close(probe); }
+
+        FeedGenConfig fc;
+        fc.dest_ip = "127.0.0.1";
+        fc.dest_port = feed_port;
+        fc.interface_ip = "127.0.0.1";
+        fc.rate = 0;
+        fc.rereq_port = rr_port;
+        fc.heartbeat_ms = 0;
+        FeedGenerator gen;
+        check(gen.open(fc), "generator open");
+        check(gen.run(20000, 0) == 20000, "history generated");
+        Responder responder(gen);
+
+        Relay a(rr_port), b(rr_port);
+        uint16_t dead_port = 0;
+        const int dead = udp_socket(dead_port);   // bound, never answers
+
+        const char* session = "SESSION001";
+        const uint64_t timeout_ns = 40000000ULL;
+
+        // ---------- failover: dead endpoint first ----------
+        {
+            Capture cap("failover");
+            Rerequester rr;
+            check(rr.open("127.0.0.1", dead_port) && rr.add_endpoint("127.0.0.1", a.port()), "open endpoints");
+
+            uint64_t t0 = mono_ns();
+            check(rr.recover(session, 1, 300, cap.opt) == 300, "failover recovered");
+            const uint64_t first_ns = mono_ns() - t0;
+
+            // the dead one now rests: straight to the live endpoint
+            t0 = mono_ns();
+            check(rr.recover(session, 301, 300, cap.opt) == 300, "second recovery");
+            const uint64_t second_ns = mono_ns() - t0;
+
+            check(in_order(cap.seqs(), 1, 600), "failover output in order");
+            // first request + `retries` resends, each at most timeout_ms
+            check(first_ns < 6 * timeout_ns, "failover within (retries + 2) x timeout_ms");
+            check(second_ns < timeout_ns, "resting endpoint skipped");
+
+            uint8_t buf[64];
+            int asked = 0;
+            while (::recv(dead, buf, sizeof(buf), 0) > 0) ++asked;
+            check(asked == 5, "dead endpoint asked 1 + retries times, once");
+            std::cout << "OK failover (" << first_ns / 1000000 << " ms, then " << second_ns / 1000000 << " ms)\n";
+        }
+
+        // ---------- token bucket: 200/s with a burst of 4 ----------
+        {
+            Capture cap("rate");
+            a.reset();
+            Rerequester rr;
+            check(rr.open("127.0.0.1", a.port()), "open");
+            check(rr.recover(session, 1, 5000, cap.opt) == 5000, "rate-limited recovery");
+            check(in_order(cap.seqs(), 1, 5000), "rate-limited output in order");
+
+            const std::vector<Relay::Req> reqs = a.requests();
+            check(reqs.size() == 10, "one request per 500 messages");
+            // 4 at once, then one per 5 ms
+            check(reqs.back().ns - reqs.front().ns >= 6 * 5000000ULL * 9 / 10, "requests paced by the token bucket");
+            std::cout << "OK request rate limit\n";
+        }
+
+        // ---------- split across two endpoints, first range late ----------
+        {
+            Capture cap("split");
+            a.reset();
+            b.reset();
+            a.drop_answer(0);   // the first range's first packet: later ranges complete before it
+            Rerequester rr;
+            check(rr.open("127.0.0.1", a.port()) && rr.add_endpoint("127.0.0.1", b.port()), "open split");
+            check(rr.recover(session, 1001, 3000, cap.opt) == 3000, "split recovered");
+            check(in_order(cap.seqs(), 1001, 3000), "split output in order");
+            check(!a.requests().empty() && !b.requests().empty(), "both endpoints asked");
+            check(a.requests().size() > 1 && a.requests()[1].seq == 1001, "lost packet of the first range asked again");
+            std::cout << "OK split recovery\n";
+        }
+
+        // ---------- timeout: only the lost packet is asked for again ----------
+        ThreadMetrics& mt = metrics_thread("test_recovery");
+        {
+            Capture cap("resend");
+            a.reset();
+            a.drop_answer(1);
+            Rerequester rr;
+            rr.set_metrics(mt);
+            const uint64_t retransmits = mt.rerequest_retransmits.load();
+            check(rr.open("127.0.0.1", a.port()), "open");
+            check(rr.recover(session, 1, 500, cap.opt) == 500, "recovered after a lost packet");
+            check(in_order(cap.seqs(), 1, 500), "output in order after a lost packet");
+
+            const std::vector<Relay::Req> reqs = a.requests();
+            const std::vector<Relay::Req> ans = a.answers();
+            check(reqs.size() == 2 && ans.size() > 3, "one resend");
+            check(reqs[1].seq == ans[1].seq && reqs[1].count == ans[1].count, "resend covers the lost packet only");
+            check(mt.rerequest_retransmits.load() - retransmits == 1, "retransmit counted");
+            std::cout << "OK outstanding-only resend\n";
+        }
+
+        // ---------- timeout: backoff doubles up to timeout_ms ----------
+        {
+            Capture cap("backoff");
+            a.reset();
+            Rerequester rr;
+            check(rr.open("127.0.0.1", a.port()), "open");
+            check(rr.recover(session, 1, 100, cap.opt) == 100, "clean recovery");   // RTT sample: rto = min_timeout_us
+
+            a.reset();
+            a.drop_all(true);
+            check(rr.recover(session, 101, 100, cap.opt) == 0, "nothing recovered from a silent endpoint");
+            cap.seqs();
+
+            const std::vector<Relay::Req> reqs = a.requests();
+            check(reqs.size() == 5, "1 + retries requests");
+            // 10, 20, 40, then 40 ms (80 uncapped)
+            std::vector<uint64_t> gap_ms;
+            for (size_t i = 1; i < reqs.size(); ++i) gap_ms.push_back((reqs[i].ns - reqs[i - 1].ns) / 1000000);
+            check(gap_ms[0] >= 9 && gap_ms[0] < 18, "first timeout is the RTO");
+            check(gap_ms[1] >= 19 && gap_ms[1] < 35, "backoff doubles");
+            check(gap_ms[2] >= 38 && gap_ms[2] < 60, "backoff doubles again");
+            check(gap_ms[3] >= 38 && gap_ms[3] < 60, "backoff capped at timeout_ms");
+            std::cout << "OK backoff cap (" << gap_ms[0] << ", " << gap_ms[1] << ", " << gap_ms[2] << ", "
+                      << gap_ms[3] << " ms)\n";
+        }
+
+        // ---------- timeout: no RTT sample from a resent request (Karn) ----------
+        {
+            Capture cap("karn");
+            a.reset();
+            a.drop_until_requests(2);   // the first request goes unanswered
+            Rerequester rr;
+            rr.set_metrics(mt);
+            const uint64_t samples = mt.rerequest_rtt_ns.count.load();
+            const uint64_t retransmits = mt.rerequest_retransmits.load();
+            check(rr.open("127.0.0.1", a.port()), "open");
+            check(rr.recover(session, 1, 300, cap.opt) == 300, "recovered from the resend");
+            check(mt.rerequest_rtt_ns.count.load() == samples, "answer to a resend not sampled");
+            check(mt.rerequest_retransmits.load() - retransmits == 1, "one retransmit");
+
+            check(rr.recover(session, 301, 300, cap.opt) == 300, "clean recovery");
+            check(mt.rerequest_rtt_ns.count.load() == samples + 1, "answer to a first send sampled");
+            check(in_order(cap.seqs(), 1, 600), "output in order");
+            std::cout << "OK Karn's rule\n";
+        }
+
+        // ---------- only answers from the endpoint, for the session and range asked ----------
+        {
+            Capture cap("bogus");
+            a.reset();
+            a.bogus(true);
+            Rerequester rr;
+            rr.set_metrics(mt);
+            const uint64_t samples = mt.rerequest_rtt_ns.count.load();
+            const uint64_t rejected = mt.rerequest_rejected.load();
+            check(rr.open("127.0.0.1", a.port()), "open");
+
+            const uint64_t t0 = mono_ns();
+            check(rr.recover(session, 1, 300, cap.opt) == 0, "nothing taken from bogus answers");
+            const uint64_t ns = mono_ns() - t0;
+            check(cap.seqs().empty(), "nothing output");
+
+            // rejected packets neither time the endpoint nor hold off the timeout
+            check(mt.rerequest_rtt_ns.count.load() == samples, "no RTT sample");
+            check(mt.rerequest_rejected.load() > rejected, "wrong source, session and malformed rejected");
+            check(a.requests().size() == 5, "1 + retries requests");
+            check(ns < 6 * timeout_ns, "gave up on schedule");
+            std::cout << "OK answer source, session and range (" << ns / 1000000 << " ms)\n";
+        }
+
+        // ---------- answers straddling the range asked are trimmed to it ----------
+        {
+            Capture cap("straddle");
+            a.reset();
+            a.widen(3);   // first answer packet starts before the range, last one runs past it
+            Rerequester rr;
+            check(rr.open("127.0.0.1", a.port()), "open");
+            check(rr.recover(session, 101, 300, cap.opt) == 300, "recovered from straddling answers");
+            check(in_order(cap.seqs(), 101, 300), "straddling answers output once, in order");
+            check(a.requests().size() == 1, "no resend for a packet starting before the range");
+            std::cout << "OK answers trimmed to the range\n";
+        }
+        {
+            Capture cap("straddle_split");
+            a.reset();
+            b.reset();
+            a.widen(3);
+            b.widen(3);
+            Rerequester rr;
+            check(rr.open("127.0.0.1", a.port()) && rr.add_endpoint("127.0.0.1", b.port()), "open split");
+            check(rr.recover(session, 1001, 2000, cap.opt) == 2000, "split recovered");
+            check(in_order(cap.seqs(), 1001, 2000), "no duplicates where split ranges meet");
+            std::cout << "OK split ranges trimmed\n";
+        }
+
+        // ---------- download: lanes in flight at once, output in order ----------
+        {
+            Capture cap("download");
+            a.reset();
+            b.reset();
+            a.gate(2);   // lanes alternate endpoints: two requests each before any is answered
+            b.gate(2);
+            Rerequester rr;
+            rr.set_metrics(mt);
+            const uint64_t retransmits = mt.rerequest_retransmits.load();
+            check(rr.open("127.0.0.1", a.port()) && rr.add_endpoint("127.0.0.1", b.port()), "open");
+            check(rr.download(session, 1, 10000, cap.opt) == 10000, "downloaded");
+            check(in_order(cap.seqs(), 1, 10000), "download output in order");
+            check(a.gate_opened() && b.gate_opened(), "requests in flight at once on both endpoints");
+            check(mt.rerequest_retransmits.load() == retransmits, "no request timed out");
+            std::cout << "OK download lanes\n";
+        }
+
+        // ---------- download: a range that comes back short is fetched again ----------
+        {
+            Capture cap("refetch");
+            a.reset();
+            a.drop_seq(1700, 5);   // first request and every resend of segment 1501..2000
+            Rerequester rr;
+            check(rr.open("127.0.0.1", a.port()), "open");
+            check(rr.download(session, 1, 5000, cap.opt) == 5000, "downloaded after a refetch");
+            check(in_order(cap.seqs(), 1, 5000), "refetch output in order");
+
+            uint64_t lost = 0;
+            for (const Relay::Req& ans : a.answers()) {
+                if (ans.seq <= 1700 && 1700 < ans.seq + ans.count) lost = ans.seq;
+            }
+            bool refetched = false;
+            for (const Relay::Req& q : a.requests()) refetched |= (q.seq == lost && q.seq + q.count == 2001);
+            check(lost > 1501 && refetched, "rest of the short range requested again");
+            std::cout << "OK download refetch\n";
+        }
+
+        // ---------- download: gives up after `retries` refetches ----------
+        {
+            Capture cap("stuck");
+            a.reset();
+            a.drop_seq(1700, 1000000);
+            Rerequester rr;
+            check(rr.open("127.0.0.1", a.port()), "open");
+            const uint64_t got = rr.download(session, 1, 5000, cap.opt);
+
+            uint64_t lost = 0;
+            for (const Relay::Req& ans : a.answers()) {
+                if (ans.seq <= 1700 && 1700 < ans.seq + ans.count) lost = ans.seq;
+            }
+            check(lost > 1501 && got == lost - 1, "stopped at the lost packet");
+            check(in_order(cap.seqs(), 1, got), "everything before it output in order");
+            size_t refetches = 0;
+            for (const Relay::Req& q : a.requests()) refetches += (q.seq == lost && q.seq + q.count == 2001);
+            check(refetches == 4, "refetched `retries` times");
+            std::cout << "OK download stuck\n";
+        }
+
+        ::close(dead);
+        ::close(feed);
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "FATAL: " << e.what() << "\n";
+        return 1;
+    }
+}
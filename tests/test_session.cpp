@@ -0,0 +1,41 @@
+#include "session.h"
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+static void check(bool ok, const std::string& what) {
+    if (!ok) throw std::runtime_error(what);
+}
+
+int main() {
+    try {
+        SessionTracker t;
+        check(!t.known(), "nothing known at start");
+        check(t.observe("SESSION001") == SessionEvent::FIRST, "first");
+        check(t.observe("SESSION001") == SessionEvent::SAME, "same");
+
+        check(t.end(501), "end of session");
+        check(!t.end(501), "repeated end of session reported once");
+        check(t.ended() && t.end_seq() == 501, "end seq kept");
+
+        check(t.observe("SESSION002") == SessionEvent::ROLLOVER, "rollover");
+        check(std::string(t.previous(), 10) == "SESSION001", "previous session");
+        check(std::string(t.current(), 10) == "SESSION002", "current session");
+        check(t.previous_ended() && !t.ended(), "ended flag moves with the rollover");
+
+        // late packets of the old session are not a rollover back
+        check(t.observe("SESSION001") == SessionEvent::STALE, "stale");
+        check(t.observe("SESSION002") == SessionEvent::SAME, "still on new session");
+
+        // rollover without an end-of-session packet
+        check(t.observe("SESSION003") == SessionEvent::ROLLOVER, "second rollover");
+        check(!t.previous_ended() && t.rollovers() == 2, "no end seen for the second one");
+
+        std::cout << "OK session\n";
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "FATAL: " << e.what() << "\n";
+        return 1;
+    }
+}
@@ -0,0 +1,67 @@
+#include "shmbus.h"
+
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <sys/mman.h>
+
+static void check(bool ok, const std::string& what) {
+    if (!ok) throw std::runtime_error(what);
+}
+
+int main() {
+    try {
+        const std::string name = "/moldudp64_test_bus_" + std::to_string(::getpid());
+
+        ShmBusWriter w;
+        check(w.open(name, 1024, 64), "bus open");
+        w.set_session("SESSION001");
+
+        ShmBusReader a, b;
+        check(a.open(name) && b.open(name), "bus attach");
+        check(std::memcmp(a.session(), "SESSION001", 10) == 0, "session visible");
+
+        uint8_t msg[200];
+        for (int i = 0; i < (int)sizeof(msg); ++i) msg[i] = (uint8_t)i;
+
+        // publish 10, both readers see all of them in order
+        for (uint64_t s = 1; s <= 10; ++s) w.publish(s, 0, msg, 14);
+
+        ShmBusMessage m{};
+        uint8_t out[256];
+        uint64_t lost = 0;
+        for (uint64_t s = 1; s <= 10; ++s) {
+            check(a.read(m, out, sizeof(out), lost) == 1 && m.mold_seq == s && m.len == 14, "reader a in order");
+        }
+        check(a.read(m, out, sizeof(out), lost) == 0, "reader a drained");
+
+        // oversized message is truncated and flagged
+        w.publish(11, 0, msg, sizeof(msg));
+        check(a.read(m, out, sizeof(out), lost) == 1, "read oversized");
+        check((m.flags & SHM_BUS_TRUNCATED) && m.len == sizeof(msg) && m.copied < m.len, "truncation flagged");
+
+        // reader b fell behind: lap it and expect an overrun, then in-order reads again
+        for (uint64_t s = 12; s <= 5000; ++s) w.publish(s, 0, msg, 14);
+        check(b.read(m, out, sizeof(out), lost) == -1 && lost > 0, "reader b overrun");
+        check(b.read(m, out, sizeof(out), lost) == 1, "reader b resynced");
+        uint64_t prev = m.mold_seq;
+        while (b.read(m, out, sizeof(out), lost) == 1) {
+            check(m.mold_seq == prev + 1, "reader b in order after resync");
+            prev = m.mold_seq;
+        }
+        check(prev == 5000, "reader b caught up");
+
+        a.close();
+        b.close();
+        w.close();
+        ::shm_unlink(name.c_str());
+
+        std::cout << "OK shm message bus\n";
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "FATAL: " << e.what() << "\n";
+        return 1;
+    }
+}
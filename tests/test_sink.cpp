@@ -0,0 +1,173 @@
+#include "sink.h"
+#include "decoder.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+
+static void check(bool ok, const std::string& what) {
+    if (!ok) throw std::runtime_error(what);
+}
+
+int main() {
+    try {
+        const std::string name = "/moldudp64_test_sink_" + std::to_string(::getpid());
+
+        ShmRingSink w;
+        check(w.open(name, 4096), "shm ring open");
+
+        ShmRingReader r;
+        check(r.open(name), "shm ring attach");
+
+        char out[8192];
+        bool overrun = false;
+
+        // round trip, including a wrap around the end of the ring
+        std::string a(3000, 'a'), b(2000, 'b');
+        w.write(a.data(), a.size());
+        size_t n = r.read(out, sizeof(out), overrun);
+        check(n == a.size() && !overrun && std::string(out, n) == a, "read a");
+
+        w.write(b.data(), b.size());
+        n = r.read(out, sizeof(out), overrun);
+        check(n == b.size() && !overrun && std::string(out, n) == b, "read b (wrapped)");
+
+        // writer laps the reader: overrun is reported, reader resyncs to
+        // the start of the newest write
+        w.write(a.data(), a.size());
+        w.write(b.data(), b.size());
+        n = r.read(out, sizeof(out), overrun);
+        check(overrun, "overrun detected");
+        check(n == b.size() && std::string(out, n) == b, "resync to the newest write");
+
+        n = r.read(out, sizeof(out), overrun);
+        check(n == 0 && !overrun, "nothing new");
+
+        // the writer reopens the ring: the reader starts over with it
+        {
+            ShmRingSink w2;
+            check(w2.open(name, 4096), "shm ring reopen");
+            std::string c(100, 'c');
+            w2.write(c.data(), c.size());
+            n = r.read(out, sizeof(out), overrun);
+            check(overrun && n == c.size() && std::string(out, n) == c, "reopen detected");
+        }
+
+        std::cout << "OK shm ring sink\n";
+
+        // a writer lapping the reader mid-copy: never a torn line
+        {
+            ShmRingSink w3;
+            check(w3.open(name, 4096), "shm ring reopen");
+            ShmRingReader r3;
+            check(r3.open(name), "shm ring attach");
+
+            std::atomic<bool> stop{false};
+            std::thread writer([&] {
+                std::string line(63, ' ');
+                line += '\n';
+                for (uint64_t i = 0; !stop; ++i) {
+                    std::memset(&line[0], 'a' + (int)(i % 26), 63);
+                    w3.write(line.data(), line.size());
+                    if (i % 256 == 0) std::this_thread::sleep_for(std::chrono::microseconds(100));
+                }
+            });
+
+            std::string stream;
+            uint64_t lines = 0, overruns = 0;
+            const auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(200);
+            while (std::chrono::steady_clock::now() < until) {
+                n = r3.read(out, sizeof(out), overrun);
+                if (overrun) {
+                    ++overruns;
+                    stream.clear();
+                }
+                stream.append(out, n);
+                size_t nl;
+                while ((nl = stream.find('\n')) != std::string::npos) {
+                    check(nl == 63 && stream.find_first_not_of(stream[0]) == 63, "torn line");
+                    stream.erase(0, nl + 1);
+                    ++lines;
+                }
+            }
+            stop = true;
+            writer.join();
+            check(lines > 0, "lines read");
+            std::cout << "OK shm ring torn reads (" << lines << " lines, " << overruns << " overruns)\n";
+        }
+        r.close();
+        ::shm_unlink(name.c_str());
+
+        // malformed specs are refused, not thrown
+        for (const char* bad : {"fd:", "fd:x", "fd:99999999999", "shm:/x:", "shm:/x:12ab",
+                                "udp:127.0.0.1:", "udp:127.0.0.1:70000", "udp:127.0.0.1:9000:ttl"}) {
+            check(make_sink(bad, 4096, "") == nullptr, std::string("bad spec accepted: ") + bad);
+        }
+        check(make_sink("fd:2", 4096, "") != nullptr, "fd:2");
+
+        std::cout << "OK sink specs\n";
+
+        // udp with binary records: datagrams hold whole records, even when
+        // the payloads are full of '\n' bytes
+        int rx = ::socket(AF_INET, SOCK_DGRAM, 0);
+        sockaddr_in a4{};
+        a4.sin_family = AF_INET;
+        a4.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t alen = sizeof(a4);
+        check(rx >= 0 && ::bind(rx, (sockaddr*)&a4, sizeof(a4)) == 0, "udp bind");
+        ::getsockname(rx, (sockaddr*)&a4, &alen);
+        timeval tv{0, 200000};
+        ::setsockopt(rx, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+        auto udp = make_sink("udp:127.0.0.1:" + std::to_string(ntohs(a4.sin_port)), 4096, "");
+        check(udp != nullptr, "udp sink");
+        udp->set_binary_records(true);
+
+        std::vector<char> recs;
+        for (uint64_t i = 0; i < 12; ++i) {
+            const uint16_t len = (uint16_t)(300 + 37 * i);
+            MoldRecordHeader h{};
+            h.seq = i + 1;
+            h.size = (uint32_t)((sizeof(h) + len + 7) & ~size_t(7));
+            h.len = len;
+            h.type = '\n';
+            const size_t at = recs.size();
+            recs.resize(at + h.size, '\n');
+            std::memcpy(recs.data() + at, &h, sizeof(h));
+        }
+        check(udp->write(recs.data(), recs.size()), "udp write");
+
+        uint64_t next = 1;
+        size_t dgrams = 0;
+        std::vector<char> dg(65536);
+        for (ssize_t got; next <= 12 && (got = ::recv(rx, dg.data(), dg.size(), 0)) > 0; ++dgrams) {
+            check((size_t)got <= 1400, "datagram within max payload");
+            for (size_t off = 0; off < (size_t)got;) {
+                MoldRecordHeader h;
+                check(off + sizeof(h) <= (size_t)got, "record header cut");
+                std::memcpy(&h, dg.data() + off, sizeof(h));
+                check(h.seq == next && off + h.size <= (size_t)got, "record cut across datagrams");
+                off += h.size;
+                ++next;
+            }
+        }
+        check(next == 13 && dgrams > 1, "all records received");
+        ::close(rx);
+
+        std::cout << "OK udp sink record boundaries\n";
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "FATAL: " << e.what() << "\n";
+        return 1;
+    }
+}
@@ -0,0 +1,189 @@
+#include "config.h"
+#include "decoder.h"
+#include "output.h"
+#include "state.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+static void check(bool ok, const std::string& what) {
+    if (!ok) throw std::runtime_error(what);
+}
+
+static void push_be(std::vector<uint8_t>& b, uint64_t v, int bytes) {
+    for (int i = bytes - 1; i >= 0; --i) b.push_back(uint8_t(v >> (8 * i)));
+}
+
+// one packet with a single TradingStatus ('H') message for `sec`
+static std::vector<uint8_t> packet_H(uint64_t seq, const char* sec, char state) {
+    std::vector<uint8_t> p;
+    for (char c : std::string("SNAPSESS01")) p.push_back((uint8_t)c);
+    push_be(p, seq, 8);
+    push_be(p, 1, 2);
+    push_be(p, 18, 2);
+    p.push_back('H');
+    push_be(p, seq * 1000, 8);
+    for (int i = 0; i < 4; ++i) p.push_back((uint8_t)sec[i]);
+    for (char c : std::string("XTKS")) p.push_back((uint8_t)c);
+    p.push_back((uint8_t)state);
+    return p;
+}
+
+static size_t count_lines(const std::string& path) {
+    FILE* f = std::fopen(path.c_str(), "r");
+    if (!f) return 0;
+    char line[512];
+    size_t n = 0;
+    while (std::fgets(line, sizeof(line), f)) {
+        if (std::strncmp(line, ">> ", 3) == 0) ++n;
+    }
+    std::fclose(f);
+    return n;
+}
+
+// sequence numbers of the entries in a snapshot file, in file order
+static std::vector<uint64_t> snapshot_seqs(const std::string& path) {
+    std::vector<uint64_t> seqs;
+    FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f) return seqs;
+    SnapshotHeader h;
+    if (std::fread(&h, sizeof(h), 1, f) == 1) {
+        for (uint64_t i = 0; i < h.entries; ++i) {
+            uint64_t seq;
+            uint16_t len;
+            if (std::fread(&seq, 8, 1, f) != 1 || std::fread(&len, 2, 1, f) != 1) break;
+            std::fseek(f, len, SEEK_CUR);
+            seqs.push_back(seq);
+        }
+    }
+    std::fclose(f);
+    return seqs;
+}
+
+int main() {
+    try {
+        load_config("config/config.ini");
+
+        const std::string pid = std::to_string(::getpid());
+        const std::string snap = "/tmp/moldudp64_test_state_" + pid + ".snap";
+        const std::string out = "/tmp/moldudp64_test_state_" + pid + ".txt";
+
+        SnapshotConfig sc;
+        sc.path = snap;
+        sc.interval_msgs = 0;
+        sc.interval_sec = 0;
+        check(state_open(sc), "state_open");
+
+        // last value per SecurityId: AAAA twice, BBBB once
+        const std::vector<std::vector<uint8_t>> pkts = {
+            packet_H(1, "AAAA", 'T'),
+            packet_H(2, "BBBB", 'T'),
+            packet_H(3, "AAAA", 'H'),
+        };
+        for (const auto& p : pkts) state_apply(p.data(), p.size());
+        check(state_size() == 2, "keyed last value");
+
+        state_close();   // final snapshot
+
+        char session[10];
+        uint64_t next_seq = 0;
+        check(state_load(snap, session, next_seq), "load");
+        check(std::memcmp(session, "SNAPSESS01", 10) == 0, "session");
+        check(next_seq == 4, "next_seq");
+        check(state_size() == 2, "loaded entries");
+
+        // replay: one packet per cached message, through the output module
+        OutputConfig oc;
+        oc.sink = "file:" + out;
+        DecodeOptions opt;
+        check(output_open(oc, opt), "output_open");
+        check(state_replay(opt) == 2, "replay count");
+        output_close();
+        check(count_lines(out) == 2, "replayed lines");
+
+        // a flipped body byte must be rejected
+        FILE* f = std::fopen(snap.c_str(), "r+b");
+        check(f != nullptr, "reopen snapshot");
+        std::fseek(f, (long)sizeof(SnapshotHeader) + 12, SEEK_SET);
+        std::fputc('Z', f);
+        std::fclose(f);
+        check(!state_load(snap, session, next_seq), "corrupt snapshot rejected");
+
+        ::unlink(snap.c_str());
+        ::unlink(out.c_str());
+        std::cout << "OK state snapshot\n";
+
+        // joined live at 100: the cache is partial, nothing is snapshotted
+        check(state_open(sc), "state_open live");
+        auto live = packet_H(100, "AAAA", 'T');
+        state_apply(live.data(), live.size());
+        state_close();
+        check(::access(snap.c_str(), F_OK) != 0, "no snapshot of a live-joined cache");
+
+        // an unfilled gap (3, 4 missing) invalidates a cache built from 1
+        check(state_open(sc), "state_open gap");
+        for (uint64_t s : {1, 2, 5}) {
+            auto p = packet_H(s, "AAAA", 'T');
+            state_apply(p.data(), p.size());
+        }
+        state_close();
+        check(::access(snap.c_str(), F_OK) != 0, "no snapshot across a gap");
+
+        // complete from 1, then a later run builds on the loaded snapshot
+        check(state_open(sc), "state_open full");
+        for (const auto& p : pkts) state_apply(p.data(), p.size());
+        state_close();
+        check(state_open(sc) && state_load(snap, session, next_seq) && next_seq == 4, "load full");
+        auto more = packet_H(4, "CCCC", 'T');
+        state_apply(more.data(), more.size());
+        state_close();
+        check(state_load(snap, session, next_seq) && next_seq == 5 && state_size() == 3, "snapshot on a snapshot");
+
+        // a snapshot claiming to start later than 1 is refused
+        SnapshotHeader h;
+        f = std::fopen(snap.c_str(), "r+b");
+        check(f != nullptr && std::fread(&h, sizeof(h), 1, f) == 1, "read header");
+        h.first_seq = 2;
+        std::fseek(f, 0, SEEK_SET);
+        std::fwrite(&h, sizeof(h), 1, f);
+        std::fclose(f);
+        check(!state_load(snap, session, next_seq), "partial snapshot rejected");
+
+        ::unlink(snap.c_str());
+        std::cout << "OK state coverage\n";
+
+        // snapshots taken mid-run carry only the changes since the last one;
+        // each must still hold the whole cache
+        sc.interval_msgs = 1;
+        check(state_open(sc), "state_open incremental");
+        for (size_t i = 0; i < 2; ++i) state_apply(pkts[i].data(), pkts[i].size());
+        state_maybe_checkpoint();
+        state_apply(pkts[2].data(), pkts[2].size());
+        state_apply(more.data(), more.size());
+        state_close();
+        check(snapshot_seqs(snap) == std::vector<uint64_t>({2, 3, 4}), "incremental snapshot entries");
+
+        // a new session between snapshots starts the writer's copy over
+        check(state_open(sc), "state_open reset");
+        for (const auto& p : pkts) state_apply(p.data(), p.size());
+        state_maybe_checkpoint();
+        state_reset();
+        auto fresh = packet_H(1, "DDDD", 'T');
+        state_apply(fresh.data(), fresh.size());
+        state_close();
+        check(snapshot_seqs(snap) == std::vector<uint64_t>({1}), "snapshot after reset");
+
+        ::unlink(snap.c_str());
+        std::cout << "OK state incremental snapshots\n";
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "FATAL: " << e.what() << "\n";
+        return 1;
+    }
+}